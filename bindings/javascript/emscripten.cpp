@@ -13,6 +13,13 @@ EMSCRIPTEN_BINDINGS(ggwave) {
         .value("GGWAVE_SAMPLE_FORMAT_F32",       GGWAVE_SAMPLE_FORMAT_F32)
         ;
 
+    emscripten::enum_<ggwave_ChannelMode>("ChannelMode")
+        .value("GGWAVE_CHANNEL_MODE_DOWNMIX",     GGWAVE_CHANNEL_MODE_DOWNMIX)
+        .value("GGWAVE_CHANNEL_MODE_MAX_SNR",     GGWAVE_CHANNEL_MODE_MAX_SNR)
+        .value("GGWAVE_CHANNEL_MODE_SUM_SPECTRA", GGWAVE_CHANNEL_MODE_SUM_SPECTRA)
+        .value("GGWAVE_CHANNEL_MODE_PER_CHANNEL", GGWAVE_CHANNEL_MODE_PER_CHANNEL)
+        ;
+
     emscripten::enum_<ggwave_ProtocolId>("ProtocolId")
         .value("GGWAVE_PROTOCOL_AUDIBLE_NORMAL",     GGWAVE_PROTOCOL_AUDIBLE_NORMAL)
         .value("GGWAVE_PROTOCOL_AUDIBLE_FAST",       GGWAVE_PROTOCOL_AUDIBLE_FAST)
@@ -37,6 +44,10 @@ EMSCRIPTEN_BINDINGS(ggwave) {
         .value("GGWAVE_PROTOCOL_CUSTOM_7", GGWAVE_PROTOCOL_CUSTOM_7)
         .value("GGWAVE_PROTOCOL_CUSTOM_8", GGWAVE_PROTOCOL_CUSTOM_8)
         .value("GGWAVE_PROTOCOL_CUSTOM_9", GGWAVE_PROTOCOL_CUSTOM_9)
+
+        .value("GGWAVE_PROTOCOL_OFDM_NORMAL",  GGWAVE_PROTOCOL_OFDM_NORMAL)
+        .value("GGWAVE_PROTOCOL_OFDM_FAST",    GGWAVE_PROTOCOL_OFDM_FAST)
+        .value("GGWAVE_PROTOCOL_OFDM_FASTEST", GGWAVE_PROTOCOL_OFDM_FASTEST)
         ;
 
     emscripten::constant("GGWAVE_OPERATING_MODE_RX",            (int) GGWAVE_OPERATING_MODE_RX);
@@ -44,6 +55,15 @@ EMSCRIPTEN_BINDINGS(ggwave) {
     emscripten::constant("GGWAVE_OPERATING_MODE_RX_AND_TX",     (int) GGWAVE_OPERATING_MODE_RX | GGWAVE_OPERATING_MODE_TX);
     emscripten::constant("GGWAVE_OPERATING_MODE_TX_ONLY_TONES", (int) GGWAVE_OPERATING_MODE_TX_ONLY_TONES);
     emscripten::constant("GGWAVE_OPERATING_MODE_USE_DSS",       (int) GGWAVE_OPERATING_MODE_USE_DSS);
+    emscripten::constant("GGWAVE_OPERATING_MODE_RX_MULTI_STREAM", (int) GGWAVE_OPERATING_MODE_RX_MULTI_STREAM);
+    emscripten::constant("GGWAVE_OPERATING_MODE_TX_MULTI_STREAM", (int) GGWAVE_OPERATING_MODE_TX_MULTI_STREAM);
+    emscripten::constant("GGWAVE_OPERATING_MODE_LONG_PAYLOAD",    (int) GGWAVE_OPERATING_MODE_LONG_PAYLOAD);
+    emscripten::constant("GGWAVE_OPERATING_MODE_RX_CONTINUOUS",   (int) GGWAVE_OPERATING_MODE_RX_CONTINUOUS);
+    emscripten::constant("GGWAVE_OPERATING_MODE_RX_ENERGY_GATE",  (int) GGWAVE_OPERATING_MODE_RX_ENERGY_GATE);
+    emscripten::constant("GGWAVE_OPERATING_MODE_TX_IFFT",         (int) GGWAVE_OPERATING_MODE_TX_IFFT);
+    emscripten::constant("GGWAVE_OPERATING_MODE_TX_NCO",          (int) GGWAVE_OPERATING_MODE_TX_NCO);
+    emscripten::constant("GGWAVE_OPERATING_MODE_TX_LOW_CREST",    (int) GGWAVE_OPERATING_MODE_TX_LOW_CREST);
+    emscripten::constant("GGWAVE_OPERATING_MODE_SHORT_PREAMBLE",  (int) GGWAVE_OPERATING_MODE_SHORT_PREAMBLE);
 
     emscripten::value_object<ggwave_Parameters>("Parameters")
         .field("payloadLength",        & ggwave_Parameters::payloadLength)
@@ -55,6 +75,8 @@ EMSCRIPTEN_BINDINGS(ggwave) {
         .field("sampleFormatInp",      & ggwave_Parameters::sampleFormatInp)
         .field("sampleFormatOut",      & ggwave_Parameters::sampleFormatOut)
         .field("operatingMode",        & ggwave_Parameters::operatingMode)
+        .field("channelsInp",          & ggwave_Parameters::channelsInp)
+        .field("channelMode",          & ggwave_Parameters::channelMode)
         ;
 
     emscripten::function("getDefaultParameters", & ggwave_getDefaultParameters);
@@ -84,9 +106,9 @@ EMSCRIPTEN_BINDINGS(ggwave) {
                        const std::string & data) {
                         // TODO: how to return the result?
                         //       again using a static array and returning a pointer to it
-                        static char output[256];
+                        static char output[GGWave::kMaxLengthLong];
 
-                        auto n = ggwave_decode(instance, data.data(), data.size(), output);
+                        auto n = ggwave_ndecode(instance, data.data(), data.size(), output, sizeof(output));
 
                         if (n > 0) {
                             return emscripten::val(emscripten::typed_memory_view(n, output));
@@ -8,6 +8,12 @@ cdef extern from "ggwave.h" nogil:
         GGWAVE_SAMPLE_FORMAT_I16,
         GGWAVE_SAMPLE_FORMAT_F32
 
+    ctypedef enum ggwave_ChannelMode:
+        GGWAVE_CHANNEL_MODE_DOWNMIX,
+        GGWAVE_CHANNEL_MODE_MAX_SNR,
+        GGWAVE_CHANNEL_MODE_SUM_SPECTRA,
+        GGWAVE_CHANNEL_MODE_PER_CHANNEL
+
     ctypedef enum ggwave_ProtocolId:
         GGWAVE_PROTOCOL_AUDIBLE_NORMAL,
         GGWAVE_PROTOCOL_AUDIBLE_FAST,
@@ -31,14 +37,27 @@ cdef extern from "ggwave.h" nogil:
         GGWAVE_PROTOCOL_CUSTOM_6,
         GGWAVE_PROTOCOL_CUSTOM_7,
         GGWAVE_PROTOCOL_CUSTOM_8,
-        GGWAVE_PROTOCOL_CUSTOM_9
+        GGWAVE_PROTOCOL_CUSTOM_9,
+
+        GGWAVE_PROTOCOL_OFDM_NORMAL,
+        GGWAVE_PROTOCOL_OFDM_FAST,
+        GGWAVE_PROTOCOL_OFDM_FASTEST
 
     enum:
         GGWAVE_OPERATING_MODE_RX,
         GGWAVE_OPERATING_MODE_TX,
         GGWAVE_OPERATING_MODE_RX_AND_TX,
         GGWAVE_OPERATING_MODE_TX_ONLY_TONES,
-        GGWAVE_OPERATING_MODE_USE_DSS
+        GGWAVE_OPERATING_MODE_USE_DSS,
+        GGWAVE_OPERATING_MODE_RX_MULTI_STREAM,
+        GGWAVE_OPERATING_MODE_TX_MULTI_STREAM,
+        GGWAVE_OPERATING_MODE_LONG_PAYLOAD,
+        GGWAVE_OPERATING_MODE_RX_CONTINUOUS,
+        GGWAVE_OPERATING_MODE_RX_ENERGY_GATE,
+        GGWAVE_OPERATING_MODE_TX_IFFT,
+        GGWAVE_OPERATING_MODE_TX_NCO,
+        GGWAVE_OPERATING_MODE_TX_LOW_CREST,
+        GGWAVE_OPERATING_MODE_SHORT_PREAMBLE
 
     ctypedef struct ggwave_Parameters:
         int payloadLength
@@ -50,6 +69,8 @@ cdef extern from "ggwave.h" nogil:
         ggwave_SampleFormat sampleFormatInp
         ggwave_SampleFormat sampleFormatOut
         int operatingMode
+        int channelsInp
+        ggwave_ChannelMode channelMode
 
     ctypedef int ggwave_Instance
 
@@ -74,6 +95,13 @@ cdef extern from "ggwave.h" nogil:
             int waveformSize,
             void * payloadBuffer);
 
+    int ggwave_ndecode(
+            ggwave_Instance instance,
+            const void * waveformBuffer,
+            int waveformSize,
+            void * payloadBuffer,
+            int payloadSize);
+
     void ggwave_setLogFile(void * fptr);
 
     void ggwave_rxToggleProtocol(
@@ -58,10 +58,11 @@ def decode(instance, waveform):
     cdef bytes data_bytes = waveform
     cdef char* cdata = data_bytes
 
-    cdef bytes output_bytes = bytes(256)
+    # large enough for GGWAVE_OPERATING_MODE_LONG_PAYLOAD
+    cdef bytes output_bytes = bytes(4096)
     cdef char* coutput = output_bytes
 
-    rxDataLength = cggwave.ggwave_decode(instance, cdata, len(data_bytes), coutput)
+    rxDataLength = cggwave.ggwave_ndecode(instance, cdata, len(data_bytes), coutput, len(output_bytes))
 
     if (rxDataLength > 0):
         return coutput[0:rxDataLength]
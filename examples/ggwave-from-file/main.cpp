@@ -7,12 +7,16 @@
 
 #include <cstdio>
 #include <cstring>
+#include <algorithm>
 #include <iostream>
+#include <memory>
+#include <vector>
 
 int main(int argc, char** argv) {
-    fprintf(stderr, "Usage: %s audio.wav [-lN] [-d]\n", argv[0]);
+    fprintf(stderr, "Usage: %s audio.wav [-lN] [-d] [-cN]\n", argv[0]);
     fprintf(stderr, "    -lN - fixed payload length of size N, N in [1, %d]\n", GGWave::kMaxLengthFixed);
     fprintf(stderr, "    -d  - use Direct Sequence Spread (DSS)\n");
+    fprintf(stderr, "    -cN - multi-channel processing: 0 - downmix, 1 - max SNR, 2 - sum spectra, 3 - per channel\n");
     fprintf(stderr, "\n");
 
     if (argc < 2) {
@@ -27,6 +31,7 @@ int main(int argc, char** argv) {
 
     const int   payloadLength = argm.count("l") == 0 ? -1 : std::stoi(argm.at("l"));
     const bool  useDSS        = argm.count("d") >  0;
+    const int   channelMode   = argm.count("c") == 0 ? GGWAVE_CHANNEL_MODE_DOWNMIX : std::stoi(argm.at("c"));
 
     drwav wav;
     if (!drwav_init_file(&wav, argv[1], nullptr)) {
@@ -34,8 +39,8 @@ int main(int argc, char** argv) {
         return -4;
     }
 
-    if (wav.channels != 1) {
-        fprintf(stderr, "Only mono WAV files are supported\n");
+    if (wav.channels > GGWave::kMaxChannelsInp) {
+        fprintf(stderr, "Only WAV files with up to %d channels are supported\n", GGWave::kMaxChannelsInp);
         return -5;
     }
 
@@ -60,37 +65,19 @@ int main(int argc, char** argv) {
     parameters.sampleRateInp = wav.sampleRate;
     parameters.operatingMode = GGWAVE_OPERATING_MODE_RX;
     if (useDSS) parameters.operatingMode |= GGWAVE_OPERATING_MODE_USE_DSS;
+    parameters.channelsInp = wav.channels;
+    parameters.channelMode = (GGWave::ChannelMode) channelMode;
 
     switch (wav.bitsPerSample) {
         case 16:
             drwav_read_pcm_frames_s16(&wav, samplesCount, reinterpret_cast<int16_t*>(samples.data()));
 
-            if (wav.channels > 1) {
-                for (size_t i = 0; i < samplesCount; ++i) {
-                    int16_t sample = 0;
-                    for (size_t j = 0; j < wav.channels; ++j) {
-                        sample += reinterpret_cast<int16_t*>(samples.data())[i*wav.channels + j];
-                    }
-                    reinterpret_cast<int16_t*>(samples.data())[i] = sample / wav.channels;
-                }
-            }
-
             parameters.sampleFormatInp = GGWAVE_SAMPLE_FORMAT_I16;
 
             break;
         case 32:
             drwav_read_pcm_frames_f32(&wav, samplesCount, reinterpret_cast<float*>(samples.data()));
 
-            if (wav.channels > 1) {
-                for (size_t i = 0; i < samplesCount; ++i) {
-                    float sample = 0.0f;
-                    for (size_t j = 0; j < wav.channels; ++j) {
-                        sample += reinterpret_cast<float*>(samples.data())[i*wav.channels + j];
-                    }
-                    reinterpret_cast<float*>(samples.data())[i] = sample / wav.channels;
-                }
-            }
-
             parameters.sampleFormatInp = GGWAVE_SAMPLE_FORMAT_F32;
 
             break;
@@ -102,10 +89,25 @@ int main(int argc, char** argv) {
     GGWave ggWave(parameters);
     ggWave.setLogFile(nullptr);
 
+    // in per-channel mode, each channel is decoded by a separate back-end
+    std::vector<std::shared_ptr<GGWave>> backends;
+    std::vector<GGWave *> backendPtrs;
+    if (wav.channels > 1 && channelMode == GGWAVE_CHANNEL_MODE_PER_CHANNEL) {
+        auto parametersBackend = parameters;
+        parametersBackend.sampleRateInp = parameters.sampleRate;
+        parametersBackend.channelsInp = 1;
+        parametersBackend.channelMode = GGWAVE_CHANNEL_MODE_DOWNMIX;
+
+        for (int c = 0; c < (int) wav.channels; ++c) {
+            backends.push_back(std::make_shared<GGWave>(parametersBackend));
+            backendPtrs.push_back(backends.back().get());
+        }
+    }
+
     GGWave::TxRxData data;
     auto ptr = samples.data();
     while ((int) samplesTotal >= parameters.samplesPerFrame) {
-        if (ggWave.decode(ptr, parameters.samplesPerFrame*samplesSize*wav.channels) == false) {
+        if (ggWave.decode(ptr, parameters.samplesPerFrame*samplesSize*wav.channels, backendPtrs.data(), (int) backendPtrs.size()) == false) {
             fprintf(stderr, "Failed to decode the waveform in the WAV file\n");
             return -7;
         }
@@ -113,15 +115,19 @@ int main(int argc, char** argv) {
         ptr += parameters.samplesPerFrame*samplesSize*wav.channels;
         samplesTotal -= parameters.samplesPerFrame;
 
-        const int n = ggWave.rxTakeData(data);
-        if (n > 0) {
-            printf("[+] Decoded message with length %d: '", n);
-            for (auto i = 0; i < n; ++i) {
-                printf("%c", data[i]);
+        const int nDecoders = std::max(1, (int) backendPtrs.size());
+        for (int c = 0; c < nDecoders; ++c) {
+            auto & decoder = backendPtrs.empty() ? ggWave : *backendPtrs[c];
+
+            const int n = decoder.rxTakeData(data);
+            if (n > 0) {
+                printf("[+] Decoded message with length %d: '", n);
+                for (auto i = 0; i < n; ++i) {
+                    printf("%c", data[i]);
+                }
+                printf("'\n");
             }
-            printf("'\n");
         }
-
     }
 
     printf("\n[+] Done\n");
@@ -237,6 +237,8 @@ bool GGWave_init(
             sampleFormatInp,
             sampleFormatOut,
             mode,
+            1,
+            GGWAVE_CHANNEL_MODE_DOWNMIX,
         });
     }
 
@@ -625,8 +625,7 @@ void updateCore() {
                 g_buffer.stateCore.message = {
                     false,
                     std::chrono::system_clock::now(),
-                    (GGWave::Protocols::tx()[inputCurrent.message.protocolId].extra == 2 && inputCurrent.payloadLength <= 0) ?
-                        "MT protocols require fixed-length mode" : "Failed to transmit",
+                    "Failed to transmit",
                     ggWave->rxProtocolId(),
                     ggWave->isDSSEnabled(),
                     0,
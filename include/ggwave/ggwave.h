@@ -19,6 +19,11 @@
 #define GGWAVE_CONFIG_FEW_PROTOCOLS
 #endif
 
+// GGWAVE_CONFIG_FIXED_POINT - integer DSP for targets without a floating-point unit:
+//   - the fixed-length decoder computes the spectrum with a Q15 FFT and quantizes it with integer math
+//   - the Tx sine tables are generated by a phase accumulator from a Q15 sine table
+//   it has to be defined both when building the library and when including this header
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -68,6 +73,11 @@ extern "C" {
         GGWAVE_PROTOCOL_CUSTOM_8,
         GGWAVE_PROTOCOL_CUSTOM_9,
 
+        // not enabled by default and not enabled by GGWave::Protocols::enableAll()
+        GGWAVE_PROTOCOL_OFDM_NORMAL,
+        GGWAVE_PROTOCOL_OFDM_FAST,
+        GGWAVE_PROTOCOL_OFDM_FASTEST,
+
 #endif
         GGWAVE_PROTOCOL_COUNT,
     } ggwave_ProtocolId;
@@ -78,6 +88,34 @@ extern "C" {
         GGWAVE_FILTER_FIRST_ORDER_HIGH_PASS,
     } ggwave_Filter;
 
+    // Processing of multi-channel capture data
+    //
+    //   GGWAVE_CHANNEL_MODE_DOWNMIX:
+    //     Average all channels into a single one before any other processing
+    //
+    //   GGWAVE_CHANNEL_MODE_MAX_SNR:
+    //     Decode the channel with the most prominent spectral peak in the Rx frequency range.
+    //     The channel is re-selected while idle, once per spectrum averaging window of
+    //     GGWave::kMaxSpectrumHistory frames, and kept from the start of the reception until it is over
+    //
+    //   GGWAVE_CHANNEL_MODE_SUM_SPECTRA:
+    //     Decode the sum of the power spectra of all channels. Applies to fixed payload length,
+    //     which decodes each frame spectrum independently. Variable payload length uses the downmix
+    //
+    //   GGWAVE_CHANNEL_MODE_PER_CHANNEL:
+    //     Decode each channel separately. Requires one decoder back-end per channel.
+    //     See GGWave::decode() with back-ends
+    //
+    //   All modes except GGWAVE_CHANNEL_MODE_DOWNMIX require the capture sample rate to be equal
+    //   to the operating sample rate
+    //
+    typedef enum {
+        GGWAVE_CHANNEL_MODE_DOWNMIX,
+        GGWAVE_CHANNEL_MODE_MAX_SNR,
+        GGWAVE_CHANNEL_MODE_SUM_SPECTRA,
+        GGWAVE_CHANNEL_MODE_PER_CHANNEL,
+    } ggwave_ChannelMode;
+
     // Operating modes of ggwave
     //
     //   GGWAVE_OPERATING_MODE_RX:
@@ -93,13 +131,77 @@ extern "C" {
     //   GGWAVE_OPERATING_MODE_USE_DSS:
     //     Enable the built-in Direct Sequence Spread (DSS) algorithm
     //
+    //   GGWAVE_OPERATING_MODE_RX_MULTI_STREAM:
+    //     Receive simultaneous variable-length transmissions that use protocols with different
+    //     start frequencies. Each frequency band keeps its own reception state, while the audio
+    //     capture and the spectrum analysis are shared. Decoded payloads are queued and returned
+    //     one at a time by ggwave_decode() / GGWave::rxTakeData()
+    //
+    //   GGWAVE_OPERATING_MODE_TX_MULTI_STREAM:
+    //     Allow encoding several payloads into a single waveform, each one using a protocol
+    //     in a different frequency band. See GGWave::init() for multiple payloads
+    //
+    //   GGWAVE_OPERATING_MODE_LONG_PAYLOAD:
+    //     Allow variable-length payloads of up to GGWave::kMaxLengthLong bytes. Payloads longer
+    //     than GGWave::kMaxLengthVariable are split into Reed-Solomon protected blocks with
+    //     sequence numbers and sent in a single transmission. The receiver reassembles them.
+    //     Payloads longer than GGWave::kMaxDataSize must be received with ggwave_ndecode().
+    //     Increases the memory used for recording and for the generated waveform
+    //
+    //   GGWAVE_OPERATING_MODE_RX_CONTINUOUS:
+    //     Fixed payload length only. Receive a stream of back-to-back transmissions without gaps,
+    //     e.g. by playing the waveforms of consecutive encode() calls one after the other. After the
+    //     first successful decoding, the receiver locks on the protocol and the frame boundaries and
+    //     decodes each following payload only once, at its known end. The lock is lost when a
+    //     payload fails to decode and the receiver goes back to searching on every frame
+    //
+    //   GGWAVE_OPERATING_MODE_RX_ENERGY_GATE:
+    //     Track the energy of the captured audio in the frequency bands of the enabled Rx protocols
+    //     with a cheap band-pass filter and skip the spectrum analysis and the decoding while it stays
+    //     close to the adaptive noise floor. Reduces the CPU usage of idle receivers. Transmissions
+    //     that are not clearly above the background noise are not received in this mode
+    //
+    //   GGWAVE_OPERATING_MODE_TX_IFFT:
+    //     Synthesize each frame of the waveform with a single inverse FFT of its tones instead of
+    //     summing precomputed sine tables. The cost per frame does not depend on the number of
+    //     tones and the sine tables are not allocated. Requires a power-of-2 number of samples per
+    //     frame and protocols that fit below the Nyquist frequency
+    //
+    //   GGWAVE_OPERATING_MODE_TX_NCO:
+    //     Synthesize the tones of each frame with a bank of oscillators based on complex rotation
+    //     instead of precomputed sine tables. Uses a few floats of state per tone and works with
+    //     any number of samples per frame. Cannot be combined with GGWAVE_OPERATING_MODE_TX_IFFT
+    //
+    //   GGWAVE_OPERATING_MODE_TX_LOW_CREST:
+    //     Give the tones of each frame Newman phases, which keep the peak-to-average power ratio of
+    //     their sum low, and normalize the frame by its actual peak instead of the number of tones.
+    //     The tones are louder at the same peak level of the waveform. Uses the IFFT synthesis if
+    //     GGWAVE_OPERATING_MODE_TX_IFFT is set and the NCO synthesis otherwise. See GGWave::txPAPR()
+    //
+    //   GGWAVE_OPERATING_MODE_SHORT_PREAMBLE:
+    //     Variable payload length only - must be set on both sides. Start each transmission with a
+    //     preamble of GGWave::kPreambleFrames frames instead of the start marker and do not send the
+    //     end marker. The preamble is a chirp in the marker band, sent once and then negated, which
+    //     the receiver finds with a matched filter. The end of the transmission follows from the
+    //     Reed-Solomon protected length at the start of the data. Requires a power-of-2 number of
+    //     samples per frame. Cannot be combined with GGWAVE_OPERATING_MODE_TX_ONLY_TONES
+    //
     enum {
-        GGWAVE_OPERATING_MODE_RX            = 1 << 1,
-        GGWAVE_OPERATING_MODE_TX            = 1 << 2,
-        GGWAVE_OPERATING_MODE_RX_AND_TX     = (GGWAVE_OPERATING_MODE_RX |
-                                               GGWAVE_OPERATING_MODE_TX),
-        GGWAVE_OPERATING_MODE_TX_ONLY_TONES = 1 << 3,
-        GGWAVE_OPERATING_MODE_USE_DSS       = 1 << 4,
+        GGWAVE_OPERATING_MODE_RX              = 1 << 1,
+        GGWAVE_OPERATING_MODE_TX              = 1 << 2,
+        GGWAVE_OPERATING_MODE_RX_AND_TX       = (GGWAVE_OPERATING_MODE_RX |
+                                                 GGWAVE_OPERATING_MODE_TX),
+        GGWAVE_OPERATING_MODE_TX_ONLY_TONES   = 1 << 3,
+        GGWAVE_OPERATING_MODE_USE_DSS         = 1 << 4,
+        GGWAVE_OPERATING_MODE_RX_MULTI_STREAM = 1 << 5,
+        GGWAVE_OPERATING_MODE_TX_MULTI_STREAM = 1 << 6,
+        GGWAVE_OPERATING_MODE_LONG_PAYLOAD    = 1 << 7,
+        GGWAVE_OPERATING_MODE_RX_CONTINUOUS   = 1 << 8,
+        GGWAVE_OPERATING_MODE_RX_ENERGY_GATE  = 1 << 9,
+        GGWAVE_OPERATING_MODE_TX_IFFT         = 1 << 10,
+        GGWAVE_OPERATING_MODE_TX_NCO          = 1 << 11,
+        GGWAVE_OPERATING_MODE_TX_LOW_CREST    = 1 << 12,
+        GGWAVE_OPERATING_MODE_SHORT_PREAMBLE  = 1 << 13,
     };
 
     // GGWave instance parameters
@@ -120,14 +222,25 @@ extern "C" {
     //   is different from sampleRate. Same applies to the transmitted audio.
     //
     //   The samplesPerFrame is the number of samples on which ggwave performs FFT.
-    //   This affects the number of bins in the Fourier spectrum.
-    //   Default value: GGWave::kDefaultSamplesPerFrame
+    //   This affects the number of bins in the Fourier spectrum. Larger frames give a finer
+    //   frequency resolution, at the cost of longer transmissions and proportionally larger
+    //   memory buffers.
+    //   Default value: GGWave::kDefaultSamplesPerFrame, max: GGWave::kMaxSamplesPerFrame
     //
     //   The operatingMode controls which functions of the ggwave instance are enabled.
     //   Use this parameter to reduce the memory footprint of the ggwave instance. For
     //   example, if only Rx is enabled, then the memory buffers needed for the Tx will
     //   not be allocated.
     //
+    //   The captured audio can contain up to GGWave::kMaxChannelsInp interleaved channels.
+    //   The channelMode determines how they are processed - see ggwave_ChannelMode.
+    //   Default value: 1 channel, GGWAVE_CHANNEL_MODE_DOWNMIX
+    //
+    //   Note: channelsInp and channelMode are new in this version and are appended at the end,
+    //   so the offsets of the other fields are unchanged. The size of the struct is not - code
+    //   compiled against an older ggwave.h must be rebuilt. Always start from the values
+    //   returned by ggwave_getDefaultParameters() and change only the needed fields
+    //
     typedef struct {
         int                 payloadLength;        // payload length
         float               sampleRateInp;        // capture sample rate
@@ -138,6 +251,8 @@ extern "C" {
         ggwave_SampleFormat sampleFormatInp;      // format of the captured audio samples
         ggwave_SampleFormat sampleFormatOut;      // format of the playback audio samples
         int                 operatingMode;        // operating mode
+        int                 channelsInp;          // number of channels in the captured audio
+        ggwave_ChannelMode  channelMode;          // processing of multi-channel captured audio
     } ggwave_Parameters;
 
     // GGWave instances are identified with an integer and are stored
@@ -255,6 +370,10 @@ extern "C" {
     //   If the return value is -1 then there was an error during the decoding process.
     //   Usually can occur if there is a lot of background noise in the audio.
     //
+    //   If the return value is -2 then the decoded payload is longer than GGWave::kMaxDataSize
+    //   bytes and was not written to the payloadBuffer. This can happen only with
+    //   GGWAVE_OPERATING_MODE_LONG_PAYLOAD - use ggwave_ndecode() to receive long payloads.
+    //
     //   If the return value is greater than 0, then there are that number of bytes decoded.
     //
     //   IMPORTANT:
@@ -427,21 +546,47 @@ public:
     static constexpr auto kDefaultVolume               = 10;
     static constexpr auto kDefaultSoundMarkerThreshold = 3.0f;
     static constexpr auto kDefaultMarkerFrames         = 16;
+    static constexpr auto kPreambleFrames              = 2;
+    static constexpr auto kPreambleThreshold           = 0.25f;
     static constexpr auto kDefaultEncodedDataOffset    = 3;
-    static constexpr auto kMaxSamplesPerFrame          = 1024;
+    static constexpr auto kMaxSamplesPerFrame          = 4096;
     static constexpr auto kMaxDataSize                 = 256;
     static constexpr auto kMaxLengthVariable           = 140;
     static constexpr auto kMaxLengthFixed              = 64;
+    static constexpr auto kMaxLengthLong               = 4096;
+    static constexpr auto kLongBlockLength             = 64;
+    static constexpr auto kLongBlockHeader             = 2;
     static constexpr auto kMaxSpectrumHistory          = 4;
     static constexpr auto kMaxRecordedFrames           = 2048;
+    static constexpr auto kMaxRecordedFramesLong       = 8192;
+    static constexpr auto kMaxRxStreams                = 4;
+    static constexpr auto kMaxTxStreams                = 4;
+    static constexpr auto kMaxChannelsInp              = 8;
 
     using Parameters    = ggwave_Parameters;
     using SampleFormat  = ggwave_SampleFormat;
+    using ChannelMode   = ggwave_ChannelMode;
     using ProtocolId    = ggwave_ProtocolId;
     using TxProtocolId  = ggwave_ProtocolId;
     using RxProtocolId  = ggwave_ProtocolId;
     using OperatingMode = int; // ggwave_OperatingMode;
 
+    // OFDM protocols
+    //
+    //   Instead of one tone per symbol, an OFDM protocol transmits all of its subcarriers at once.
+    //   A Tx of framesPerTx frames is a block of framesPerTx - 1 OFDM symbols. Each symbol is
+    //   samplesPerFrame samples long and is preceded by a cyclic prefix of
+    //   samplesPerFrame/(framesPerTx - 1) samples, the first half of which cross-fades from the
+    //   previous symbol. The first symbol of a block is a reference. The following symbols carry
+    //   symbolBits = 2 bits per subcarrier, as differential QPSK relative to the previous symbol.
+    //   Every 9th subcarrier is a pilot with a known phase, used to remove the common phase drift
+    //   between the symbols.
+    //
+    //   The subcarriers are on consecutive bins, starting from freqStart. The data bits of a
+    //   block are split equally between its symbols. They require variable payload length and a
+    //   power-of-2 number of samples per frame. They are meant for high-SNR links, such as cabled
+    //   or near-field audio, so they are disabled by default.
+    //
     struct Protocol {
         const char * name;  // string identifier of the protocol
 
@@ -452,8 +597,24 @@ public:
 
         bool enabled;
 
-        int nTones() const { return (2*bytesPerTx)/extra; }
-        int nDataBitsPerTx() const { return 8*bytesPerTx; }
+        int8_t  symbolBits;  // bits per symbol - each symbol is one of 2^symbolBits tones (0 - default of 4)
+        int8_t  binSpacing;  // FFT bins between the tones of a symbol (0 - default of 1)
+
+        bool    ofdm;        // OFDM protocol - see above
+
+        constexpr int nSymbolBits()    const { return symbolBits > 0 ? symbolBits : 4; }
+        constexpr int nSymbolTones()   const { return 1 << nSymbolBits(); }
+        constexpr int nBinSpacing()    const { return binSpacing > 0 ? binSpacing : 1; }
+        constexpr int nSymbolsPerTx()  const { return nDataBitsPerTx()/nSymbolBits(); }
+        constexpr int nDataBins()      const { return ofdm ? nOFDMCarriers() : nBinSpacing()*nSymbolTones()*nSymbolsPerTx(); }
+
+        // the data subcarriers of an OFDM symbol, in groups of 8 between the pilots
+        constexpr int nOFDMSymbols()   const { return framesPerTx - 1; }
+        constexpr int nOFDMData()      const { return nDataBitsPerTx()/(2*(nOFDMSymbols() - 1)); }
+        constexpr int nOFDMCarriers()  const { return nOFDMData() + nOFDMData()/8 + 1; }
+
+        constexpr int nTones() const { return ofdm ? 0 : nSymbolsPerTx()/extra; }
+        constexpr int nDataBitsPerTx() const { return 8*bytesPerTx; }
         int txDuration_ms(int samplesPerFrame, float sampleRate) const {
             return framesPerTx*((1000.0f*samplesPerFrame)/sampleRate);
         }
@@ -494,6 +655,7 @@ public:
             return data[id];
         }
 
+        // enables all protocols except the OFDM ones - they must be toggled explicitly
         void enableAll();
         void disableAll();
 
@@ -506,8 +668,7 @@ public:
             static bool initialized = false;
             if (initialized == false) {
                 for (int i = 0; i < GGWAVE_PROTOCOL_COUNT; ++i) {
-                    protocols.data[i].name = nullptr;
-                    protocols.data[i].enabled = false;
+                    protocols.data[i] = kBuiltIn(ProtocolId(i));
                 }
 
 #if defined(ARDUINO_AVR_UNO)
@@ -518,19 +679,24 @@ public:
 #endif
 
 #ifndef GGWAVE_CONFIG_FEW_PROTOCOLS
-                protocols.data[GGWAVE_PROTOCOL_AUDIBLE_NORMAL]     = { GGWAVE_PSTR("Normal"),       40,  9, 3, 1, true, };
-                protocols.data[GGWAVE_PROTOCOL_AUDIBLE_FAST]       = { GGWAVE_PSTR("Fast"),         40,  6, 3, 1, true, };
-                protocols.data[GGWAVE_PROTOCOL_AUDIBLE_FASTEST]    = { GGWAVE_PSTR("Fastest"),      40,  3, 3, 1, true, };
-                protocols.data[GGWAVE_PROTOCOL_ULTRASOUND_NORMAL]  = { GGWAVE_PSTR("[U] Normal"),   320, 9, 3, 1, true, };
-                protocols.data[GGWAVE_PROTOCOL_ULTRASOUND_FAST]    = { GGWAVE_PSTR("[U] Fast"),     320, 6, 3, 1, true, };
-                protocols.data[GGWAVE_PROTOCOL_ULTRASOUND_FASTEST] = { GGWAVE_PSTR("[U] Fastest"),  320, 3, 3, 1, true, };
+                protocols.data[GGWAVE_PROTOCOL_AUDIBLE_NORMAL].name     = GGWAVE_PSTR("Normal");
+                protocols.data[GGWAVE_PROTOCOL_AUDIBLE_FAST].name       = GGWAVE_PSTR("Fast");
+                protocols.data[GGWAVE_PROTOCOL_AUDIBLE_FASTEST].name    = GGWAVE_PSTR("Fastest");
+                protocols.data[GGWAVE_PROTOCOL_ULTRASOUND_NORMAL].name  = GGWAVE_PSTR("[U] Normal");
+                protocols.data[GGWAVE_PROTOCOL_ULTRASOUND_FAST].name    = GGWAVE_PSTR("[U] Fast");
+                protocols.data[GGWAVE_PROTOCOL_ULTRASOUND_FASTEST].name = GGWAVE_PSTR("[U] Fastest");
+#endif
+                protocols.data[GGWAVE_PROTOCOL_DT_NORMAL].name          = GGWAVE_PSTR("[DT] Normal");
+                protocols.data[GGWAVE_PROTOCOL_DT_FAST].name            = GGWAVE_PSTR("[DT] Fast");
+                protocols.data[GGWAVE_PROTOCOL_DT_FASTEST].name         = GGWAVE_PSTR("[DT] Fastest");
+                protocols.data[GGWAVE_PROTOCOL_MT_NORMAL].name          = GGWAVE_PSTR("[MT] Normal");
+                protocols.data[GGWAVE_PROTOCOL_MT_FAST].name            = GGWAVE_PSTR("[MT] Fast");
+                protocols.data[GGWAVE_PROTOCOL_MT_FASTEST].name         = GGWAVE_PSTR("[MT] Fastest");
+#ifndef GGWAVE_CONFIG_FEW_PROTOCOLS
+                protocols.data[GGWAVE_PROTOCOL_OFDM_NORMAL].name        = GGWAVE_PSTR("[OFDM] Normal");
+                protocols.data[GGWAVE_PROTOCOL_OFDM_FAST].name          = GGWAVE_PSTR("[OFDM] Fast");
+                protocols.data[GGWAVE_PROTOCOL_OFDM_FASTEST].name       = GGWAVE_PSTR("[OFDM] Fastest");
 #endif
-                protocols.data[GGWAVE_PROTOCOL_DT_NORMAL]          = { GGWAVE_PSTR("[DT] Normal"),  24,  9, 1, 1, true, };
-                protocols.data[GGWAVE_PROTOCOL_DT_FAST]            = { GGWAVE_PSTR("[DT] Fast"),    24,  6, 1, 1, true, };
-                protocols.data[GGWAVE_PROTOCOL_DT_FASTEST]         = { GGWAVE_PSTR("[DT] Fastest"), 24,  3, 1, 1, true, };
-                protocols.data[GGWAVE_PROTOCOL_MT_NORMAL]          = { GGWAVE_PSTR("[MT] Normal"),  24,  9, 1, 2, true, };
-                protocols.data[GGWAVE_PROTOCOL_MT_FAST]            = { GGWAVE_PSTR("[MT] Fast"),    24,  6, 1, 2, true, };
-                protocols.data[GGWAVE_PROTOCOL_MT_FASTEST]         = { GGWAVE_PSTR("[MT] Fastest"), 24,  3, 1, 2, true, };
 
 #undef GGWAVE_PSTR
                 initialized = true;
@@ -541,6 +707,36 @@ public:
 
         static TxProtocols & tx();
         static RxProtocols & rx();
+
+        // The built-in protocols, without their names
+        //
+        //   This table is the source of kDefault() and can be evaluated at compile time. The names
+        //   are set in kDefault(), so that they can be placed in PROGMEM. The ids that are not
+        //   built-in have framesPerTx == 0
+        //
+        static constexpr Protocol kBuiltIn(ProtocolId id) {
+            return
+#ifndef GGWAVE_CONFIG_FEW_PROTOCOLS
+                id == GGWAVE_PROTOCOL_AUDIBLE_NORMAL     ? Protocol { nullptr, 40,  9,   3, 1, true,  4, 1, false, } :
+                id == GGWAVE_PROTOCOL_AUDIBLE_FAST       ? Protocol { nullptr, 40,  6,   3, 1, true,  4, 1, false, } :
+                id == GGWAVE_PROTOCOL_AUDIBLE_FASTEST    ? Protocol { nullptr, 40,  3,   3, 1, true,  4, 1, false, } :
+                id == GGWAVE_PROTOCOL_ULTRASOUND_NORMAL  ? Protocol { nullptr, 320, 9,   3, 1, true,  4, 1, false, } :
+                id == GGWAVE_PROTOCOL_ULTRASOUND_FAST    ? Protocol { nullptr, 320, 6,   3, 1, true,  4, 1, false, } :
+                id == GGWAVE_PROTOCOL_ULTRASOUND_FASTEST ? Protocol { nullptr, 320, 3,   3, 1, true,  4, 1, false, } :
+#endif
+                id == GGWAVE_PROTOCOL_DT_NORMAL          ? Protocol { nullptr, 24,  9,   1, 1, true,  4, 1, false, } :
+                id == GGWAVE_PROTOCOL_DT_FAST            ? Protocol { nullptr, 24,  6,   1, 1, true,  4, 1, false, } :
+                id == GGWAVE_PROTOCOL_DT_FASTEST         ? Protocol { nullptr, 24,  3,   1, 1, true,  4, 1, false, } :
+                id == GGWAVE_PROTOCOL_MT_NORMAL          ? Protocol { nullptr, 24,  9,   1, 2, true,  4, 1, false, } :
+                id == GGWAVE_PROTOCOL_MT_FAST            ? Protocol { nullptr, 24,  6,   1, 2, true,  4, 1, false, } :
+                id == GGWAVE_PROTOCOL_MT_FASTEST         ? Protocol { nullptr, 24,  3,   1, 2, true,  4, 1, false, } :
+#ifndef GGWAVE_CONFIG_FEW_PROTOCOLS
+                id == GGWAVE_PROTOCOL_OFDM_NORMAL        ? Protocol { nullptr, 40,  3,  16, 1, false, 2, 1, true,  } :
+                id == GGWAVE_PROTOCOL_OFDM_FAST          ? Protocol { nullptr, 40,  5,  48, 1, false, 2, 1, true,  } :
+                id == GGWAVE_PROTOCOL_OFDM_FASTEST       ? Protocol { nullptr, 40,  9, 112, 1, false, 2, 1, true,  } :
+#endif
+                Protocol { nullptr, 0, 0, 0, 0, false, 0, 0, false, };
+        }
     };
 
     using Tone = int8_t;
@@ -552,11 +748,20 @@ public:
     //     - freq_hz = (p.freqStart + Tone) * hzPerSample
     //     - duration_ms = p.txDuration_ms(samplesPerFrame, sampleRate)
     //
+    //   Symbol s of a Tx with value d is transmitted with Tone = p.nBinSpacing()*(s*p.nSymbolTones() + d)
+    //
     //   If the protocol is mono-tone, each element of the vector corresponds to a single tone.
     //   Otherwise, the tones within a single Tx are separated by value of -1
     //
     using Tones = ggvector<Tone>;
 
+    // Tone data structure of custom protocols with more than 128 tone bins
+    //
+    //   Same as Tones, for bin indices that do not fit in a Tone. See txTonesWide()
+    //
+    using ToneWide  = int16_t;
+    using TonesWide = ggvector<ToneWide>;
+
     using Amplitude    = ggvector<float>;
     using AmplitudeArr = ggmatrix<float>;
     using AmplitudeI16 = ggvector<int16_t>;
@@ -564,6 +769,175 @@ public:
     using RecordedData = ggvector<float>;
     using TxRxData     = ggvector<uint8_t>;
 
+    // Envelope of the transmitted tones
+    //
+    //   A tone that lasts nTotal samples is ramped up linearly before sample nBegin and ramped down
+    //   after sample nEnd. ids is the inverse of the ramp length
+    //
+    struct TxEnvelope {
+        int   nTotal = 0;
+        int   nBegin = 0;
+        int   nEnd   = 0;
+        float ids    = 0.0f;
+    };
+
+    // Memory layout of an instance
+    //
+    //   The number of elements of the buffers allocated by prepare(), as a function of the parameters
+    //   and of the shape of the enabled protocols. A count of 0 means that the buffer is not used.
+    //   prepare() takes the sizes of the buffers from here and heapSize() adds them up, so
+    //   GGWaveStatic can compute the memory of an instance at compile time
+    //
+    struct Layout {
+        // this probably does not matter, but adding it anyway
+#ifdef ARDUINO
+        static constexpr int kAlignment = 4;
+#else
+        static constexpr int kAlignment = 8;
+#endif
+
+        int         samplesPerFrame;
+        int         sampleSizeInp;
+        int         sampleSizeOut;
+        int         channelsInp;
+        ChannelMode channelMode;
+        int         payloadLength; // <= 0 for variable payload length
+        int         nBitsInMarker;
+
+        bool isRx;
+        bool isTx;
+        bool needResampling;
+        bool isRxMultiStream;
+        bool isTxMultiStream;
+        bool isLongPayload;
+        bool isShortPreamble;
+        bool txOnlyTones;
+        bool isTxIFFT;
+        bool isTxNCO;
+
+        // shape of the enabled protocols
+        int  rxMinBytesPerTx;
+        int  rxMaxFramesPerTx;
+        int  rxMaxSymbolsPerTx;
+        int  rxMaxVotes; // nSymbolTones()*rxMaxSymbolsPerTx of the fixed-length protocols
+        int  rxSlots;    // fixed-length protocols
+        int  rxBands;    // distinct start frequencies of the variable-length protocols
+        int  txMinBytesPerTx;
+        int  txMaxDataBins;
+        int  txMaxTonesPerTx;
+        bool txAnyOFDM;
+
+        static constexpr int isqrt(int n, int r = 0) { return (r + 1)*(r + 1) > n ? r : isqrt(n, r + 1); }
+
+        // see RS::ReedSolomon::getWorkSize_bytes()
+        static constexpr int rsWorkSize(int msgLength, int eccLength) { return eccLength + 1 + 3*msgLength + 14*eccLength*2; }
+
+        template <typename T>
+        static constexpr int bytes(int n) { return ((n*int(sizeof(T)) + kAlignment - 1)/kAlignment)*kAlignment; }
+
+        constexpr bool isFixed()           const { return payloadLength > 0; }
+        constexpr int  maxLength()         const { return isFixed() ? payloadLength : kMaxLengthVariable; }
+        constexpr int  eccLength()         const { return eccBytesForLength(maxLength()); }
+        constexpr int  totalLength()       const { return maxLength() + eccLength(); }
+        constexpr int  encodedDataOffset() const { return isFixed() ? 0 : kDefaultEncodedDataOffset; }
+        constexpr int  maxRecordedFrames() const { return isLongPayload ? kMaxRecordedFramesLong : kMaxRecordedFrames; }
+        constexpr int  fftWorkI(int n)     const { return 3 + isqrt(n/2); }
+
+        // long payloads are stored as blocks with headers, which are decoded in place
+        constexpr int longBlocks()       const { return kMaxLengthLong/kLongBlockLength; }
+        constexpr int longBlockSize()    const { return kLongBlockHeader + kLongBlockLength; }
+        constexpr int maxDataLength()    const { return isLongPayload ? longBlocks()*longBlockSize() : maxLength(); }
+        constexpr int maxEncodedLength() const {
+            return isLongPayload ? longBlocks()*(longBlockSize() + eccBytesForLength(longBlockSize())) : totalLength();
+        }
+
+        constexpr int totalTxs() const { return (maxEncodedLength() + rxMinBytesPerTx - 1)/txMinBytesPerTx; }
+
+        // Rx
+        constexpr int amplitude()          const { return needResampling ? samplesPerFrame + 128 : samplesPerFrame; }
+        constexpr int amplitudeResampled() const { return needResampling ? 8*samplesPerFrame : samplesPerFrame; }
+        constexpr int amplitudeTmp()       const { return amplitudeResampled()*sampleSizeInp*channelsInp; }
+        constexpr int channels()           const { return channelsInp > 1 && channelMode != GGWAVE_CHANNEL_MODE_DOWNMIX ? channelsInp : 0; }
+        constexpr int historySizeFixed()   const { return totalTxs()*rxMaxFramesPerTx + 1; }
+        constexpr int rxStreams()          const { return isRxMultiStream ? kMaxRxStreams : 1; }
+
+        // Tx
+        constexpr int txStreams()     const { return isTxMultiStream ? kMaxTxStreams : 1; }
+        constexpr int txMaxTones()    const { return isFixed() || txMaxTonesPerTx > nBitsInMarker ? txMaxTonesPerTx : nBitsInMarker; }
+        constexpr int txTones()       const { return txMaxTones()*totalTxs() + (txMaxTones() > 1 ? totalTxs() : 0); }
+        constexpr bool txWideTones()  const { return txMaxDataBins > 128; }
+        constexpr int txSynth()       const { return isTxIFFT || isTxNCO || txAnyOFDM || isShortPreamble ? samplesPerFrame : 0; }
+        constexpr int txSynthWorkF()  const { return isTxIFFT || txAnyOFDM ? samplesPerFrame/2 : 0; }
+        constexpr int txOscillators() const {
+            return isTxNCO ? 4*(((txMaxTonesPerTx > nBitsInMarker ? txMaxTonesPerTx : nBitsInMarker) + 3)/4) : 0;
+        }
+
+        // Reed-Solomon work buffers
+        constexpr int rsWorkLength() const { return isFixed() ? 0 : rsWorkSize(1, kDefaultEncodedDataOffset - 1); }
+        constexpr int rsWorkData()   const { return rsWorkSize(maxLength(), eccLength()); }
+
+        // Rx resamples up to 8 frames of captured audio at once, Tx - a single frame
+        constexpr int resamplerSamples() const { return needResampling ? (isRx ? 8 : 1)*samplesPerFrame : 0; }
+
+        constexpr int heapSize() const {
+            return bytes<uint8_t>(maxEncodedLength() + encodedDataOffset()) + heapSizeRx() + heapSizeTx() +
+                bytes<uint8_t>(rsWorkLength()) + bytes<uint8_t>(rsWorkData()) +
+                (needResampling ? Resampler::heapSize(resamplerSamples()) : 0);
+        }
+
+        constexpr int heapSizeRx() const {
+            return isRx == false ? 0 :
+                bytes<float>(2*samplesPerFrame) + bytes<int>(fftWorkI(samplesPerFrame)) + bytes<float>(samplesPerFrame/2) +
+                bytes<float>(samplesPerFrame) + bytes<float>(amplitude()) + bytes<float>(amplitudeResampled()) +
+                bytes<uint8_t>(amplitudeTmp()) +
+                (channels() > 0 ? bytes<float>(samplesPerFrame) + bytes<float>(channels()*samplesPerFrame) : 0) +
+                bytes<uint8_t>(maxDataLength() + 1) +
+                bytes<float>(maxEncodedLength() + encodedDataOffset()) +
+                bytes<uint8_t>(eccLength()) +
+                (isFixed() ? heapSizeRxFixed() : heapSizeRxVariable());
+        }
+
+        constexpr int heapSizeRxFixed() const {
+            return bytes<uint8_t>(samplesPerFrame) +
+                3*bytes<uint8_t>(rxSlots*historySizeFixed()*rxMaxSymbolsPerTx) +
+                bytes<uint8_t>(rxSlots*rxMaxVotes) +
+                bytes<int>(rxSlots*historySizeFixed())
+#ifdef GGWAVE_CONFIG_FIXED_POINT
+                + bytes<int16_t>(samplesPerFrame) + bytes<uint32_t>(samplesPerFrame/2 + 1)
+#endif
+                ;
+        }
+
+        constexpr int heapSizeRxVariable() const {
+            return bytes<float>(maxRecordedFrames()*samplesPerFrame) +
+                bytes<float>(samplesPerFrame) +
+                bytes<float>(kMaxSpectrumHistory*samplesPerFrame) +
+                2*bytes<int>(rxBands) + bytes<int>(rxBands*nBitsInMarker) +
+                (isShortPreamble ?
+                    2*bytes<float>(2*samplesPerFrame) + bytes<int>(fftWorkI(2*samplesPerFrame)) + bytes<float>(samplesPerFrame) +
+                    bytes<float>(rxBands*2*samplesPerFrame) + bytes<int>(rxBands) : 0) +
+                (isRxMultiStream ? rxStreams()*bytes<uint8_t>(maxLength() + 1) : 0);
+        }
+
+        constexpr int heapSizeTx() const {
+            return isTx == false ? 0 :
+                txStreams()*(bytes<uint8_t>(maxDataLength() + 1) +
+                    (txOnlyTones ? 0 : bytes<double>(txMaxDataBins) +
+                        (isTxIFFT || isTxNCO ? 0 : 2*bytes<float>(txMaxDataBins*samplesPerFrame)))) +
+                (txStreams() - 1)*bytes<uint8_t>(maxEncodedLength() + encodedDataOffset()) +
+                (txOnlyTones ? 0 :
+                    bytes<float>(samplesPerFrame) + bytes<float>(2*samplesPerFrame) +
+                    bytes<uint8_t>(maxRecordedFrames()*samplesPerFrame*sampleSizeOut) +
+                    bytes<int16_t>(maxRecordedFrames()*samplesPerFrame) +
+                    bytes<float>(txSynth()) +
+                    (txSynthWorkF() > 0 ? bytes<int>(fftWorkI(samplesPerFrame)) + bytes<float>(txSynthWorkF()) : 0) +
+                    bytes<float>(txAnyOFDM ? samplesPerFrame : 0) +
+                    4*bytes<float>(txOscillators())) +
+                bytes<bool>(txMaxDataBins) +
+                (txWideTones() ? bytes<ToneWide>(txTones()) : bytes<Tone>(txTones()));
+        }
+    };
+
     // Default constructor
     //
     //   The GGWave object is not ready to use until you call prepare()
@@ -625,6 +999,20 @@ public:
     //
     bool prepare(const Parameters & parameters, bool allocate = true);
 
+    // Prepare the GGWave object using an externally provided memory buffer
+    //
+    //   Same as prepare(parameters), but all buffers are placed in "buffer" instead of being
+    //   allocated on the heap. The buffer is not owned by the instance and must outlive it.
+    //   The Rx and Tx protocols of the instance are initialized from "rxProtocols" and
+    //   "txProtocols" instead of the global GGWave::Protocols::rx() and GGWave::Protocols::tx().
+    //
+    //   Returns false if "bufferSize" is smaller than the required memory. The required size
+    //   can be obtained with prepare(parameters, false) followed by heapSize().
+    //
+    //   See GGWaveStatic for an instance that computes the required size at compile time.
+    //
+    bool prepare(const Parameters & parameters, void * buffer, int bufferSize, const RxProtocols & rxProtocols, const TxProtocols & txProtocols);
+
     // Set file stream for the internal ggwave logging
     //
     //   By default, ggwave prints internal log messages to stderr.
@@ -636,6 +1024,9 @@ public:
 
     static const Parameters & getDefaultParameters();
 
+    // Number of Reed-Solomon ECC bytes used to protect a payload of the given length
+    static constexpr int eccBytesForLength(int len) { return len < 4 ? 2 : (2*(len/5) > 4 ? 2*(len/5) : 4); }
+
     // Set Tx data to encode into sound
     //
     //   This prepares the GGWave instance for transmission.
@@ -646,6 +1037,19 @@ public:
     bool init(const char * text, TxProtocolId protocolId, const int volume = kDefaultVolume);
     bool init(int dataSize, const char * dataBuffer, TxProtocolId protocolId, const int volume = kDefaultVolume);
 
+    // Set multiple Tx payloads to encode into a single waveform
+    //
+    //   Requires GGWAVE_OPERATING_MODE_TX_MULTI_STREAM. Payload i is transmitted with protocol
+    //   protocolIds[i] and the frequency bands of the protocols must not overlap. All payloads
+    //   start at the same time and the waveform lasts as long as the longest transmission.
+    //
+    //   The tones of all payloads are normalized together, so the peak amplitude of the
+    //   waveform is the same as for a single payload with the same volume.
+    //
+    //   The tones returned by txTones() correspond only to the first payload.
+    //
+    bool init(int nPayloads, const int * dataSizes, const char * const * dataBuffers, const TxProtocolId * protocolIds, const int volume = kDefaultVolume);
+
     // Expected waveform size of the encoded Tx data in bytes
     //
     //   When the output sampling rate is not equal to operating sample rate the result of this method is overestimation
@@ -683,6 +1087,29 @@ public:
     //
     bool decode(const void * data, uint32_t nBytes);
 
+    // Decode an audio waveform with several decoder back-ends
+    //
+    //   data      - pointer to the waveform data
+    //   nBytes    - number of bytes in the waveform
+    //   backends  - the GGWave instances that perform the actual decoding
+    //   nBackends - number of back-ends
+    //
+    //   This instance acts as a shared front-end: the sample conversion, the resampling and the
+    //   spectrum of each frame are computed once and then passed to all back-ends. Each back-end
+    //   keeps its own Rx state (fixed or variable payload length, Rx protocols, multi-stream, etc.)
+    //   and its results are available through its Rx methods as usual.
+    //
+    //   The back-ends must have Rx enabled and must use the same samplesPerFrame and operating
+    //   sample rate as the front-end. Their input sample format is ignored. The front-end itself
+    //   does not decode any data. The averaged spectrum used by variable-length back-ends is
+    //   shared only when the front-end also uses variable payload length.
+    //
+    //   A back-end should receive its audio only through the same front-end.
+    //
+    //   Returns false if the provided waveform or the back-ends are somehow invalid
+    //
+    bool decode(const void * data, uint32_t nBytes, GGWave * const * backends, int nBackends);
+
     //
     // Instance state
     //
@@ -699,6 +1126,9 @@ public:
     SampleFormat sampleFormatInp() const;
     SampleFormat sampleFormatOut() const;
 
+    int channelsInp() const;
+    ChannelMode channelMode() const;
+
     int heapSize() const;
 
     //
@@ -716,8 +1146,21 @@ public:
     //
     //   Call this method after calling encode() to get a list of the tones participating in the generated waveform
     //
+    //   If one of the Tx protocols has more than 128 tone bins (see Protocol::symbolBits and
+    //   Protocol::binSpacing), the tones do not fit in a Tone and the list is empty - use
+    //   txTonesWide() instead
+    //
     const Tones txTones() const;
 
+    // Same as txTones(), for Tx protocols with more than 128 tone bins. Empty otherwise
+    const TonesWide txTonesWide() const;
+
+    // Peak-to-average power ratio of the waveform generated by the last encode() call, in dB
+    //
+    //   Computed on each call. Returns 0 once the waveform has been consumed with txTakeAmplitudeI16()
+    //
+    float txPAPR() const;
+
     // true if there is data pending to be transmitted
     bool txHasData() const;
 
@@ -732,9 +1175,20 @@ public:
     // Rx
     //
 
+    // In multi-stream mode, rxReceiving() and rxAnalyzing() refer to any of the streams, while the
+    // frame counters below refer to the most recently active stream
     bool rxReceiving() const;
     bool rxAnalyzing() const;
 
+    // The capture channel that is currently decoded in GGWAVE_CHANNEL_MODE_MAX_SNR
+    int rxChannel() const;
+
+    // True if the receiver is locked on a stream of transmissions in GGWAVE_OPERATING_MODE_RX_CONTINUOUS
+    bool rxLocked() const;
+
+    // True while the decoding is skipped by the energy gate in GGWAVE_OPERATING_MODE_RX_ENERGY_GATE
+    bool rxIdle() const;
+
     int rxSamplesNeeded()       const;
     int rxFramesToRecord()      const;
     int rxFramesLeftToRecord()  const;
@@ -837,7 +1291,14 @@ public:
 
         Resampler();
 
-        bool alloc(void * p, int & n);
+        // nSamplesMax is the largest number of input samples passed to resample()
+        bool alloc(void * p, int & n, int nSamplesMax);
+
+        // memory used by alloc()
+        static constexpr int heapSize(int nSamplesMax) {
+            return Layout::bytes<float>(kWidth*kSamplesPerZeroCrossing) + Layout::bytes<float>(3*kWidth) +
+                Layout::bytes<float>(kWidth) + Layout::bytes<float>(nSamplesMax + kWidth);
+        }
 
         void reset();
 
@@ -876,15 +1337,48 @@ public:
     };
 
 private:
+    bool prepareParameters(const Parameters & parameters, const RxProtocols & rxProtocols, const TxProtocols & txProtocols);
+    bool prepareMemory();
+
     bool alloc(void * p, int & n);
 
-    void decode_fixed();
-    void decode_variable();
+    struct TxStream;
+
+    bool init_stream(TxStream & stream, int dataSize, const char * dataBuffer, TxProtocolId protocolId);
+
+    int encodeSize_frames(const TxStream & stream) const;
+    float encode_frame(TxStream & stream, int frameId);
+    float encode_frameOFDM(TxStream & stream, int dataFrame);
 
-    int maxFramesPerTx(const Protocols & protocols, bool excludeMT) const;
+    void decode_channels(bool isReceiving);
+    void decode_spectrum(bool averaged, float * dst);
+    void decode_spectrumQ15(); // GGWAVE_CONFIG_FIXED_POINT only
+    void decode_shared(GGWave * const * backends, int nBackends);
+    const float * decode_sharedSpectrum(bool averaged);
+
+    bool decode_gate(bool isBusy);
+    void decode_idle(GGWave * const * backends, int nBackends);
+
+    void decode_fixed(GGWave * frontEnd);
+    void decode_variable(GGWave * frontEnd);
+    void decode_variable_publish();
+
+    struct RxStream;
+
+    bool decode_preamble(int bandId, int & lag, bool & isNegated);
+    void decode_recorded(const RxStream & stream, float * dst, int offset, bool accumulate);
+    void decode_block(const RxStream & stream, int protocolId, int offset, int nFrames, uint8_t * dst, float * confidence, int nBytes);
+    int  decode_length(const uint8_t * encoded, uint8_t * dst);
+    void decode_header(RxStream & stream);
+
+    int maxRecordedFrames() const;
+    int maxFramesPerTx(const Protocols & protocols) const;
     int minBytesPerTx(const Protocols & protocols) const;
     int maxBytesPerTx(const Protocols & protocols) const;
     int maxTonesPerTx(const Protocols & protocols) const;
+    int maxSymbolsPerTx(const Protocols & protocols) const;
+    int maxDataBins(const Protocols & protocols) const;
+    bool anyOFDM(const Protocols & protocols) const;
     int minFreqStart(const Protocols & protocols) const;
 
     double bitFreq(const Protocol & p, int bit) const;
@@ -899,6 +1393,8 @@ private:
     int          m_sampleSizeOut        = -1;
     SampleFormat m_sampleFormatInp      = GGWAVE_SAMPLE_FORMAT_UNDEFINED;
     SampleFormat m_sampleFormatOut      = GGWAVE_SAMPLE_FORMAT_UNDEFINED;
+    int          m_channelsInp          = -1;
+    ChannelMode  m_channelMode          = GGWAVE_CHANNEL_MODE_DOWNMIX;
 
     float        m_hzPerSample          = -1.0f;
     float        m_ihzPerSample         = -1.0f;
@@ -908,6 +1404,7 @@ private:
 
     int          m_nBitsInMarker        = -1;
     int          m_nMarkerFrames        = -1;
+    int          m_nMarkerFramesEnd     = -1;
     int          m_encodedDataOffset    = -1;
 
     float        m_soundMarkerThreshold = -1.0f;
@@ -920,6 +1417,15 @@ private:
     bool         m_needResampling       = false;
     bool         m_txOnlyTones          = false;
     bool         m_isDSSEnabled         = false;
+    bool         m_isRxMultiStream      = false;
+    bool         m_isTxMultiStream      = false;
+    bool         m_isLongPayload        = false;
+    bool         m_isRxContinuous       = false;
+    bool         m_isRxEnergyGate       = false;
+    bool         m_isTxIFFT             = false;
+    bool         m_isTxNCO              = false;
+    bool         m_isTxLowCrest         = false;
+    bool         m_isShortPreamble      = false;
 
     // Common
     TxRxData m_dataEncoded;
@@ -928,20 +1434,41 @@ private:
 
     // Impl
 
-    struct Rx {
+    // Reception state of a single variable-length transmission
+    struct RxStream {
         bool receiving = false;
         bool analyzing = false;
 
         int nMarkersSuccess     = 0;
         int markerFreqStart     = 0;
         int recvDuration_frames = 0;
-        int minFreqStart        = 0;
 
         int framesLeftToAnalyze = 0;
         int framesLeftToRecord  = 0;
         int framesToAnalyze     = 0;
         int framesToRecord      = 0;
-        int samplesNeeded       = 0;
+
+        int recordedStart = 0; // index of the first recorded frame in Rx::amplitudeRecorded
+
+        // short preamble - the data starts dataOffset samples into the first recorded frame
+        // the length headers of the candidate protocols give the number of frames to record
+        bool hasHeader = false;
+
+        int dataOffset   = 0;
+        int headerFrames = 0;
+        int headerLength = 0;
+
+        // decoded data, waiting to be moved to Rx::data
+        int dataLength = 0;
+
+        TxRxData     data;
+        RxProtocol   protocol;
+        RxProtocolId protocolId;
+    };
+
+    struct Rx {
+        int minFreqStart  = 0;
+        int samplesNeeded = 0;
 
         ggvector<float> fftOut; // complex
         ggvector<int>   fftWorkI;
@@ -951,11 +1478,21 @@ private:
         bool hasNewSpectrum  = false;
         bool hasNewAmplitude = false;
 
+        // spectra of the current frame, computed on demand when fanning out to back-ends
+        bool hasSharedSpectrum        = false;
+        bool hasSharedSpectrumAverage = false;
+
         Spectrum  spectrum;
         Amplitude amplitude;
         Amplitude amplitudeResampled;
         TxRxData  amplitudeTmp;
 
+        // multi-channel capture
+        int channelId = 0; // the decoded channel in GGWAVE_CHANNEL_MODE_MAX_SNR
+
+        Spectrum     spectrumChannel;
+        AmplitudeArr amplitudeChannels;
+
         int dataLength = 0;
 
         TxRxData     data;
@@ -963,37 +1500,102 @@ private:
         RxProtocolId protocolId;
         RxProtocols  protocols;
 
+        // reliability of each demodulated byte, used to select Reed-Solomon erasures
+        ggvector<float> confidence;
+        TxRxData        erasures;
+
         // variable-length decoding
         int historyId = 0;
 
         Amplitude    amplitudeAverage;
         AmplitudeArr amplitudeHistory;
-        RecordedData amplitudeRecorded;
+        RecordedData amplitudeRecorded; // ring buffer with the last maxRecordedFrames() frames
+
+        int recordedId = 0;
+        int streamId   = 0; // the most recently active stream
+        int nStreams   = 0;
+
+        RxStream streams[kMaxRxStreams];
+
+        // decode plan - the protocols enabled in prepare(), grouped by start frequency so that
+        // each marker is checked once per band
+        int nBands = 0;
+        int bandId[GGWAVE_PROTOCOL_COUNT]; // band of each protocol, -1 if not enabled in prepare()
+
+        ggvector<int> bandFreqStart;
+        ggvector<int> bandDataBin;    // first bin of the data tones
+        ggmatrix<int> bandMarkerBins; // [band][bit] - bins of the marker bits
+
+        // short preamble - matched filter over the last 2 frames, computed with a 2*samplesPerFrame FFT
+        ggvector<float> preambleFFT;  // spectrum of the window
+        ggvector<float> preambleCorr; // correlation of the window with the chirp
+        ggvector<int>   preambleWorkI;
+        ggvector<float> preambleWorkF;
+        ggmatrix<float> preambleTemplate; // [band] - spectrum of the chirp, zero-padded to 2 frames
+        ggvector<int>   preambleLag;      // [band] - lag of the chirp found in the previous frame, -1 if none
 
         // fixed-length decoding
-        int historyIdFixed = 0;
+        // each enabled protocol keeps the per-frame tone votes in a ring buffer of historySizeFixed frames
+        int historyIdFixed   = 0;
+        int historySizeFixed = 0;
+        int framesFixed      = 0; // frames stored in the ring buffers, up to historySizeFixed
+
+        int slotsFixed[GGWAVE_PROTOCOL_COUNT]; // ring buffer of each protocol, -1 if not enabled in prepare()
+
+        ggvector<uint8_t> spectrumFixed;  // quantized spectrum of the current frame
+        ggmatrix<uint8_t> tonesFixed;     // [slot*historySizeFixed + frame][group] - loudest of the nSymbolTones() tones of each group
+        ggmatrix<uint8_t> majorityFixed;  // [slot*historySizeFixed + frame][group] - tone with most of the votes in the last framesPerTx frames, nSymbolTones() if none
+        ggmatrix<uint8_t> votesMaxFixed;  // [slot*historySizeFixed + frame][group] - votes for the winning tone
+        ggmatrix<uint8_t> votesFixed;     // [slot][nSymbolTones()*group + tone] - votes in the last framesPerTx frames
+        ggvector<int>     detectedFixed;  // [slot*historySizeFixed + frame] - detected groups in the last totalTxs windows
+
+        // integer spectrum of the current frame, with GGWAVE_CONFIG_FIXED_POINT
+        ggvector<int16_t>  fftQ15;   // complex, samplesPerFrame/2 points
+        ggvector<uint32_t> powerQ15; // bins [0, samplesPerFrame/2]
+
+        // continuous fixed-length reception
+        RxProtocolId lockedProtocolId = GGWAVE_PROTOCOL_COUNT; // GGWAVE_PROTOCOL_COUNT if not locked
 
-        ggmatrix<uint8_t> spectrumHistoryFixed;
-        ggvector<uint8_t> detectedBins;
-        ggvector<uint8_t> detectedTones;
+        int lockFrames       = 0; // duration of a single payload
+        int framesToBoundary = 0; // frames until the end of the next payload
+        int lockRun          = 0; // consecutive windows that decoded the first payload, 0 once locked
+
+        // energy gate
+        float gateFilter[2][5]; // high-pass and low-pass biquads at the edges of the Rx bands: b0, b1, b2, a1, a2
+
+        float gateFloor = 0.0f; // adaptive noise floor of the in-band energy, 0 before the first frame
+        int   gateHold  = 0;    // frames until the gate closes
     } m_rx;
 
+    // Data and synthesis tables of a single Tx payload
+    struct TxStream {
+        int dataLength = 0;
+
+        TxRxData   data;
+        TxRxData   dataEncoded;
+        TxProtocol protocol;
+
+        TxEnvelope envelopeMarker;
+        TxEnvelope envelopeData;
+
+        ggvector<double> phaseOffsets;
+
+        AmplitudeArr bit1Amplitude;
+        AmplitudeArr bit0Amplitude;
+
+        float ofdmPeak     = 0.0f; // peak of the current OFDM block
+        float ofdmPeakPrev = 0.0f; // peak of the previous OFDM block
+    };
+
     struct Tx {
         bool hasData = false;
 
         float sendVolume = 0.1f;
 
-        int dataLength = 0;
         int lastAmplitudeSize = 0;
 
         ggvector<bool> dataBits;
-        ggvector<double> phaseOffsets;
-
-        AmplitudeArr bit1Amplitude;
-        AmplitudeArr bit0Amplitude;
 
-        TxRxData    data;
-        TxProtocol  protocol;
         TxProtocols protocols;
 
         Amplitude    output;
@@ -1001,14 +1603,228 @@ private:
         TxRxData     outputTmp;
         AmplitudeI16 outputI16;
 
+        // inverse FFT and NCO synthesis
+        Amplitude       synth;
+        ggvector<int>   synthWorkI;
+        ggvector<float> synthWorkF;
+        ggvector<float> ncoRe;
+        ggvector<float> ncoIm;
+        ggvector<float> ncoCr;
+        ggvector<float> ncoCi;
+
+        // OFDM synthesis - the frame is assembled from the symbols that overlap it
+        Amplitude ofdmFrame;
+
         int nTones = 0;
+        bool isWideTones = false; // the tones are in tonesWide instead of tones
         Tones tones;
+        TonesWide tonesWide;
+
+        int nStreams = 0;
+        TxStream streams[kMaxTxStreams];
     } m_tx;
 
     mutable Resampler m_resampler;
 
     void * m_heap  = nullptr;
     int m_heapSize = 0;
+    bool m_heapOwned = false;
+};
+
+// Compile-time specialized GGWave instance
+//
+//   The frame size, payload length, operating mode, sample formats and the list of enabled
+//   protocols are template parameters. The memory used by the instance is computed at compile
+//   time with GGWave::Layout and placed in a member array instead of the heap, so the instance
+//   can be put in static storage on devices without dynamic memory allocation. No resampling is
+//   performed - the capture, playback and processing sample rates are the same.
+//
+//   Only the listed built-in protocols are enabled for Rx and Tx. Their shape is taken from
+//   GGWave::Protocols::kBuiltIn().
+//
+//   The constructor prepares the instance. If this fails, e.g. because of an invalid sample rate,
+//   the reason is logged, isPrepared() returns false and the instance must not be used.
+//
+//   Example of a fixed-length receiver for 8-byte payloads using the [DT] protocols:
+//
+//     static GGWaveStatic<
+//         256, 8, GGWAVE_OPERATING_MODE_RX, GGWAVE_SAMPLE_FORMAT_I16, GGWAVE_SAMPLE_FORMAT_I16,
+//         GGWAVE_PROTOCOL_DT_NORMAL, GGWAVE_PROTOCOL_DT_FAST, GGWAVE_PROTOCOL_DT_FASTEST> instance(6000.0f);
+//
+//     if (instance.isPrepared()) {
+//         instance.decode(...);
+//     }
+//
+template <
+    int kSamplesPerFrame,
+    int kPayloadLength,
+    int kOperatingMode,
+    ggwave_SampleFormat kSampleFormatInp,
+    ggwave_SampleFormat kSampleFormatOut,
+    ggwave_ProtocolId... kProtocolIds>
+class GGWaveStatic : public GGWave {
+public:
+    static_assert(sizeof...(kProtocolIds) > 0, "At least one protocol is required");
+    static_assert(kSamplesPerFrame > 0 && kSamplesPerFrame <= kMaxSamplesPerFrame, "Invalid samples per frame");
+    static_assert(kPayloadLength <= kMaxLengthFixed, "Invalid payload length");
+    static_assert((kOperatingMode & (GGWAVE_OPERATING_MODE_RX | GGWAVE_OPERATING_MODE_TX)) != 0, "Rx or Tx must be enabled");
+    static_assert((kOperatingMode & ~(GGWAVE_OPERATING_MODE_RX_AND_TX |
+                                      GGWAVE_OPERATING_MODE_TX_ONLY_TONES |
+                                      GGWAVE_OPERATING_MODE_USE_DSS |
+                                      GGWAVE_OPERATING_MODE_RX_CONTINUOUS |
+                                      GGWAVE_OPERATING_MODE_RX_ENERGY_GATE |
+                                      GGWAVE_OPERATING_MODE_TX_IFFT |
+                                      GGWAVE_OPERATING_MODE_TX_NCO |
+                                      GGWAVE_OPERATING_MODE_TX_LOW_CREST)) == 0, "Unsupported operating mode");
+
+    GGWaveStatic(float sampleRate = kDefaultSampleRate) {
+        auto parameters = getDefaultParameters();
+
+        parameters.payloadLength   = kPayloadLength;
+        parameters.sampleRateInp   = sampleRate;
+        parameters.sampleRateOut   = sampleRate;
+        parameters.sampleRate      = sampleRate;
+        parameters.samplesPerFrame = kSamplesPerFrame;
+        parameters.sampleFormatInp = kSampleFormatInp;
+        parameters.sampleFormatOut = kSampleFormatOut;
+        parameters.operatingMode   = kOperatingMode;
+
+        auto protocols = Protocols::kDefault();
+        protocols.disableAll();
+        const ProtocolId ids[] = { kProtocolIds... };
+        for (auto id : ids) {
+            protocols.toggle(id, true);
+        }
+
+        m_isPrepared = prepare(parameters, m_buffer, kHeapSize, protocols, protocols);
+    }
+
+    bool isPrepared() const { return m_isPrepared; }
+
+private:
+    // compile-time helpers over the protocol ids - the same as the GGWave helpers over the enabled protocols
+
+    static constexpr int min(int a, int b) { return a < b ? a : b; }
+    static constexpr int max(int a, int b) { return a > b ? a : b; }
+
+    static constexpr bool contains(int) { return false; }
+    template <typename... Ts>
+    static constexpr bool contains(int id, ProtocolId first, Ts... rest) {
+        return id == first || contains(id, rest...);
+    }
+
+    static constexpr bool isEnabled(int id) { return contains(id, kProtocolIds...); }
+    static constexpr Protocol protocol(int id) { return Protocols::kBuiltIn(ProtocolId(id)); }
+
+    static constexpr bool allBuiltIn(int id = 0) {
+        return id == GGWAVE_PROTOCOL_COUNT ||
+            ((isEnabled(id) == false || (protocol(id).framesPerTx > 0 && protocol(id).ofdm == false)) && allBuiltIn(id + 1));
+    }
+
+    static constexpr int minBytesPerTx(int id = 0) {
+        return id == GGWAVE_PROTOCOL_COUNT ? 1 : min(isEnabled(id) ? protocol(id).bytesPerTx : 1, minBytesPerTx(id + 1));
+    }
+
+    static constexpr int maxFramesPerTx(int id = 0) {
+        return id == GGWAVE_PROTOCOL_COUNT ? 0 :
+            max(isEnabled(id) ? protocol(id).framesPerTx*protocol(id).extra : 0, maxFramesPerTx(id + 1));
+    }
+
+    static constexpr int maxSymbolsPerTx(int id = 0) {
+        return id == GGWAVE_PROTOCOL_COUNT ? 1 : max(isEnabled(id) ? protocol(id).nSymbolsPerTx() : 0, maxSymbolsPerTx(id + 1));
+    }
+
+    static constexpr int maxSymbolTones(int id = 0) {
+        return id == GGWAVE_PROTOCOL_COUNT ? 0 : max(isEnabled(id) ? protocol(id).nSymbolTones() : 0, maxSymbolTones(id + 1));
+    }
+
+    static constexpr int maxTonesPerTx(int id = 0) {
+        return id == GGWAVE_PROTOCOL_COUNT ? 1 : max(isEnabled(id) ? protocol(id).nTones() : 0, maxTonesPerTx(id + 1));
+    }
+
+    // the tone tables also hold the marker tones
+    static constexpr int maxDataBins(int id = 0) {
+        return id == GGWAVE_PROTOCOL_COUNT ? 2*kBitsInMarker : max(isEnabled(id) ? protocol(id).nDataBins() : 0, maxDataBins(id + 1));
+    }
+
+    static constexpr int slots(int id = 0) {
+        return id == GGWAVE_PROTOCOL_COUNT ? 0 : (isEnabled(id) ? 1 : 0) + slots(id + 1);
+    }
+
+    // number of distinct start frequencies
+    static constexpr bool hasBand(int freqStart, int id) {
+        return id >= 0 && ((isEnabled(id) && protocol(id).freqStart == freqStart) || hasBand(freqStart, id - 1));
+    }
+
+    static constexpr int bands(int id = 0) {
+        return id == GGWAVE_PROTOCOL_COUNT ? 0 :
+            (isEnabled(id) && hasBand(protocol(id).freqStart, id - 1) == false ? 1 : 0) + bands(id + 1);
+    }
+
+    static constexpr int sampleSize(SampleFormat format) {
+        return format == GGWAVE_SAMPLE_FORMAT_F32 ? 4 :
+              (format == GGWAVE_SAMPLE_FORMAT_U16 || format == GGWAVE_SAMPLE_FORMAT_I16) ? 2 :
+              (format == GGWAVE_SAMPLE_FORMAT_U8  || format == GGWAVE_SAMPLE_FORMAT_I8)  ? 1 : 0;
+    }
+
+    static constexpr bool isPow2(int n) { return (n & (n - 1)) == 0; }
+
+    static constexpr bool kIsFixed      = kPayloadLength > 0;
+    static constexpr bool kIsRx         = (kOperatingMode & GGWAVE_OPERATING_MODE_RX) != 0;
+    static constexpr bool kIsTxIFFT     = (kOperatingMode & GGWAVE_OPERATING_MODE_TX_IFFT) != 0;
+    static constexpr bool kIsTxNCO      = (kOperatingMode & GGWAVE_OPERATING_MODE_TX_NCO) != 0 ||
+                                          ((kOperatingMode & GGWAVE_OPERATING_MODE_TX_LOW_CREST) != 0 && kIsTxIFFT == false);
+    static constexpr int  kBitsInMarker = 16; // see GGWave::prepare()
+
+    static_assert(allBuiltIn(), "Only built-in protocols are supported");
+    static_assert(sampleSize(kSampleFormatInp) > 0 && sampleSize(kSampleFormatOut) > 0, "Invalid sample format");
+    static_assert((kIsTxIFFT && (kOperatingMode & GGWAVE_OPERATING_MODE_TX_NCO) != 0) == false, "IFFT and NCO synthesis cannot be used together");
+    static_assert(kIsTxIFFT == false || isPow2(kSamplesPerFrame), "IFFT synthesis requires a power-of-2 number of samples per frame");
+#ifdef GGWAVE_CONFIG_FIXED_POINT
+    static_assert((kIsRx && kIsFixed) == false || isPow2(kSamplesPerFrame), "The fixed-point FFT requires a power-of-2 number of samples per frame");
+#endif
+
+    static constexpr Layout layout() {
+        return Layout {
+            kSamplesPerFrame,
+            sampleSize(kSampleFormatInp),
+            sampleSize(kSampleFormatOut),
+            1,
+            GGWAVE_CHANNEL_MODE_DOWNMIX,
+            kIsFixed ? kPayloadLength : -1,
+            kBitsInMarker,
+
+            kIsRx,
+            (kOperatingMode & GGWAVE_OPERATING_MODE_TX) != 0,
+            false,
+            false,
+            false,
+            false,
+            false,
+            (kOperatingMode & GGWAVE_OPERATING_MODE_TX_ONLY_TONES) != 0,
+            kIsTxIFFT,
+            kIsTxNCO,
+
+            minBytesPerTx(),
+            maxFramesPerTx(),
+            maxSymbolsPerTx(),
+            kIsFixed ? maxSymbolTones()*maxSymbolsPerTx() : 0,
+            kIsFixed ? slots() : 0,
+            kIsFixed ? 0 : bands(),
+            minBytesPerTx(),
+            maxDataBins(),
+            maxTonesPerTx(),
+            false,
+        };
+    }
+
+public:
+    static constexpr int kHeapSize = layout().heapSize();
+
+private:
+    bool m_isPrepared = false;
+
+    alignas(8) uint8_t m_buffer[kHeapSize];
 };
 
 #endif
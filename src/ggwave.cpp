@@ -26,6 +26,24 @@
 #endif
 #endif
 
+// SIMD kernels for the tone detection and synthesis - define GGWAVE_NO_SIMD to force the scalar code
+#if !defined(ARDUINO) && !defined(GGWAVE_NO_SIMD)
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define GGWAVE_SIMD_AVX2
+#define GGWAVE_SIMD_SSE2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define GGWAVE_SIMD_SSE2
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define GGWAVE_SIMD_NEON
+#endif
+#if defined(GGWAVE_SIMD_SSE2) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
 #define GG_MIN(A, B) (((A) < (B)) ? (A) : (B))
 #define GG_MAX(A, B) (((A) >= (B)) ? (A) : (B))
 
@@ -67,7 +85,9 @@ ggwave_Instance ggwave_init(ggwave_Parameters parameters) {
                 parameters.soundMarkerThreshold,
                 parameters.sampleFormatInp,
                 parameters.sampleFormatOut,
-                parameters.operatingMode});
+                parameters.operatingMode,
+                parameters.channelsInp,
+                parameters.channelMode});
 
             return id;
         }
@@ -153,6 +173,9 @@ int ggwave_decode(
     if (dataLength == -1) {
         // failed to decode message
         return -1;
+    } else if (dataLength > GGWave::kMaxDataSize) {
+        // the payloadBuffer is assumed to be GGWave::kMaxDataSize bytes - use ggwave_ndecode for long payloads
+        return -2;
     } else if (dataLength > 0) {
         memcpy(payloadBuffer, data.data(), dataLength);
     }
@@ -258,1802 +281,4449 @@ void FFT(const float * src, float * dst, int N, int * wi, float * wf) {
     FFT(dst, N, wi, wf);
 }
 
-inline void addAmplitudeSmooth(
-        const GGWave::Amplitude & src,
-        GGWave::Amplitude & dst,
-        float scalar, int startId, int finalId, int cycleMod, int nPerCycle) {
-    const int nTotal = nPerCycle*finalId;
-    const float frac = 0.15f;
-    const float ds = frac*nTotal;
-    const float ids = 1.0f/ds;
-    const int nBegin = frac*nTotal;
-    const int nEnd = (1.0f - frac)*nTotal;
-
-    for (int i = startId; i < finalId; i++) {
-        const float k = cycleMod*finalId + i;
-        if (k < nBegin) {
-            dst[i] += scalar*src[i]*(k*ids);
-        } else if (k > nEnd) {
-            dst[i] += scalar*src[i]*(((float)(nTotal) - k)*ids);
-        } else {
-            dst[i] += scalar*src[i];
-        }
-    }
-}
+#ifdef GGWAVE_CONFIG_FIXED_POINT
+
+// quarter period of a Q15 sine, 1024 steps per period
+constexpr int kSineQ15Size = 257;
+const int16_t kSineQ15[kSineQ15Size] PROGMEM = {
+    0, 201, 402, 603, 804, 1005, 1206, 1407, 1608, 1809, 2009, 2210, 2410, 2611, 2811, 3012,
+    3212, 3412, 3612, 3811, 4011, 4210, 4410, 4609, 4808, 5007, 5205, 5404, 5602, 5800, 5998, 6195,
+    6393, 6590, 6786, 6983, 7179, 7375, 7571, 7767, 7962, 8157, 8351, 8545, 8739, 8933, 9126, 9319,
+    9512, 9704, 9896, 10087, 10278, 10469, 10659, 10849, 11039, 11228, 11417, 11605, 11793, 11980, 12167, 12353,
+    12539, 12725, 12910, 13094, 13279, 13462, 13645, 13828, 14010, 14191, 14372, 14553, 14732, 14912, 15090, 15269,
+    15446, 15623, 15800, 15976, 16151, 16325, 16499, 16673, 16846, 17018, 17189, 17360, 17530, 17700, 17869, 18037,
+    18204, 18371, 18537, 18703, 18868, 19032, 19195, 19357, 19519, 19680, 19841, 20000, 20159, 20317, 20475, 20631,
+    20787, 20942, 21096, 21250, 21403, 21554, 21705, 21856, 22005, 22154, 22301, 22448, 22594, 22739, 22884, 23027,
+    23170, 23311, 23452, 23592, 23731, 23870, 24007, 24143, 24279, 24413, 24547, 24680, 24811, 24942, 25072, 25201,
+    25329, 25456, 25582, 25708, 25832, 25955, 26077, 26198, 26319, 26438, 26556, 26674, 26790, 26905, 27019, 27133,
+    27245, 27356, 27466, 27575, 27683, 27790, 27896, 28001, 28105, 28208, 28310, 28411, 28510, 28609, 28706, 28803,
+    28898, 28992, 29085, 29177, 29268, 29358, 29447, 29534, 29621, 29706, 29791, 29874, 29956, 30037, 30117, 30195,
+    30273, 30349, 30424, 30498, 30571, 30643, 30714, 30783, 30852, 30919, 30985, 31050, 31113, 31176, 31237, 31297,
+    31356, 31414, 31470, 31526, 31580, 31633, 31685, 31736, 31785, 31833, 31880, 31926, 31971, 32014, 32057, 32098,
+    32137, 32176, 32213, 32250, 32285, 32318, 32351, 32382, 32412, 32441, 32469, 32495, 32521, 32545, 32567, 32589,
+    32609, 32628, 32646, 32663, 32678, 32692, 32705, 32717, 32728, 32737, 32745, 32752, 32757, 32761, 32765, 32766,
+    32767,
+};
 
-int getECCBytesForLength(int len) {
-    return len < 4 ? 2 : GG_MAX(4, 2*(len/5));
+int32_t getSineQ15(int i) {
+#ifdef ARDUINO
+    return (int16_t) pgm_read_word(&kSineQ15[i]);
+#else
+    return kSineQ15[i];
+#endif
 }
 
-int bytesForSampleFormat(GGWave::SampleFormat sampleFormat) {
-    switch (sampleFormat) {
-        case GGWAVE_SAMPLE_FORMAT_UNDEFINED:    return 0;                   break;
-        case GGWAVE_SAMPLE_FORMAT_U8:           return sizeof(uint8_t);     break;
-        case GGWAVE_SAMPLE_FORMAT_I8:           return sizeof(int8_t);      break;
-        case GGWAVE_SAMPLE_FORMAT_U16:          return sizeof(uint16_t);    break;
-        case GGWAVE_SAMPLE_FORMAT_I16:          return sizeof(int16_t);     break;
-        case GGWAVE_SAMPLE_FORMAT_F32:          return sizeof(float);       break;
-    };
+// Q15 sine of a 32-bit phase (2^32 is a full period), linearly interpolated between the table entries
+int32_t sinQ15(uint32_t phase) {
+    const int quarter = phase >> 30;
+    const int i       = (phase >> 22) & 255;
+    const int32_t t   = (phase >> 6) & 0xFFFF;
 
-    ggprintf("Invalid sample format: %d\n", (int) sampleFormat);
+    const int32_t a = getSineQ15(quarter & 1 ? 256 - i : i);
+    const int32_t b = getSineQ15(quarter & 1 ? 255 - i : i + 1);
+    const int32_t y = a + (((b - a)*t + 32768) >> 16);
 
-    return 0;
+    return quarter & 2 ? -y : y;
 }
 
+int32_t cosQ15(uint32_t phase) {
+    return sinQ15(phase + 0x40000000);
 }
 
-//
-// ggvector
-//
+// in-place radix-2 FFT of n = 2^log2n complex Q15 points (interleaved re, im)
+// every stage is scaled by 1/2, so the result is scaled by 1/n and cannot overflow for inputs with
+// components below 2^14
+void fftQ15(int16_t * z, int log2n) {
+    const int n = 1 << log2n;
 
-template<typename T>
-void ggvector<T>::assign(const ggvector & other) {
-    m_data = other.m_data;
-    m_size = other.m_size;
-}
+    for (int i = 1, j = 0; i < n; ++i) {
+        int bit = n >> 1;
+        for (; j & bit; bit >>= 1) {
+            j ^= bit;
+        }
+        j ^= bit;
 
-template<typename T>
-void ggvector<T>::copy(const ggvector & other) {
-    if (this == &other) {
-        assert(false);
+        if (i < j) {
+            int16_t t;
+            t = z[2*i + 0]; z[2*i + 0] = z[2*j + 0]; z[2*j + 0] = t;
+            t = z[2*i + 1]; z[2*i + 1] = z[2*j + 1]; z[2*j + 1] = t;
+        }
     }
 
-    memcpy(m_data, other.m_data, GG_MIN(m_size, other.m_size)*sizeof(T));
-}
+    for (int s = 1; s <= log2n; ++s) {
+        const int half = 1 << (s - 1);
 
-template<typename T>
-void ggvector<T>::zero() {
-    memset(m_data, 0, m_size*sizeof(T));
-}
+        for (int j = 0; j < half; ++j) {
+            // exp(-2*pi*i*j/2^s)
+            const uint32_t phase = uint32_t(j) << (32 - s);
+            const int32_t wr =  cosQ15(phase);
+            const int32_t wi = -sinQ15(phase);
 
-template<typename T>
-void ggvector<T>::zero(int n) {
-    memset(m_data, 0, n*sizeof(T));
+            for (int i = j; i < n; i += 2*half) {
+                int16_t * a = z + 2*i;
+                int16_t * b = z + 2*(i + half);
+
+                const int32_t tr = (b[0]*wr - b[1]*wi + (1 << 14)) >> 15;
+                const int32_t ti = (b[0]*wi + b[1]*wr + (1 << 14)) >> 15;
+
+                b[0] = (a[0] - tr) >> 1;
+                b[1] = (a[1] - ti) >> 1;
+                a[0] = (a[0] + tr) >> 1;
+                a[1] = (a[1] + ti) >> 1;
+            }
+        }
+    }
 }
 
-template struct ggvector<int16_t>;
+// power spectrum of n = 2^log2n real samples in bins [0, n/2], computed with an n/2-point complex FFT
+//   the samples are converted to Q15 and shifted to use the full range of the FFT, so the power is
+//   relative - the returned shift is the power of 2 that the samples were scaled by
+//   z is a work buffer of n values
+int powerSpectrumQ15(const float * src, int16_t * z, uint32_t * dst, int log2n) {
+    const int n = 1 << log2n;
+    const int m = n/2;
+
+    int32_t xmax = 0;
+    for (int i = 0; i < n; ++i) {
+        const int32_t x = GG_MIN(32767, GG_MAX(-32768, (int32_t) round(src[i]*32768.0f)));
+        xmax = GG_MAX(xmax, x < 0 ? -x : x);
+        z[i] = x;
+    }
 
-//
-// ggmatrix
-//
+    // block floating point - the largest sample is brought in [2^13, 2^14)
+    int shift = 0;
+    if (xmax >= (1 << 14)) {
+        shift = -1;
+        for (int i = 0; i < n; ++i) {
+            z[i] >>= 1;
+        }
+    } else if (xmax > 0) {
+        while ((xmax << (shift + 1)) < (1 << 14)) {
+            ++shift;
+        }
+        for (int i = 0; i < n; ++i) {
+            z[i] *= (1 << shift);
+        }
+    }
 
-template <typename T>
-void ggmatrix<T>::zero() {
-    if (m_size0 > 0 && m_size1 > 0) {
-        memset(m_data, 0, m_size0*m_size1*sizeof(T));
+    // the even and odd samples are the real and imaginary parts of m complex points
+    fftQ15(z, log2n - 1);
+
+    for (int k = 0; k <= m; ++k) {
+        const int16_t * zk = z + 2*(k%m);
+        const int16_t * zm = z + 2*((m - k)%m);
+
+        // spectra of the even and odd samples
+        const int32_t fr = (int32_t(zk[0]) + zm[0]) >> 1;
+        const int32_t fi = (int32_t(zk[1]) - zm[1]) >> 1;
+        const int32_t gr = (int32_t(zk[1]) + zm[1]) >> 1;
+        const int32_t gi = (int32_t(zm[0]) - zk[0]) >> 1;
+
+        // exp(-2*pi*i*k/n)
+        const uint32_t phase = uint32_t(k) << (32 - log2n);
+        const int32_t c = cosQ15(phase);
+        const int32_t s = sinQ15(phase);
+
+        const int32_t xr = (fr + ((c*gr + s*gi + (1 << 14)) >> 15)) >> 1;
+        const int32_t xi = (fi + ((c*gi - s*gr + (1 << 14)) >> 15)) >> 1;
+
+        dst[k] = uint32_t(xr*xr) + uint32_t(xi*xi);
     }
+
+    return shift;
 }
 
-//
-// Protocols
-//
+#endif
 
-void GGWave::Protocols::enableAll() {
-    for (int i = 0; i < GGWAVE_PROTOCOL_COUNT; i++) {
-        auto & p = this->data[i];
-        if (p.name) {
-            p.enabled = true;
+// convert interleaved multi-channel samples to 32-bit float
+//   dstMix receives the average of all channels
+//   if dstChannels is not null, channel c is also stored in (*dstChannels)[c], starting at offset
+template <typename T>
+void convertChannels(
+        const T * src, int nSamples, int nChannels, float bias, float scale,
+        float * dstMix, GGWave::AmplitudeArr * dstChannels, int offset) {
+    const float scaleMix = scale/nChannels;
+
+    for (int i = 0; i < nSamples; ++i) {
+        float sum = 0.0f;
+        for (int c = 0; c < nChannels; ++c) {
+            sum += float(src[i*nChannels + c]) - bias;
         }
+        dstMix[i] = sum*scaleMix;
     }
-}
 
-void GGWave::Protocols::disableAll() {
-    for (int i = 0; i < GGWAVE_PROTOCOL_COUNT; i++) {
-        auto & p = this->data[i];
-        p.enabled = false;
+    if (dstChannels) {
+        for (int c = 0; c < nChannels; ++c) {
+            auto dst = (*dstChannels)[c].data() + offset;
+            for (int i = 0; i < nSamples; ++i) {
+                dst[i] = (float(src[i*nChannels + c]) - bias)*scale;
+            }
+        }
     }
 }
 
-void GGWave::Protocols::toggle(ProtocolId id, bool state) {
-    if (state) {
-        // enable protocol
-        data[id].enabled = true;
-    } else {
-        // disable protocol
-        data[id].enabled = false;
+// dst[i] += scalar*src[i]*((a + s*k)*ids), k = k0 + i
+//
+//   The linear ramps of the tone envelope: a = 0, s = 1 for the fade-in and a = nTotal, s = -1 for the fade-out
+//
+inline void addRamp(float * dst, const float * src, float scalar, float a, float s, int k0, float ids, int n) {
+    int i = 0;
+#if defined(GGWAVE_SIMD_SSE2)
+    const __m128  va  = _mm_set1_ps(a);
+    const __m128  vs  = _mm_set1_ps(s);
+    const __m128  vid = _mm_set1_ps(ids);
+    const __m128  vsc = _mm_set1_ps(scalar);
+    const __m128i v4  = _mm_set1_epi32(4);
+
+    __m128i vk = _mm_add_epi32(_mm_set1_epi32(k0), _mm_setr_epi32(0, 1, 2, 3));
+    for (; i + 4 <= n; i += 4) {
+        const __m128 g = _mm_mul_ps(_mm_add_ps(va, _mm_mul_ps(vs, _mm_cvtepi32_ps(vk))), vid);
+        _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_mul_ps(_mm_mul_ps(vsc, _mm_loadu_ps(src + i)), g)));
+        vk = _mm_add_epi32(vk, v4);
+    }
+#elif defined(GGWAVE_SIMD_NEON)
+    const float32x4_t va  = vdupq_n_f32(a);
+    const float32x4_t vs  = vdupq_n_f32(s);
+    const float32x4_t vid = vdupq_n_f32(ids);
+    const float32x4_t vsc = vdupq_n_f32(scalar);
+    const int32x4_t   v4  = vdupq_n_s32(4);
+    const int32x4_t   i0  = { 0, 1, 2, 3 };
+
+    int32x4_t vk = vaddq_s32(vdupq_n_s32(k0), i0);
+    for (; i + 4 <= n; i += 4) {
+        const float32x4_t g = vmulq_f32(vaddq_f32(va, vmulq_f32(vs, vcvtq_f32_s32(vk))), vid);
+        vst1q_f32(dst + i, vaddq_f32(vld1q_f32(dst + i), vmulq_f32(vmulq_f32(vsc, vld1q_f32(src + i)), g)));
+        vk = vaddq_s32(vk, v4);
+    }
+#endif
+    for (; i < n; ++i) {
+        const float k = k0 + i;
+        dst[i] += scalar*src[i]*((a + s*k)*ids);
     }
 }
 
-void GGWave::Protocols::only(ProtocolId id) {
-    disableAll();
-    data[id].enabled = true;
+// dst[i] += scalar*src[i]
+inline void addScaled(float * dst, const float * src, float scalar, int n) {
+    int i = 0;
+#if defined(GGWAVE_SIMD_SSE2)
+    const __m128 vsc = _mm_set1_ps(scalar);
+    for (; i + 4 <= n; i += 4) {
+        _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_mul_ps(vsc, _mm_loadu_ps(src + i))));
+    }
+#elif defined(GGWAVE_SIMD_NEON)
+    const float32x4_t vsc = vdupq_n_f32(scalar);
+    for (; i + 4 <= n; i += 4) {
+        vst1q_f32(dst + i, vaddq_f32(vld1q_f32(dst + i), vmulq_f32(vsc, vld1q_f32(src + i))));
+    }
+#endif
+    for (; i < n; ++i) {
+        dst[i] += scalar*src[i];
+    }
 }
 
-GGWave::TxProtocols & GGWave::Protocols::tx() {
-    static TxProtocols protocols = kDefault();
+// Envelope of a tone that lasts nPerCycle frames - linear fade-in and fade-out over 15% of the samples
+GGWave::TxEnvelope getEnvelope(int nPerCycle, int samplesPerFrame) {
+    const int nTotal = nPerCycle*samplesPerFrame;
+    const float frac = 0.15f;
+    const float ds = frac*nTotal;
 
-    return protocols;
+    GGWave::TxEnvelope result;
+    result.nTotal = nTotal;
+    result.nBegin = frac*nTotal;
+    result.nEnd   = (1.0f - frac)*nTotal;
+    result.ids    = 1.0f/ds;
+
+    return result;
 }
 
-GGWave::RxProtocols & GGWave::Protocols::rx() {
-    static RxProtocols protocols = kDefault();
+// Add frame cycleMod of a tone with the given envelope to dst
+//
+//   The frame is split into the fade-in, flat and fade-out segments of the envelope, so that
+//   none of the loops has to branch on the sample position
+//
+inline void addAmplitudeSmooth(
+        const GGWave::Amplitude & src,
+        GGWave::Amplitude & dst,
+        float scalar, const GGWave::TxEnvelope & envelope, int cycleMod, int n) {
+    const int k0 = cycleMod*n;
 
-    return protocols;
-}
+    // samples with k < nBegin and k > nEnd
+    const int i1 = GG_MIN(n, GG_MAX(0, envelope.nBegin - k0));
+    const int i2 = GG_MIN(n, GG_MAX(i1, envelope.nEnd - k0 + 1));
 
-// this probably does not matter, but adding it anyway
-#ifdef ARDUINO
-const int kAlignment = 4;
-#else
-const int kAlignment = 8;
-#endif
+    ::addRamp  (dst.data(),      src.data(),      scalar, 0.0f, 1.0f, k0, envelope.ids, i1);
+    ::addScaled(dst.data() + i1, src.data() + i1, scalar, i2 - i1);
+    ::addRamp  (dst.data() + i2, src.data() + i2, scalar, (float) envelope.nTotal, -1.0f, k0 + i2, envelope.ids, n - i2);
+}
 
-//template <typename T>
-//void ggalloc(std::vector<T> & v, int n, void * buf, int & bufSize) {
-//    if (buf == nullptr) {
-//        bufSize += n*sizeof(T);
-//        bufSize = ((bufSize + kAlignment - 1)/kAlignment)*kAlignment;
-//        return;
-//    }
-//
-//    v.resize(n);
-//    bufSize += n*sizeof(T);
-//    bufSize = ((bufSize + kAlignment - 1)/kAlignment)*kAlignment;
-//}
+// Reed-Solomon decoding with soft-decision hints
 //
-//template <typename T>
-//void ggalloc(std::vector<std::vector<T>> & v, int n, int m, void * buf, int & bufSize) {
-//    if (buf == nullptr) {
-//        bufSize += n*m*sizeof(T);
-//        bufSize = ((bufSize + kAlignment - 1)/kAlignment)*kAlignment;
-//        return;
-//    }
+//   If the hard-decision decoding fails, retry by marking the least reliable bytes as erasures.
+//   RS can correct twice as many erasures as errors, but every erasure also reduces the
+//   redundancy left for detecting a wrong correction. Therefore, at most half of the ECC bytes
+//   are erased and the result is accepted only if at least 2 ECC bytes were not needed
 //
-//    v.resize(n);
-//    for (int i = 0; i < n; i++) {
-//        v[i].resize(m);
-//    }
-//    bufSize += n*m*sizeof(T);
-//    bufSize = ((bufSize + kAlignment - 1)/kAlignment)*kAlignment;
-//}
+int decodeRS(RS::ReedSolomon & rs, const uint8_t * src, uint8_t * dst, const float * confidence, uint8_t * erasures) {
+    // the syndromes tell if the hard-decision decoding can succeed at all
+    const int check = rs.Check(src);
+    if (check == 0) {
+        memcpy(dst, src, rs.msg_length);
+        return 0;
+    }
 
-template <typename T>
-void ggalloc(ggvector<T> & v, int n, void * buf, int & bufSize) {
-    if (buf == nullptr) {
-        bufSize += n*sizeof(T);
-        bufSize = ((bufSize + kAlignment - 1)/kAlignment)*kAlignment;
-        return;
+    if (check > 0 && rs.Decode(src, dst) == 0) {
+        return 0;
     }
 
-    v.assign(ggvector<T>((T *)((char *) buf + bufSize), n));
-    bufSize += n*sizeof(T);
-    bufSize = ((bufSize + kAlignment - 1)/kAlignment)*kAlignment;
-}
+    const int nTotal = rs.msg_length + rs.ecc_length;
+    const int nTries[] = { rs.ecc_length/4, rs.ecc_length/2 };
 
-template <typename T>
-void ggalloc(ggmatrix<T> & v, int n, int m, void * buf, int & bufSize) {
-    if (buf == nullptr) {
-        bufSize += n*m*sizeof(T);
-        bufSize = ((bufSize + kAlignment - 1) / kAlignment)*kAlignment;
-        return;
+    int nErasures = 0;
+    for (int nMax : nTries) {
+        if (nMax <= nErasures || rs.ecc_length - nMax < 2) {
+            continue;
+        }
+
+        // add the next least reliable bytes
+        for (; nErasures < nMax; ++nErasures) {
+            int best = -1;
+            for (int i = 0; i < nTotal; ++i) {
+                bool isErased = false;
+                for (int j = 0; j < nErasures; ++j) {
+                    if (erasures[j] == i) {
+                        isErased = true;
+                        break;
+                    }
+                }
+
+                if (isErased == false && (best == -1 || confidence[i] < confidence[best])) {
+                    best = i;
+                }
+            }
+            erasures[nErasures] = best;
+        }
+
+        // a rejected result must not overwrite dst, which may still hold the previous payload
+        if (rs.Decode(src, dst, erasures, nErasures, (rs.ecc_length - 2 - nErasures)/2) == 0) {
+            return 0;
+        }
     }
 
-    v = ggmatrix<T>((T *)((char *) buf + bufSize), n, m);
-    bufSize += n*m*sizeof(T);
-    bufSize = ((bufSize + kAlignment - 1)/kAlignment)*kAlignment;
+    return 1;
 }
 
+// Reed-Solomon decoding of a candidate offset in the variable-length analysis
 //
-// GGWave
+//   Up to 256 offsets are tried per protocol, so a word with more errors than the ECC can handle
+//   is often silently "corrected" into a different payload. Therefore, unlike decodeRS(), the
+//   decoding keeps 2 ECC bytes in reserve. If the hard-decision decoding needs them, retry by
+//   marking up to half of the ECC bytes, the least reliable ones, as erasures.
+//
+//   A correction that uses the reserve is accepted only if all corrected bytes are unreliable -
+//   not more reliable than the ecc_length/2 least reliable ones. With isStrict, it is not applied
+//   and 2 is returned instead - the caller may prefer a different candidate that does not need it.
+//
+//   Returns 0 on success. On failure, dst is not modified - it may still hold the previous payload
 //
+int decodeRSCandidate(RS::ReedSolomon & rs, const uint8_t * src, uint8_t * dst, const float * confidence, uint8_t * erasures, bool isStrict) {
+    // the syndromes tell if the hard-decision decoding can succeed at all
+    const int check = rs.Check(src, true);
+    if (check == 0) {
+        memcpy(dst, src, rs.msg_length);
+        return 0;
+    }
 
-GGWave::GGWave(const Parameters & parameters) {
-    prepare(parameters);
-}
+    // ECC bytes that are kept for detecting a wrong correction
+    constexpr int kReserve = 2;
 
-GGWave::~GGWave() {
-    if (m_heap) {
-        free(m_heap);
+    if (check > 0 && 2*(int) rs.errors_found <= rs.ecc_length - kReserve) {
+        return rs.Decode(src, dst);
     }
-}
 
-bool GGWave::prepare(const Parameters & parameters, bool allocate) {
-    if (m_heap) {
-        free(m_heap);
-        m_heap = nullptr;
-        m_heapSize = 0;
+    const int nTotal = rs.msg_length + rs.ecc_length;
+
+    // the least reliable bytes, in order
+    const int nLeast = GG_MAX(1, rs.ecc_length/2);
+    for (int k = 0; k < nLeast; ++k) {
+        int best = -1;
+        for (int i = 0; i < nTotal; ++i) {
+            bool isErased = false;
+            for (int j = 0; j < k; ++j) {
+                if (erasures[j] == i) {
+                    isErased = true;
+                    break;
+                }
+            }
+
+            if (isErased == false && (best == -1 || confidence[i] < confidence[best])) {
+                best = i;
+            }
+        }
+        erasures[k] = best;
     }
 
-    // parameter initialization:
+    const int nTries[] = { rs.ecc_length/4, rs.ecc_length/2 };
 
-    m_sampleRateInp        = parameters.sampleRateInp;
-    m_sampleRateOut        = parameters.sampleRateOut;
-    m_sampleRate           = parameters.sampleRate;
-    m_samplesPerFrame      = parameters.samplesPerFrame;
-    m_isamplesPerFrame     = 1.0f/m_samplesPerFrame;
-    m_sampleSizeInp        = bytesForSampleFormat(parameters.sampleFormatInp);
-    m_sampleSizeOut        = bytesForSampleFormat(parameters.sampleFormatOut);
-    m_sampleFormatInp      = parameters.sampleFormatInp;
-    m_sampleFormatOut      = parameters.sampleFormatOut;
-    m_hzPerSample          = m_sampleRate/m_samplesPerFrame;
-    m_ihzPerSample         = 1.0f/m_hzPerSample;
-    m_freqDelta_bin        = 1;
-    m_freqDelta_hz         = 2*m_hzPerSample;
-    m_nBitsInMarker        = 16;
-    m_nMarkerFrames        = parameters.payloadLength > 0 ? 0 : kDefaultMarkerFrames;
-    m_encodedDataOffset    = parameters.payloadLength > 0 ? 0 : kDefaultEncodedDataOffset;
-    m_soundMarkerThreshold = parameters.soundMarkerThreshold;
-    m_isFixedPayloadLength = parameters.payloadLength > 0;
-    m_payloadLength        = parameters.payloadLength;
-    m_isRxEnabled          = parameters.operatingMode & GGWAVE_OPERATING_MODE_RX;
-    m_isTxEnabled          = parameters.operatingMode & GGWAVE_OPERATING_MODE_TX;
-    m_needResampling       = m_sampleRateInp != m_sampleRate || m_sampleRateOut != m_sampleRate;
-    m_txOnlyTones          = parameters.operatingMode & GGWAVE_OPERATING_MODE_TX_ONLY_TONES;
-    m_isDSSEnabled         = parameters.operatingMode & GGWAVE_OPERATING_MODE_USE_DSS;
+    int nErasures = 0;
+    for (int nMax : nTries) {
+        if (nMax <= nErasures || rs.ecc_length - nMax < kReserve) {
+            continue;
+        }
+        nErasures = nMax;
 
-    if (m_sampleSizeInp == 0) {
-        ggprintf("Invalid or unsupported capture sample format: %d\n", (int) parameters.sampleFormatInp);
-        return false;
+        if (rs.Decode(src, dst, erasures, nErasures, (rs.ecc_length - kReserve - nErasures)/2) == 0) {
+            return 0;
+        }
     }
 
-    if (m_sampleSizeOut == 0) {
-        ggprintf("Invalid or unsupported playback sample format: %d\n", (int) parameters.sampleFormatOut);
-        return false;
+    if (check < 0) {
+        return 1;
     }
 
-    if (parameters.samplesPerFrame > kMaxSamplesPerFrame) {
-        ggprintf("Invalid samples per frame: %d, max: %d\n", parameters.samplesPerFrame, kMaxSamplesPerFrame);
-        return false;
+    for (int i = 0; i < (int) rs.errors_found; ++i) {
+        if (confidence[rs.error_position(i)] > confidence[erasures[nLeast - 1]]) {
+            return 1;
+        }
     }
 
-    if (m_sampleRateInp < kSampleRateMin) {
-        ggprintf("Error: capture sample rate (%g Hz) must be >= %g Hz\n", m_sampleRateInp, kSampleRateMin);
-        return false;
+    if (isStrict) {
+        return 2;
     }
 
-    if (m_sampleRateInp > kSampleRateMax) {
-        ggprintf("Error: capture sample rate (%g Hz) must be <= %g Hz\n", m_sampleRateInp, kSampleRateMax);
-        return false;
-    }
-
-    // memory allocation:
+    return rs.Decode(src, dst);
+}
 
-    m_heap = nullptr;
-    m_heapSize = 0;
+int getECCBytesForLength(int len) {
+    return GGWave::eccBytesForLength(len);
+}
 
-    if (this->alloc(m_heap, m_heapSize) == false) {
-        ggprintf("Error: failed to compute the size of the required memory\n");
-        return false;
-    }
+// Long payloads
+//
+//   A payload longer than kMaxLengthVariable is sent as a sequence of blocks:
+//
+//     [sequence number][length][kLongBlockLength bytes of data]
+//
+//   Each block is protected with its own Reed-Solomon code. The length byte of the
+//   transmission stores kMaxLengthVariable + number of blocks
+//
+constexpr int kLongBlockHeader  = GGWave::kLongBlockHeader;
+constexpr int kLongBlockSize    = kLongBlockHeader + GGWave::kLongBlockLength;
+constexpr int kLongBlockEncoded = kLongBlockSize + GGWave::eccBytesForLength(kLongBlockSize);
+constexpr int kMaxLongBlocks    = GGWave::kMaxLengthLong/GGWave::kLongBlockLength;
 
-    if (allocate == false) {
-        return true;
-    }
+static_assert(GGWave::kMaxLengthVariable + kMaxLongBlocks <= 255, "The number of blocks must fit in the length byte");
+static_assert(kLongBlockSize <= GGWave::kMaxLengthVariable, "The blocks must fit in the Reed-Solomon work buffers");
 
-    const auto heapSize0 = m_heapSize;
+static_assert(GGWave::Layout::rsWorkSize(kLongBlockSize, GGWave::eccBytesForLength(kLongBlockSize)) ==
+              RS::ReedSolomon::getWorkSize_bytes(kLongBlockSize, GGWave::eccBytesForLength(kLongBlockSize)),
+              "The memory layout must match the Reed-Solomon work buffers");
 
-    m_heap = calloc(m_heapSize, 1);
+int getLongBlocks(int len) {
+    return (len + GGWave::kLongBlockLength - 1)/GGWave::kLongBlockLength;
+}
 
-    m_heapSize = 0;
-    if (this->alloc(m_heap, m_heapSize) == false) {
-        ggprintf("Error: failed to allocate the required memory: %d\n", m_heapSize);
-        return false;
+// number of bytes of the encoded payload, without the length
+int getEncodedLength(int len) {
+    if (len > GGWave::kMaxLengthVariable) {
+        return getLongBlocks(len)*kLongBlockEncoded;
     }
 
-    if (heapSize0 != m_heapSize) {
-        ggprintf("Error: failed to allocate memory - heapSize0: %d, heapSize: %d\n", heapSize0, m_heapSize);
-        return false;
-    }
+    return len + getECCBytesForLength(len);
+}
 
-    if (m_isRxEnabled) {
-        m_rx.samplesNeeded = m_samplesPerFrame;
+// Decode the blocks of a long payload
+//
+//   The blocks are decoded in place: block i is written at offset i*kLongBlockLength of dst
+//   and its header is then dropped, so dst must have kLongBlockHeader bytes of extra space
+//
+//   Returns the length of the payload or -1 if any of the blocks is invalid
+//
+int decodeLong(uint8_t * workRS, int nBlocks, const uint8_t * src, const float * confidence, uint8_t * erasures, uint8_t * dst) {
+    RS::ReedSolomon rs(kLongBlockSize, getECCBytesForLength(kLongBlockSize), workRS);
 
-        m_rx.fftWorkI[0] = 0;
+    int length = 0;
+    for (int i = 0; i < nBlocks; ++i) {
+        uint8_t * block = dst + i*GGWave::kLongBlockLength;
 
-        m_rx.protocol   = {};
-        m_rx.protocolId = GGWAVE_PROTOCOL_COUNT;
-        m_rx.protocols  = Protocols::rx();
+        if (::decodeRS(rs, src + i*kLongBlockEncoded, block, confidence + i*kLongBlockEncoded, erasures) != 0) {
+            return -1;
+        }
 
-        m_rx.minFreqStart = minFreqStart(m_rx.protocols);
-    }
+        // all blocks but the last one are full
+        const int n = block[1];
+        if (block[0] != i || n == 0 || n > GGWave::kLongBlockLength || (i < nBlocks - 1 && n < GGWave::kLongBlockLength)) {
+            return -1;
+        }
 
-    if (m_isTxEnabled) {
-        m_tx.protocols = Protocols::tx();
+        memmove(block, block + kLongBlockHeader, GGWave::kLongBlockLength);
+        length += n;
     }
 
-    return init("", {}, 0);
+    memset(dst + length, 0, nBlocks*GGWave::kLongBlockLength + kLongBlockHeader - length);
+
+    return length;
 }
 
-bool GGWave::alloc(void * p, int & n) {
-    const int maxLength   = m_isFixedPayloadLength ? m_payloadLength : kMaxLengthVariable;
-    const int totalLength = maxLength + getECCBytesForLength(maxLength);
-    const int totalTxs    = (totalLength + minBytesPerTx(Protocols::rx()) - 1)/minBytesPerTx(Protocols::tx());
+#if defined(GGWAVE_SIMD_SSE2)
+inline int lowestBit(unsigned int mask) {
+#if defined(_MSC_VER)
+    unsigned long res;
+    _BitScanForward(&res, mask);
+    return res;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
 
-    if (totalLength > kMaxDataSize) {
-        ggprintf("Error: total length %d (payload %d + ECC %d bytes) is too large ( > %d)\n",
-                 totalLength, maxLength, getECCBytesForLength(maxLength), kMaxDataSize);
-        return false;
-    }
+inline int highestBit(unsigned int mask) {
+#if defined(_MSC_VER)
+    unsigned long res;
+    _BitScanReverse(&res, mask);
+    return res;
+#else
+    return 31 - __builtin_clz(mask);
+#endif
+}
 
-    // common
-    ::ggalloc(m_dataEncoded, totalLength + m_encodedDataOffset, p, n);
+inline __m128 hmax(__m128 x) {
+    x = _mm_max_ps(x, _mm_shuffle_ps(x, x, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_max_ps(x, _mm_shuffle_ps(x, x, _MM_SHUFFLE(1, 0, 3, 2)));
+}
 
-    if (m_isRxEnabled) {
-        ::ggalloc(m_rx.fftOut,   2*m_samplesPerFrame, p, n);
-        ::ggalloc(m_rx.fftWorkI, 3 + sqrt(m_samplesPerFrame/2), p, n);
-        ::ggalloc(m_rx.fftWorkF, m_samplesPerFrame/2, p, n);
+inline __m128i hmax(__m128i x) {
+    x = _mm_max_epu8(x, _mm_srli_si128(x, 8));
+    x = _mm_max_epu8(x, _mm_srli_si128(x, 4));
+    x = _mm_max_epu8(x, _mm_srli_si128(x, 2));
+    x = _mm_max_epu8(x, _mm_srli_si128(x, 1));
+    return _mm_set1_epi8((char) _mm_cvtsi128_si32(x));
+}
+#endif
 
-        ::ggalloc(m_rx.spectrum,           m_samplesPerFrame, p, n);
-        // small extra space because sometimes resampling needs a few more samples:
-        ::ggalloc(m_rx.amplitude,          m_needResampling ? m_samplesPerFrame + 128 : m_samplesPerFrame, p, n);
-        // min input sampling rate is 0.125*m_sampleRate:
-        ::ggalloc(m_rx.amplitudeResampled, m_needResampling ? 8*m_samplesPerFrame : m_samplesPerFrame, p, n);
-        ::ggalloc(m_rx.amplitudeTmp,       m_needResampling ? 8*m_samplesPerFrame*m_sampleSizeInp : m_samplesPerFrame*m_sampleSizeInp, p, n);
+// Find the loudest of 16 consecutive bins
+//
+//   Returns the index of the first maximum. amax2 is the loudest of the other bins (the runner-up).
+//   Same as the scalar scan starting from amax = amax2 = 0 - the spectrum is non-negative.
+//
+int argmax16(const float * v, float & amax, float & amax2) {
+#if defined(GGWAVE_SIMD_AVX2)
+    const __m256 v0 = _mm256_loadu_ps(v + 0);
+    const __m256 v1 = _mm256_loadu_ps(v + 8);
 
-        ::ggalloc(m_rx.data, maxLength + 1, p, n); // extra byte for null-termination
+    const __m256 m8 = _mm256_max_ps(v0, v1);
+    const __m128 m  = hmax(_mm_max_ps(_mm256_castps256_ps128(m8), _mm256_extractf128_ps(m8, 1)));
 
-        if (m_isFixedPayloadLength) {
-            if (m_payloadLength > kMaxLengthFixed) {
-                ggprintf("Invalid payload length: %d, max: %d\n", m_payloadLength, kMaxLengthFixed);
-                return false;
-            }
+    const __m256 mm = _mm256_insertf128_ps(_mm256_castps128_ps256(m), m, 1);
+    const unsigned int mask = _mm256_movemask_ps(_mm256_cmp_ps(v0, mm, _CMP_EQ_OQ)) | (_mm256_movemask_ps(_mm256_cmp_ps(v1, mm, _CMP_EQ_OQ)) << 8);
 
-            ::ggalloc(m_rx.spectrumHistoryFixed, totalTxs*maxFramesPerTx(Protocols::rx(), false), m_samplesPerFrame, p, n);
-            ::ggalloc(m_rx.detectedBins,         2*totalLength, p, n);
-            ::ggalloc(m_rx.detectedTones,        2*16*maxBytesPerTx(Protocols::rx()), p, n);
-        } else {
-            // variable payload length
-            ::ggalloc(m_rx.amplitudeRecorded, kMaxRecordedFrames*m_samplesPerFrame, p, n);
-            ::ggalloc(m_rx.amplitudeAverage,  m_samplesPerFrame, p, n);
-            ::ggalloc(m_rx.amplitudeHistory,  kMaxSpectrumHistory, m_samplesPerFrame, p, n);
-        }
+    amax = _mm_cvtss_f32(m);
+    if (mask == 0 || amax <= 0.0f) {
+        amax = amax2 = 0.0f;
+        return 0;
     }
 
-    if (m_isTxEnabled) {
-        const int maxDataBits = 2*16*maxBytesPerTx(Protocols::tx());
+    const int kmax = lowestBit(mask);
 
-        if (m_txOnlyTones == false) {
-            ::ggalloc(m_tx.phaseOffsets,    maxDataBits, p, n);
-            ::ggalloc(m_tx.bit0Amplitude,   maxDataBits, m_samplesPerFrame, p, n);
-            ::ggalloc(m_tx.bit1Amplitude,   maxDataBits, m_samplesPerFrame, p, n);
-            ::ggalloc(m_tx.output,          m_samplesPerFrame, p, n);
-            ::ggalloc(m_tx.outputResampled, 2*m_samplesPerFrame, p, n);
-            ::ggalloc(m_tx.outputTmp,       kMaxRecordedFrames*m_samplesPerFrame*m_sampleSizeOut, p, n);
-            ::ggalloc(m_tx.outputI16,       kMaxRecordedFrames*m_samplesPerFrame, p, n);
-        }
+    const __m256i k  = _mm256_set1_epi32(kmax);
+    const __m256 r0 = _mm256_andnot_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(k, _mm256_setr_epi32(0,  1,  2,  3,  4,  5,  6,  7))), v0);
+    const __m256 r1 = _mm256_andnot_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(k, _mm256_setr_epi32(8,  9, 10, 11, 12, 13, 14, 15))), v1);
 
-        const int maxTones    = m_isFixedPayloadLength ? maxTonesPerTx(Protocols::tx()) : m_nBitsInMarker;
+    const __m256 r8 = _mm256_max_ps(r0, r1);
+    amax2 = _mm_cvtss_f32(hmax(_mm_max_ps(_mm256_castps256_ps128(r8), _mm256_extractf128_ps(r8, 1))));
 
-        ::ggalloc(m_tx.data,     maxLength + 1, p, n); // first byte stores the length
-        ::ggalloc(m_tx.dataBits, maxDataBits, p, n);
-        ::ggalloc(m_tx.tones,    maxTones*totalTxs + (maxTones > 1 ? totalTxs : 0), p, n);
-    }
+    return kmax;
+#elif defined(GGWAVE_SIMD_SSE2)
+    const __m128 v0 = _mm_loadu_ps(v +  0);
+    const __m128 v1 = _mm_loadu_ps(v +  4);
+    const __m128 v2 = _mm_loadu_ps(v +  8);
+    const __m128 v3 = _mm_loadu_ps(v + 12);
 
-    // pre-allocate Reed-Solomon memory buffers
-    {
-        const auto maxLength = m_isFixedPayloadLength ? m_payloadLength : kMaxLengthVariable;
+    const __m128 m = hmax(_mm_max_ps(_mm_max_ps(v0, v1), _mm_max_ps(v2, v3)));
 
-        if (m_isFixedPayloadLength == false) {
-            ::ggalloc(m_workRSLength, RS::ReedSolomon::getWorkSize_bytes(1, m_encodedDataOffset - 1), p, n);
-        }
-        ::ggalloc(m_workRSData, RS::ReedSolomon::getWorkSize_bytes(maxLength, getECCBytesForLength(maxLength)), p, n);
-    }
+    const unsigned int mask =
+        (_mm_movemask_ps(_mm_cmpeq_ps(v0, m)) << 0) | (_mm_movemask_ps(_mm_cmpeq_ps(v1, m)) <<  4) |
+        (_mm_movemask_ps(_mm_cmpeq_ps(v2, m)) << 8) | (_mm_movemask_ps(_mm_cmpeq_ps(v3, m)) << 12);
 
-    if (m_needResampling) {
-        m_resampler.alloc(p, n);
+    amax = _mm_cvtss_f32(m);
+    if (mask == 0 || amax <= 0.0f) {
+        amax = amax2 = 0.0f;
+        return 0;
     }
 
-    return true;
-}
-
-void GGWave::setLogFile(FILE * fptr) {
-    g_fptr = fptr;
-}
+    const int kmax = lowestBit(mask);
 
-const GGWave::Parameters & GGWave::getDefaultParameters() {
-    static ggwave_Parameters result {
-        -1, // vaiable payload length
-        kDefaultSampleRate,
-        kDefaultSampleRate,
-        kDefaultSampleRate,
-        kDefaultSamplesPerFrame,
-        kDefaultSoundMarkerThreshold,
-        GGWAVE_SAMPLE_FORMAT_F32,
-        GGWAVE_SAMPLE_FORMAT_F32,
-        GGWAVE_OPERATING_MODE_RX | GGWAVE_OPERATING_MODE_TX,
-    };
+    const __m128i k = _mm_set1_epi32(kmax);
+    const __m128 r0 = _mm_andnot_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(k, _mm_setr_epi32( 0,  1,  2,  3))), v0);
+    const __m128 r1 = _mm_andnot_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(k, _mm_setr_epi32( 4,  5,  6,  7))), v1);
+    const __m128 r2 = _mm_andnot_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(k, _mm_setr_epi32( 8,  9, 10, 11))), v2);
+    const __m128 r3 = _mm_andnot_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(k, _mm_setr_epi32(12, 13, 14, 15))), v3);
 
-    return result;
-}
+    amax2 = _mm_cvtss_f32(hmax(_mm_max_ps(_mm_max_ps(r0, r1), _mm_max_ps(r2, r3))));
 
-bool GGWave::init(const char * text, TxProtocolId protocolId, const int volume) {
-    return init(strlen(text), text, protocolId, volume);
-}
+    return kmax;
+#elif defined(GGWAVE_SIMD_NEON)
+    const float32x4_t v0 = vld1q_f32(v +  0);
+    const float32x4_t v1 = vld1q_f32(v +  4);
+    const float32x4_t v2 = vld1q_f32(v +  8);
+    const float32x4_t v3 = vld1q_f32(v + 12);
 
-bool GGWave::init(int dataSize, const char * dataBuffer, TxProtocolId protocolId, const int volume) {
-    if (dataSize < 0) {
-        ggprintf("Negative data size: %d\n", dataSize);
-        return false;
+    amax = vmaxvq_f32(vmaxq_f32(vmaxq_f32(v0, v1), vmaxq_f32(v2, v3)));
+    if (amax <= 0.0f) {
+        amax = amax2 = 0.0f;
+        return 0;
     }
 
-    // Tx
-    if (m_isTxEnabled) {
-        const auto maxLength = m_isFixedPayloadLength ? m_payloadLength : kMaxLengthVariable;
-
-        if (dataSize > maxLength) {
-            ggprintf("Truncating data from %d to %d bytes\n", dataSize, maxLength);
-            dataSize = maxLength;
-        }
+    // the first lane equal to the maximum
+    const float32x4_t m  = vdupq_n_f32(amax);
+    const uint32x4_t  n  = vdupq_n_u32(16);
+    const uint32x4_t  i0 = { 0,  1,  2,  3 };
+    const uint32x4_t  i1 = { 4,  5,  6,  7 };
+    const uint32x4_t  i2 = { 8,  9, 10, 11 };
+    const uint32x4_t  i3 = { 12, 13, 14, 15 };
 
-        if (volume < 0 || volume > 100) {
-            ggprintf("Invalid volume: %d\n", volume);
-            return false;
-        }
+    const int kmax = vminvq_u32(vminq_u32(
+            vminq_u32(vbslq_u32(vceqq_f32(v0, m), i0, n), vbslq_u32(vceqq_f32(v1, m), i1, n)),
+            vminq_u32(vbslq_u32(vceqq_f32(v2, m), i2, n), vbslq_u32(vceqq_f32(v3, m), i3, n))));
 
-        m_tx.hasData = false;
-        m_tx.data.zero();
-        m_dataEncoded.zero();
+    const uint32x4_t  k  = vdupq_n_u32(kmax);
+    const float32x4_t z  = vdupq_n_f32(0.0f);
+    const float32x4_t r0 = vbslq_f32(vceqq_u32(k, i0), z, v0);
+    const float32x4_t r1 = vbslq_f32(vceqq_u32(k, i1), z, v1);
+    const float32x4_t r2 = vbslq_f32(vceqq_u32(k, i2), z, v2);
+    const float32x4_t r3 = vbslq_f32(vceqq_u32(k, i3), z, v3);
 
-        if (dataSize > 0) {
-            if (protocolId < 0 || protocolId >= m_tx.protocols.size()) {
-                ggprintf("Invalid protocol ID: %d\n", protocolId);
-                return false;
-            }
+    amax2 = vmaxvq_f32(vmaxq_f32(vmaxq_f32(r0, r1), vmaxq_f32(r2, r3)));
 
-            const auto & protocol = m_tx.protocols[protocolId];
+    return kmax;
+#else
+    int kmax = 0;
+    amax  = 0.0f;
+    amax2 = 0.0f;
+    for (int k = 0; k < 16; ++k) {
+        if (v[k] > amax) {
+            kmax = k;
+            amax2 = amax;
+            amax = v[k];
+        } else if (v[k] > amax2) {
+            amax2 = v[k];
+        }
+    }
 
-            if (protocol.enabled == false) {
-                ggprintf("Protocol %d is not enabled - make sure to enable it before creating the instance\n", protocolId);
-                return false;
-            }
+    return kmax;
+#endif
+}
 
-            if (protocol.extra == 2 && m_isFixedPayloadLength == false) {
-                ggprintf("Mono-tone protocols with variable length are not supported\n");
-                return false;
-            }
+// Find the loudest of 16 consecutive quantized bins
+//
+//   Returns the index of the last maximum. amax2 is the loudest of the other bins (the runner-up).
+//
+int argmax16(const uint8_t * v, uint8_t & amax, uint8_t & amax2) {
+#if defined(GGWAVE_SIMD_SSE2)
+    const __m128i x = _mm_loadu_si128((const __m128i *) v);
+    const __m128i m = hmax(x);
 
-            m_tx.protocol   = protocol;
-            m_tx.dataLength = m_isFixedPayloadLength ? m_payloadLength : dataSize;
-            m_tx.sendVolume = ((double)(volume))/100.0f;
+    const int kmax = highestBit(_mm_movemask_epi8(_mm_cmpeq_epi8(x, m)));
 
-            m_tx.data[0] = m_tx.dataLength;
-            for (int i = 0; i < m_tx.dataLength; ++i) {
-                m_tx.data[i + 1] = i < dataSize ? dataBuffer[i] : 0;
-                if (m_isDSSEnabled) {
-                    m_tx.data[i + 1] ^= getDSSMagic(i);
-                }
-            }
+    const __m128i r = _mm_andnot_si128(_mm_cmpeq_epi8(_mm_set1_epi8((char) kmax), _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15)), x);
 
-            m_tx.hasData = true;
-        }
-    } else {
-        if (dataSize > 0) {
-            ggprintf("Tx is disabled - cannot transmit data with this GGWave instance\n");
-        }
-    }
+    amax  = _mm_cvtsi128_si32(m);
+    amax2 = _mm_cvtsi128_si32(hmax(r));
 
-    // Rx
-    if (m_isRxEnabled) {
-        m_rx.receiving = false;
-        m_rx.analyzing = false;
+    return kmax;
+#elif defined(GGWAVE_SIMD_NEON)
+    const uint8x16_t x = vld1q_u8(v);
+    const uint8x16_t i = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 };
 
-        m_rx.framesToAnalyze = 0;
-        m_rx.framesLeftToAnalyze = 0;
-        m_rx.framesToRecord = 0;
-        m_rx.framesLeftToRecord = 0;
+    amax = vmaxvq_u8(x);
 
-        m_rx.spectrum.zero();
-        m_rx.amplitude.zero();
-        m_rx.amplitudeHistory.zero();
+    // the last lane equal to the maximum
+    const int kmax = vmaxvq_u8(vandq_u8(vceqq_u8(x, vdupq_n_u8(amax)), i));
 
-        m_rx.data.zero();
+    amax2 = vmaxvq_u8(vbicq_u8(x, vceqq_u8(i, vdupq_n_u8(kmax))));
 
-        m_rx.spectrumHistoryFixed.zero();
+    return kmax;
+#else
+    int kmax = 0;
+    amax  = 0;
+    amax2 = 0;
+    for (int k = 0; k < 16; ++k) {
+        if (v[k] >= amax) {
+            kmax = k;
+            amax2 = amax;
+            amax = v[k];
+        } else if (v[k] > amax2) {
+            amax2 = v[k];
+        }
     }
 
-    return true;
-}
-
-uint32_t GGWave::encodeSize_bytes() const {
-    return encodeSize_samples()*m_sampleSizeOut;
+    return kmax;
+#endif
 }
 
-uint32_t GGWave::encodeSize_samples() const {
-    if (m_tx.hasData == false) {
-        return 0;
+// Find the loudest of the n tones of a symbol, spaced "stride" bins apart
+//
+//   Same as argmax16() - the 4-bit symbols on adjacent bins use it directly.
+//
+int argmaxSymbol(const float * v, int n, int stride, float & amax, float & amax2) {
+    if (n == 16 && stride == 1) {
+        return argmax16(v, amax, amax2);
     }
 
-    float factor = 1.0f;
-    int samplesPerFrameOut = m_samplesPerFrame;
-    if (m_needResampling) {
-        factor = m_sampleRate/m_sampleRateOut;
-        // note : +1 extra sample in order to overestimate the buffer size
-        samplesPerFrameOut = m_resampler.resample(factor, m_samplesPerFrame, m_tx.output.data(), nullptr) + 1;
+    int kmax = 0;
+    amax  = 0.0f;
+    amax2 = 0.0f;
+    for (int k = 0; k < n; ++k) {
+        const float x = v[k*stride];
+        if (x > amax) {
+            kmax = k;
+            amax2 = amax;
+            amax = x;
+        } else if (x > amax2) {
+            amax2 = x;
+        }
     }
-    const int nECCBytesPerTx = getECCBytesForLength(m_tx.dataLength);
-    const int sendDataLength = m_tx.dataLength + m_encodedDataOffset;
-    const int totalBytes = sendDataLength + nECCBytesPerTx;
-    const int totalDataFrames = m_tx.protocol.extra*((totalBytes + m_tx.protocol.bytesPerTx - 1)/m_tx.protocol.bytesPerTx)*m_tx.protocol.framesPerTx;
 
-    return (
-            m_nMarkerFrames + totalDataFrames + m_nMarkerFrames
-           )*samplesPerFrameOut;
+    return kmax;
 }
 
-uint32_t GGWave::encode() {
-    if (m_isTxEnabled == false) {
-        ggprintf("Tx is disabled - cannot transmit data with this GGWave instance\n");
-        return 0;
+int argmaxSymbol(const uint8_t * v, int n, int stride, uint8_t & amax, uint8_t & amax2) {
+    if (n == 16 && stride == 1) {
+        return argmax16(v, amax, amax2);
     }
 
-    if (m_needResampling) {
-        m_resampler.reset();
+    int kmax = 0;
+    amax  = 0;
+    amax2 = 0;
+    for (int k = 0; k < n; ++k) {
+        const uint8_t x = v[k*stride];
+        if (x >= amax) {
+            kmax = k;
+            amax2 = amax;
+            amax = x;
+        } else if (x > amax2) {
+            amax2 = x;
+        }
     }
 
-    const int nECCBytesPerTx = getECCBytesForLength(m_tx.dataLength);
-    const int sendDataLength = m_tx.dataLength + m_encodedDataOffset;
-    const int totalBytes = sendDataLength + nECCBytesPerTx;
-    const int totalDataFrames = m_tx.protocol.extra*((totalBytes + m_tx.protocol.bytesPerTx - 1)/m_tx.protocol.bytesPerTx)*m_tx.protocol.framesPerTx;
+    return kmax;
+}
 
-    if (m_isFixedPayloadLength == false) {
-        RS::ReedSolomon rsLength(1, m_encodedDataOffset - 1, m_workRSLength.data());
-        rsLength.Encode(m_tx.data.data(), m_dataEncoded.data());
+// Slide the voting window of a fixed-length protocol by one frame and find the majority tones
+//
+//   The nGroups groups of nTones tones are groupDelta bins apart. The shapes of the built-in protocols are
+//   template arguments, so the loops over the groups and the tones have constant bounds and unroll - the
+//   generic instantiation <0, 0, 0, 0> takes the shape from the arguments. Returns the detected groups.
+//
+template <int kTones, int kGroups, int kBinDelta, int kGroupDelta>
+int voteFixed(const uint8_t * spectrum, int nTones, int nGroups, int binDelta, int groupDelta, int framesPerTx,
+              uint8_t * votes, uint8_t * tones, const uint8_t * tonesOld, uint8_t * majority, uint8_t * votesMax) {
+    if (kTones > 0) {
+        nTones     = kTones;
+        nGroups    = kGroups;
+        binDelta   = kBinDelta;
+        groupDelta = kGroupDelta;
     }
 
-    // first byte of m_tx.data contains the length of the payload, so we skip it:
-    RS::ReedSolomon rsData = RS::ReedSolomon(m_tx.dataLength, nECCBytesPerTx, m_workRSData.data());
-    rsData.Encode(m_tx.data.data() + 1, m_dataEncoded.data() + m_encodedDataOffset);
-
-    // generate tones
-    {
-        int frameId = 0;
-        bool hasData = m_tx.hasData;
-
-        m_tx.nTones = 0;
-        while (hasData) {
-            if (frameId < m_nMarkerFrames) {
-                for (int i = 0; i < m_nBitsInMarker; ++i) {
-                    m_tx.tones[m_tx.nTones++] = 2*i + i%2;
-                }
-            } else if (frameId < m_nMarkerFrames + totalDataFrames) {
-                int dataOffset = frameId - m_nMarkerFrames;
-                dataOffset /= m_tx.protocol.framesPerTx;
-                dataOffset *= m_tx.protocol.bytesPerTx;
-
-                m_tx.dataBits.zero();
+    for (int g = 0; g < nGroups; ++g) {
+        uint8_t amax, amax2;
+        const int bin = ::argmaxSymbol(spectrum + g*groupDelta, nTones, binDelta, amax, amax2);
 
-                for (int j = 0; j < m_tx.protocol.bytesPerTx; ++j) {
-                    if (m_tx.protocol.extra == 1) {
-                        {
-                            uint8_t d = m_dataEncoded[dataOffset + j] & 15;
-                            m_tx.dataBits[(2*j + 0)*16 + d] = 1;
-                        }
-                        {
-                            uint8_t d = m_dataEncoded[dataOffset + j] & 240;
-                            m_tx.dataBits[(2*j + 1)*16 + (d >> 4)] = 1;
-                        }
-                    } else {
-                        if (dataOffset % m_tx.protocol.extra == 0) {
-                            uint8_t d = m_dataEncoded[dataOffset/m_tx.protocol.extra + j] & 15;
-                            m_tx.dataBits[(2*j + 0)*16 + d] = 1;
-                        } else {
-                            uint8_t d = m_dataEncoded[dataOffset/m_tx.protocol.extra + j] & 240;
-                            m_tx.dataBits[(2*j + 0)*16 + (d >> 4)] = 1;
-                        }
-                    }
-                }
+        tones[g] = bin;
+        votes[nTones*g + bin]++;
+    }
 
-                for (int k = 0; k < 2*m_tx.protocol.bytesPerTx*16; ++k) {
-                    if (m_tx.dataBits[k] == 0) continue;
+    if (tonesOld) {
+        for (int g = 0; g < nGroups; ++g) {
+            votes[nTones*g + tonesOld[g]]--;
+        }
+    }
 
-                    m_tx.tones[m_tx.nTones++] = k;
-                }
-            } else if (frameId < m_nMarkerFrames + totalDataFrames + m_nMarkerFrames) {
-                for (int i = 0; i < m_nBitsInMarker; ++i) {
-                    m_tx.tones[m_tx.nTones++] = 2*i + (1 - i%2);
-                }
-            } else {
-                hasData = false;
-                break;
-            }
+    int nDetected = 0;
+    for (int g = 0; g < nGroups; ++g) {
+        const uint8_t * v = votes + nTones*g;
 
-            if (m_tx.protocol.nTones() > 1) {
-                m_tx.tones[m_tx.nTones++] = -1;
+        int bin = 0;
+        for (int b = 1; b < nTones; ++b) {
+            if (v[bin] < v[b]) {
+                bin = b;
             }
-
-            frameId += m_tx.protocol.framesPerTx;
         }
 
-        if (m_txOnlyTones) {
-            m_tx.hasData = false;
-            return true;
-        }
+        votesMax[g] = v[bin];
+        majority[g] = votesMax[g] > framesPerTx/2 ? bin : nTones;
+
+        nDetected += majority[g] < nTones;
     }
 
-    // compute Tx data
-    {
-        for (int k = 0; k < (int) m_tx.phaseOffsets.size(); ++k) {
-            m_tx.phaseOffsets[k] = (M_PI*k)/(m_tx.protocol.nDataBitsPerTx());
-        }
+    return nDetected;
+}
 
-        // note : what is the purpose of this shuffle ? I forgot .. :(
-        //std::random_device rd;
-        //std::mt19937 g(rd());
+int voteFixed(const uint8_t * spectrum, int nTones, int nGroups, int binDelta, int groupDelta, int framesPerTx,
+              uint8_t * votes, uint8_t * tones, const uint8_t * tonesOld, uint8_t * majority, uint8_t * votesMax) {
+    using Kernel = decltype(&voteFixed<0, 0, 0, 0>);
 
-        //std::shuffle(phaseOffsets.begin(), phaseOffsets.end(), g);
+    const auto vote = [&](Kernel f) {
+        return f(spectrum, nTones, nGroups, binDelta, groupDelta, framesPerTx, votes, tones, tonesOld, majority, votesMax);
+    };
 
-        for (int k = 0; k < (int) m_tx.dataBits.size(); ++k) {
-            const double freq = bitFreq(m_tx.protocol, k);
+    if (nTones == 16 && binDelta == 1) {
+#ifndef GGWAVE_CONFIG_FEW_PROTOCOLS
+        if (nGroups == 6 && groupDelta == 16) return vote(voteFixed<16, 6, 1, 16>); // audible, ultrasound
+#endif
+        if (nGroups == 2 && groupDelta == 16) return vote(voteFixed<16, 2, 1, 16>); // [DT]
+        if (nGroups == 1 && groupDelta == 32) return vote(voteFixed<16, 1, 1, 32>); // [MT]
+    }
 
-            const double phaseOffset = m_tx.phaseOffsets[k];
-            const double curHzPerSample = m_hzPerSample;
-            const double curIHzPerSample = 1.0/curHzPerSample;
+    return vote(voteFixed<0, 0, 0, 0>);
+}
 
-            for (int i = 0; i < m_samplesPerFrame; i++) {
-                const double curi = i;
-                m_tx.bit1Amplitude[k][i] = sin((2.0*M_PI)*(curi*m_isamplesPerFrame)*(freq*curIHzPerSample) + phaseOffset);
-            }
+// Mark the tones of the data symbols of a single Tx in dataBits, indexed by tone
+//
+//   The bytes of a Tx are split into symbols of nSymbolBits() bits, starting from the low bits of the
+//   first byte - a symbol may carry bits of two adjacent bytes. The mono-tone protocols transmit the
+//   low and then the high nibble of each byte.
+//
+void setDataBits(const GGWave::Protocol & protocol, const uint8_t * data, int txId, ggvector<bool> & dataBits) {
+    const int nBits    = protocol.nSymbolBits();
+    const int nTones   = protocol.nSymbolTones();
+    const int nSpacing = protocol.nBinSpacing();
 
-            for (int i = 0; i < m_samplesPerFrame; i++) {
-                const double curi = i;
-                m_tx.bit0Amplitude[k][i] = sin((2.0*M_PI)*(curi*m_isamplesPerFrame)*((freq + m_hzPerSample*m_freqDelta_bin)*curIHzPerSample) + phaseOffset);
-            }
+    dataBits.zero();
+
+    if (protocol.extra != 1) {
+        for (int j = 0; j < protocol.bytesPerTx; ++j) {
+            const uint8_t d = data[(txId/protocol.extra)*protocol.bytesPerTx + j];
+            dataBits[nSpacing*(2*j*nTones + (txId%protocol.extra == 0 ? d & 15 : d >> 4))] = 1;
         }
-    }
 
-    int frameId = 0;
-    uint32_t offset = 0;
-    const float factor = m_sampleRate/m_sampleRateOut;
+        return;
+    }
 
-    while (m_tx.hasData) {
-        m_tx.output.zero();
+    data += txId*protocol.bytesPerTx;
 
-        uint16_t nFreq = 0;
-        if (frameId < m_nMarkerFrames) {
-            nFreq = m_nBitsInMarker;
+    for (int s = 0; s < protocol.nSymbolsPerTx(); ++s) {
+        const int bit = s*nBits;
 
-            for (int i = 0; i < m_nBitsInMarker; ++i) {
-                if (i%2 == 0) {
-                    ::addAmplitudeSmooth(m_tx.bit1Amplitude[i], m_tx.output, m_tx.sendVolume, 0, m_samplesPerFrame, frameId, m_nMarkerFrames);
-                } else {
-                    ::addAmplitudeSmooth(m_tx.bit0Amplitude[i], m_tx.output, m_tx.sendVolume, 0, m_samplesPerFrame, frameId, m_nMarkerFrames);
-                }
-            }
-        } else if (frameId < m_nMarkerFrames + totalDataFrames) {
-            int dataOffset = frameId - m_nMarkerFrames;
-            int cycleModMain = dataOffset%m_tx.protocol.framesPerTx;
-            dataOffset /= m_tx.protocol.framesPerTx;
-            dataOffset *= m_tx.protocol.bytesPerTx;
+        int d = data[bit/8] >> (bit%8);
+        if (bit%8 + nBits > 8) {
+            d |= data[bit/8 + 1] << (8 - bit%8);
+        }
 
-            m_tx.dataBits.zero();
+        dataBits[nSpacing*(s*nTones + (d & (nTones - 1)))] = 1;
+    }
+}
 
-            for (int j = 0; j < m_tx.protocol.bytesPerTx; ++j) {
-                if (m_tx.protocol.extra == 1) {
-                    {
-                        uint8_t d = m_dataEncoded[dataOffset + j] & 15;
-                        m_tx.dataBits[(2*j + 0)*16 + d] = 1;
-                    }
-                    {
-                        uint8_t d = m_dataEncoded[dataOffset + j] & 240;
-                        m_tx.dataBits[(2*j + 1)*16 + (d >> 4)] = 1;
-                    }
-                } else {
-                    if (dataOffset % m_tx.protocol.extra == 0) {
-                        uint8_t d = m_dataEncoded[dataOffset/m_tx.protocol.extra + j] & 15;
-                        m_tx.dataBits[(2*j + 0)*16 + d] = 1;
-                    } else {
-                        uint8_t d = m_dataEncoded[dataOffset/m_tx.protocol.extra + j] & 240;
-                        m_tx.dataBits[(2*j + 0)*16 + (d >> 4)] = 1;
-                    }
-                }
-            }
+// Add the value of symbol s of a Tx to its bytes
+//
+//   The symbols are added in order. The confidence of a byte is the lowest confidence of the
+//   symbols that carry its bits.
+//
+void addSymbol(uint8_t * dst, float * confidence, int nBytes, int nBits, int s, int value, float c) {
+    const int bit = s*nBits;
+    for (int i = bit/8; i <= (bit + nBits - 1)/8 && i < nBytes; ++i) {
+        // the first symbol of a byte carries its lowest bit
+        if (bit <= 8*i) {
+            dst[i]        = value >> (8*i - bit);
+            confidence[i] = c;
+        } else {
+            dst[i]       |= value << (bit - 8*i);
+            confidence[i] = GG_MIN(confidence[i], c);
+        }
+    }
+}
 
-            for (int k = 0; k < 2*m_tx.protocol.bytesPerTx*16; ++k) {
-                if (m_tx.dataBits[k] == 0) continue;
+// OFDM subcarrier c is a pilot if c % 9 == 0 - data subcarrier d is between the pilots
+inline int ofdmCarrier(int d) { return d + d/8 + 1; }
 
-                ++nFreq;
-                if (k%2) {
-                    ::addAmplitudeSmooth(m_tx.bit0Amplitude[k/2], m_tx.output, m_tx.sendVolume, 0, m_samplesPerFrame, cycleModMain, m_tx.protocol.framesPerTx);
-                } else {
-                    ::addAmplitudeSmooth(m_tx.bit1Amplitude[k/2], m_tx.output, m_tx.sendVolume, 0, m_samplesPerFrame, cycleModMain, m_tx.protocol.framesPerTx);
-                }
-            }
-        } else if (frameId < m_nMarkerFrames + totalDataFrames + m_nMarkerFrames) {
-            nFreq = m_nBitsInMarker;
+// Pseudo-random quarter turns of subcarrier c in symbol s > 0
+//
+//   Without them, a run of equal symbols, such as the zero padding, would have the peaky waveform of
+//   the reference symbol repeated and a line spectrum that is easier to mistake for a marker.
+//
+inline int ofdmScramble(int c, int s) { return s == 0 ? 0 : (uint32_t(131*c + 7919*s)*2654435761u) >> 30; }
 
-            const int fId = frameId - (m_nMarkerFrames + totalDataFrames);
-            for (int i = 0; i < m_nBitsInMarker; ++i) {
-                if (i%2 == 0) {
-                    addAmplitudeSmooth(m_tx.bit0Amplitude[i], m_tx.output, m_tx.sendVolume, 0, m_samplesPerFrame, fId, m_nMarkerFrames);
-                } else {
-                    addAmplitudeSmooth(m_tx.bit1Amplitude[i], m_tx.output, m_tx.sendVolume, 0, m_samplesPerFrame, fId, m_nMarkerFrames);
-                }
+// Spectrum of symbol s of an OFDM block, for the inverse rdft()
+//
+//   The reference symbol 0 has Newman phases, which keep its peak-to-average power ratio low.
+//   Each following symbol advances the phase of each data subcarrier by a multiple of pi/2,
+//   given by the Gray-coded 2 bits of the subcarrier. The bytes after the first nBytes are 0.
+//
+void ofdmSpectrum(const GGWave::Protocol & protocol, const uint8_t * data, int nBytes, int s, float * dst, int n) {
+    const int nCarriers = protocol.nOFDMCarriers();
+    const int nData     = protocol.nOFDMData();
+
+    for (int i = 0; i < n; ++i) {
+        dst[i] = 0.0f;
+    }
+
+    for (int c = 0; c < nCarriers; ++c) {
+        int quadrant = ::ofdmScramble(c, s);
+        if (c % 9 != 0) {
+            const int d = c - c/9 - 1;
+            for (int t = 1; t <= s; ++t) {
+                const int i = (t - 1)*(nData/4) + d/4;
+                const int v = i < nBytes ? (data[i] >> (2*(d%4))) & 3 : 0;
+
+                quadrant += v ^ (v >> 1);
             }
-        } else {
-            m_tx.hasData = false;
-            break;
         }
 
-        if (nFreq == 0) nFreq = 1;
-        const float scale = 1.0f/nFreq;
-        for (int i = 0; i < m_samplesPerFrame; ++i) {
-            m_tx.output[i] *= scale;
-        }
+        const double phase = (M_PI*c*c)/nCarriers + 0.5*M_PI*(quadrant % 4);
+        const int bin = protocol.freqStart + c;
 
-        int samplesPerFrameOut = m_samplesPerFrame;
-        if (m_needResampling) {
-            samplesPerFrameOut = m_resampler.resample(factor, m_samplesPerFrame, m_tx.output.data(), m_tx.outputResampled.data());
-        } else {
-            m_tx.outputResampled.copy(m_tx.output);
-        }
+        dst[2*bin + 0] = cos(phase);
+        dst[2*bin + 1] = sin(phase);
+    }
+}
 
-        // default output is in 16-bit signed int so we always compute it
-        for (int i = 0; i < samplesPerFrameOut; ++i) {
-            m_tx.outputI16[offset + i] = 32768*m_tx.outputResampled[i];
+// Demodulate symbol s of an OFDM block from its spectrum and the spectrum of the previous symbol
+//
+//   The rotation of the pilots is removed from the data subcarriers before the decision.
+//   The confidence of a subcarrier is the margin of its phase from the decision boundaries.
+//   The subcarriers of the symbol are kept in prev for the next symbol.
+//
+void ofdmDemodulate(const GGWave::Protocol & protocol, const float * spectrum, float * prev, int s, uint8_t * dst, float * confidence, int nBytes) {
+    const int nCarriers = protocol.nOFDMCarriers();
+    const int nData     = protocol.nOFDMData();
+
+    const float * cur = spectrum + 2*protocol.freqStart;
+
+    if (s > 0) {
+        // differential phase of subcarrier c: cur*conj(prev)
+        const auto re = [&](int c) { return cur[2*c + 0]*prev[2*c + 0] + cur[2*c + 1]*prev[2*c + 1]; };
+        const auto im = [&](int c) { return cur[2*c + 1]*prev[2*c + 0] - cur[2*c + 0]*prev[2*c + 1]; };
+
+        // the pilots turn only by the difference of their scrambling
+        float pRe = 0.0f;
+        float pIm = 0.0f;
+        for (int c = 0; c < nCarriers; c += 9) {
+            switch ((::ofdmScramble(c, s) - ::ofdmScramble(c, s - 1) + 4) % 4) {
+                case 0: pRe += re(c); pIm += im(c); break;
+                case 1: pRe += im(c); pIm -= re(c); break;
+                case 2: pRe -= re(c); pIm -= im(c); break;
+                case 3: pRe -= im(c); pIm += re(c); break;
+            }
         }
 
-        // convert from 32-bit float
-        switch (m_sampleFormatOut) {
-            case GGWAVE_SAMPLE_FORMAT_UNDEFINED: break;
-            case GGWAVE_SAMPLE_FORMAT_U8:
-                {
-                    auto p = reinterpret_cast<uint8_t *>(m_tx.outputTmp.data());
-                    for (int i = 0; i < samplesPerFrameOut; ++i) {
-                        p[offset + i] = 128*(m_tx.outputResampled[i] + 1.0f);
-                    }
-                } break;
-            case GGWAVE_SAMPLE_FORMAT_I8:
-                {
-                    auto p = reinterpret_cast<uint8_t *>(m_tx.outputTmp.data());
-                    for (int i = 0; i < samplesPerFrameOut; ++i) {
-                        p[offset + i] = 128*m_tx.outputResampled[i];
-                    }
-                } break;
-            case GGWAVE_SAMPLE_FORMAT_U16:
-                {
-                    auto p = reinterpret_cast<uint16_t *>(m_tx.outputTmp.data());
-                    for (int i = 0; i < samplesPerFrameOut; ++i) {
-                        p[offset + i] = 32768*(m_tx.outputResampled[i] + 1.0f);
-                    }
-                } break;
-            case GGWAVE_SAMPLE_FORMAT_I16:
-                {
-                    // skip because we already have the data in m_tx.outputI16
-                    //auto p = reinterpret_cast<uint16_t *>(m_tx.outputTmp.data());
-                    //for (int i = 0; i < samplesPerFrameOut; ++i) {
-                    //    p[offset + i] = 32768*m_tx.outputResampled[i];
-                    //}
-                } break;
-            case GGWAVE_SAMPLE_FORMAT_F32:
-                {
-                    auto p = reinterpret_cast<float *>(m_tx.outputTmp.data());
-                    for (int i = 0; i < samplesPerFrameOut; ++i) {
-                        p[offset + i] = m_tx.outputResampled[i];
-                    }
-                } break;
-        }
+        const int offset = (s - 1)*(nData/4);
+        for (int d = 0; d < nData && offset + d/4 < nBytes; ++d) {
+            const int c = ::ofdmCarrier(d);
 
-        ++frameId;
-        offset += samplesPerFrameOut;
-    }
+            const float a = re(c)*pRe + im(c)*pIm;
+            const float b = im(c)*pRe - re(c)*pIm;
 
-    m_tx.lastAmplitudeSize = offset;
+            const float ma = fabsf(a);
+            const float mb = fabsf(b);
 
-    // the encoded waveform can be accessed via the txWaveform() method
-    // we return the size of the waveform in bytes:
-    return offset*m_sampleSizeOut;
-}
+            int quadrant = ma >= mb ? (a >= 0.0f ? 0 : 2) : (b >= 0.0f ? 1 : 3);
+            quadrant = (quadrant - ::ofdmScramble(c, s) + ::ofdmScramble(c, s - 1) + 8) % 4;
 
-bool GGWave::decode(const void * data, uint32_t nBytes) {
-    if (m_isRxEnabled == false) {
-        ggprintf("Rx is disabled - cannot receive data with this GGWave instance\n");
-        return false;
+            const float margin = ma + mb > 0.0f ? fabsf(ma - mb)/(ma + mb) : 0.0f;
+
+            ::addSymbol(dst + offset, confidence + offset, nBytes - offset, 2, d, quadrant ^ (quadrant >> 1), margin);
+        }
     }
 
-    if (m_tx.hasData) {
-        ggprintf("Cannot decode while transmitting\n");
-        return false;
+    for (int i = 0; i < 2*nCarriers; ++i) {
+        prev[i] = cur[i];
     }
+}
 
-    auto dataBuffer = (uint8_t *) data;
-    const float factor = m_sampleRateInp/m_sampleRate;
+// One frame of the short preamble - nBins tones from bin freqStart with Newman phases
+//
+//   The quadratic phases make it a chirp that sweeps the band once per frame. Its periodic
+//   autocorrelation is a single peak, so the matched filter of the receiver finds its position
+//   to a sample.
+//
+void preambleChirp(int freqStart, int nBins, float * dst, int n) {
+    for (int i = 0; i < n; ++i) {
+        dst[i] = 0.0f;
+    }
 
-    while (true) {
-        // read capture data
-        uint32_t nBytesNeeded = m_rx.samplesNeeded*m_sampleSizeInp;
+    for (int k = 0; k < nBins; ++k) {
+        const double omega = (2.0*M_PI*(freqStart + k))/n;
+        const double phase = (M_PI*k*k)/nBins;
 
-        if (m_needResampling) {
-            // note : predict 4 extra samples just to make sure we have enough data
-            nBytesNeeded = (m_resampler.resample(1.0f/factor, m_rx.samplesNeeded, m_rx.amplitudeResampled.data(), nullptr) + 4)*m_sampleSizeInp;
+        for (int i = 0; i < n; ++i) {
+            dst[i] += cos(omega*i + phase);
         }
+    }
+}
 
-        const uint32_t nBytesRecorded = GG_MIN(nBytes, nBytesNeeded);
+// The analysis checks the data offset given by the short preamble and this many steps of 1/16
+// frame around it - a matched-filter lag that is off by a few samples still decodes
+constexpr int kPreambleSearchSteps = 2;
 
-        if (nBytesRecorded == 0) {
-            break;
-        }
+// Add the sum of sine oscillators, advanced by complex rotation, to dst
+//
+//   The oscillators are processed in groups of 4 - nTones must be a multiple of 4. re/im hold the
+//   state (cosine/sine of the phase) and are updated in place, cr/ci are the rotations per sample.
+//   Unused oscillators must have zero state
+//
+void synthNCO(float * re, float * im, const float * cr, const float * ci, int nTones, float * dst, int n) {
+    for (int t = 0; t < nTones; t += 4) {
+#if defined(GGWAVE_SIMD_SSE2)
+        __m128 r = _mm_loadu_ps(re + t);
+        __m128 m = _mm_loadu_ps(im + t);
+
+        const __m128 c = _mm_loadu_ps(cr + t);
+        const __m128 s = _mm_loadu_ps(ci + t);
+
+        const auto rotate = [&]() {
+            const __m128 r1 = _mm_sub_ps(_mm_mul_ps(r, c), _mm_mul_ps(m, s));
+            m = _mm_add_ps(_mm_mul_ps(r, s), _mm_mul_ps(m, c));
+            r = r1;
+        };
 
-        switch (m_sampleFormatInp) {
-            case GGWAVE_SAMPLE_FORMAT_UNDEFINED: break;
-            case GGWAVE_SAMPLE_FORMAT_U8:
-            case GGWAVE_SAMPLE_FORMAT_I8:
-            case GGWAVE_SAMPLE_FORMAT_U16:
-            case GGWAVE_SAMPLE_FORMAT_I16:
-                {
-                    memcpy(m_rx.amplitudeTmp.data(), dataBuffer, nBytesRecorded);
-                } break;
-            case GGWAVE_SAMPLE_FORMAT_F32:
-                {
-                    memcpy(m_rx.amplitudeResampled.data(), dataBuffer, nBytesRecorded);
-                } break;
-        }
+        int i = 0;
+        for (; i + 4 <= n; i += 4) {
+            __m128 m0 = m; rotate();
+            __m128 m1 = m; rotate();
+            __m128 m2 = m; rotate();
+            __m128 m3 = m; rotate();
 
-        dataBuffer += nBytesRecorded;
-        nBytes -= nBytesRecorded;
+            // rows become the oscillators, columns the samples
+            _MM_TRANSPOSE4_PS(m0, m1, m2, m3);
 
-        if (nBytesRecorded % m_sampleSizeInp != 0) {
-            ggprintf("Failure during capture - provided bytes (%d) are not multiple of sample size (%d)\n",
-                    nBytesRecorded, m_sampleSizeInp);
-            m_rx.samplesNeeded = m_samplesPerFrame;
-            break;
+            _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_add_ps(_mm_add_ps(m0, m1), _mm_add_ps(m2, m3))));
         }
 
-        // convert to 32-bit float
-        int nSamplesRecorded = nBytesRecorded/m_sampleSizeInp;
-        switch (m_sampleFormatInp) {
-            case GGWAVE_SAMPLE_FORMAT_UNDEFINED: break;
-            case GGWAVE_SAMPLE_FORMAT_U8:
-                {
-                    constexpr float scale = 1.0f/128;
-                    auto p = reinterpret_cast<uint8_t *>(m_rx.amplitudeTmp.data());
-                    for (int i = 0; i < nSamplesRecorded; ++i) {
-                        m_rx.amplitudeResampled[i] = float(int16_t(*(p + i)) - 128)*scale;
-                    }
-                } break;
-            case GGWAVE_SAMPLE_FORMAT_I8:
-                {
-                    constexpr float scale = 1.0f/128;
-                    auto p = reinterpret_cast<int8_t *>(m_rx.amplitudeTmp.data());
-                    for (int i = 0; i < nSamplesRecorded; ++i) {
-                        m_rx.amplitudeResampled[i] = float(*(p + i))*scale;
-                    }
-                } break;
-            case GGWAVE_SAMPLE_FORMAT_U16:
-                {
-                    constexpr float scale = 1.0f/32768;
-                    auto p = reinterpret_cast<uint16_t *>(m_rx.amplitudeTmp.data());
-                    for (int i = 0; i < nSamplesRecorded; ++i) {
-                        m_rx.amplitudeResampled[i] = float(int32_t(*(p + i)) - 32768)*scale;
-                    }
-                } break;
-            case GGWAVE_SAMPLE_FORMAT_I16:
-                {
-                    constexpr float scale = 1.0f/32768;
-                    auto p = reinterpret_cast<int16_t *>(m_rx.amplitudeTmp.data());
-                    for (int i = 0; i < nSamplesRecorded; ++i) {
-                        m_rx.amplitudeResampled[i] = float(*(p + i))*scale;
-                    }
-                } break;
-            case GGWAVE_SAMPLE_FORMAT_F32: break;
+        for (; i < n; ++i) {
+            float v[4];
+            _mm_storeu_ps(v, m);
+            dst[i] += (v[0] + v[1]) + (v[2] + v[3]);
+            rotate();
         }
 
-        uint32_t offset = m_samplesPerFrame - m_rx.samplesNeeded;
+        _mm_storeu_ps(re + t, r);
+        _mm_storeu_ps(im + t, m);
+#elif defined(GGWAVE_SIMD_NEON)
+        float32x4_t r = vld1q_f32(re + t);
+        float32x4_t m = vld1q_f32(im + t);
 
-        if (m_needResampling) {
-            if (nSamplesRecorded <= 2*Resampler::kWidth) {
-                m_rx.samplesNeeded = m_samplesPerFrame;
-                break;
-            }
+        const float32x4_t c = vld1q_f32(cr + t);
+        const float32x4_t s = vld1q_f32(ci + t);
 
-            // reset resampler state every minute
-            if (!m_rx.receiving && m_resampler.nSamplesTotal() > 60.0f*factor*m_sampleRate) {
-                m_resampler.reset();
-            }
+        for (int i = 0; i < n; ++i) {
+            dst[i] += vaddvq_f32(m);
 
-            int nSamplesResampled = offset + m_resampler.resample(factor, nSamplesRecorded, m_rx.amplitudeResampled.data(), m_rx.amplitude.data() + offset);
-            nSamplesRecorded = nSamplesResampled;
-        } else {
-            for (int i = 0; i < nSamplesRecorded; ++i) {
-                m_rx.amplitude[offset + i] = m_rx.amplitudeResampled[i];
-            }
+            const float32x4_t r1 = vmlsq_f32(vmulq_f32(r, c), m, s);
+            m = vmlaq_f32(vmulq_f32(r, s), m, c);
+            r = r1;
         }
 
-        // we have enough bytes to do analysis
-        if (nSamplesRecorded >= m_samplesPerFrame) {
-            m_rx.hasNewAmplitude = true;
+        vst1q_f32(re + t, r);
+        vst1q_f32(im + t, m);
+#else
+        for (int j = t; j < t + 4; ++j) {
+            float r = re[j];
+            float m = im[j];
 
-            if (m_isFixedPayloadLength) {
-                decode_fixed();
-            } else {
-                decode_variable();
-            }
+            for (int i = 0; i < n; ++i) {
+                dst[i] += m;
 
-            int nExtraSamples = nSamplesRecorded - m_samplesPerFrame;
-            for (int i = 0; i < nExtraSamples; ++i) {
-                m_rx.amplitude[i] = m_rx.amplitude[m_samplesPerFrame + i];
+                const float r1 = r*cr[j] - m*ci[j];
+                m = r*ci[j] + m*cr[j];
+                r = r1;
             }
 
-            m_rx.samplesNeeded = m_samplesPerFrame - nExtraSamples;
-        } else {
-            m_rx.samplesNeeded = m_samplesPerFrame - nSamplesRecorded;
-            break;
+            re[j] = r;
+            im[j] = m;
         }
+#endif
     }
-
-    return true;
 }
 
+// energy gate of GGWAVE_OPERATING_MODE_RX_ENERGY_GATE
+constexpr float kGateThreshold = 2.0f;    // in-band energy relative to the noise floor that opens the gate
+constexpr float kGateFloorRise = 1.0065f; // max rise of the noise floor per frame, ~1.2 dB/s at 48 kHz
+constexpr float kGateEnergyMin = 1e-12f;
+constexpr int   kGateSamples   = 256;     // samples at the end of each frame used for the energy estimate
+constexpr int   kGateWarmup    = 64;      // preceding samples that let the filters settle
+
+// Second-order Butterworth high-pass or low-pass filter
 //
-// instance state
+//   c = { b0, b1, b2, a1, a2 }, normalized so that a0 = 1
+//   The filter passes everything when the cutoff frequency is outside of the usable range
 //
+void initBiquad(float * c, bool highPass, float freq, float sampleRate) {
+    if (freq <= 0.0f || freq >= 0.45f*sampleRate) {
+        c[0] = 1.0f;
+        c[1] = c[2] = c[3] = c[4] = 0.0f;
+        return;
+    }
 
-bool GGWave::isDSSEnabled() const { return m_isDSSEnabled; }
+    const double w0    = 2.0*M_PI*freq/sampleRate;
+    const double cw    = cos(w0);
+    const double alpha = sin(w0)/sqrt(2.0);
+    const double a0    = 1.0 + alpha;
+    const double b1    = highPass ? -(1.0 + cw) : 1.0 - cw;
+
+    c[0] = 0.5*fabs(b1)/a0;
+    c[1] = b1/a0;
+    c[2] = c[0];
+    c[3] = -2.0*cw/a0;
+    c[4] = (1.0 - alpha)/a0;
+}
 
-int GGWave::samplesPerFrame() const { return m_samplesPerFrame; }
-int GGWave::sampleSizeInp()   const { return m_sampleSizeInp; }
-int GGWave::sampleSizeOut()   const { return m_sampleSizeOut; }
+int bytesForSampleFormat(GGWave::SampleFormat sampleFormat) {
+    switch (sampleFormat) {
+        case GGWAVE_SAMPLE_FORMAT_UNDEFINED:    return 0;                   break;
+        case GGWAVE_SAMPLE_FORMAT_U8:           return sizeof(uint8_t);     break;
+        case GGWAVE_SAMPLE_FORMAT_I8:           return sizeof(int8_t);      break;
+        case GGWAVE_SAMPLE_FORMAT_U16:          return sizeof(uint16_t);    break;
+        case GGWAVE_SAMPLE_FORMAT_I16:          return sizeof(int16_t);     break;
+        case GGWAVE_SAMPLE_FORMAT_F32:          return sizeof(float);       break;
+    };
 
-float GGWave::hzPerSample()   const { return m_hzPerSample; }
-float GGWave::sampleRateInp() const { return m_sampleRateInp; }
-float GGWave::sampleRateOut() const { return m_sampleRateOut; }
-GGWave::SampleFormat GGWave::sampleFormatInp() const { return m_sampleFormatInp; }
-GGWave::SampleFormat GGWave::sampleFormatOut() const { return m_sampleFormatOut; }
+    ggprintf("Invalid sample format: %d\n", (int) sampleFormat);
 
-int GGWave::heapSize() const { return m_heapSize; }
+    return 0;
+}
+
+}
 
 //
-// Tx
+// ggvector
 //
 
-const void * GGWave::txWaveform() const {
-    switch (m_sampleFormatOut) {
-        case GGWAVE_SAMPLE_FORMAT_UNDEFINED: break;
-        case GGWAVE_SAMPLE_FORMAT_I16:
-            {
-                return m_tx.outputI16.data();
-            } break;
-        case GGWAVE_SAMPLE_FORMAT_U8:
-        case GGWAVE_SAMPLE_FORMAT_I8:
-        case GGWAVE_SAMPLE_FORMAT_U16:
-        case GGWAVE_SAMPLE_FORMAT_F32:
-            {
-                return m_tx.outputTmp.data();
-            } break;
-    }
+template<typename T>
+void ggvector<T>::assign(const ggvector & other) {
+    m_data = other.m_data;
+    m_size = other.m_size;
+}
 
-    return nullptr;
+template<typename T>
+void ggvector<T>::copy(const ggvector & other) {
+    if (this == &other) {
+        assert(false);
+    }
+
+    memcpy(m_data, other.m_data, GG_MIN(m_size, other.m_size)*sizeof(T));
 }
 
-const GGWave::Tones GGWave::txTones() const { return { m_tx.tones.data(), m_tx.nTones }; }
+template<typename T>
+void ggvector<T>::zero() {
+    memset(m_data, 0, m_size*sizeof(T));
+}
 
-bool GGWave::txHasData() const { return m_tx.hasData; }
+template<typename T>
+void ggvector<T>::zero(int n) {
+    memset(m_data, 0, n*sizeof(T));
+}
 
-bool GGWave::txTakeAmplitudeI16(AmplitudeI16 & dst) {
-    if (m_tx.lastAmplitudeSize == 0) return false;
+template struct ggvector<int16_t>;
 
-    dst.assign({ m_tx.outputI16.data(), m_tx.lastAmplitudeSize });
-    m_tx.lastAmplitudeSize = 0;
+//
+// ggmatrix
+//
 
-    return true;
+template <typename T>
+void ggmatrix<T>::zero() {
+    if (m_size0 > 0 && m_size1 > 0) {
+        memset(m_data, 0, m_size0*m_size1*sizeof(T));
+    }
 }
 
-const GGWave::RxProtocols & GGWave::txProtocols() const { return m_tx.protocols; }
-
 //
-// Rx
+// Protocols
 //
 
-bool GGWave::rxReceiving() const { return m_rx.receiving; }
-bool GGWave::rxAnalyzing() const { return m_rx.analyzing; }
-
-int GGWave::rxSamplesNeeded()       const { return m_rx.samplesNeeded; }
-int GGWave::rxFramesToRecord()      const { return m_rx.framesToRecord; }
-int GGWave::rxFramesLeftToRecord()  const { return m_rx.framesLeftToRecord; }
-int GGWave::rxFramesToAnalyze()     const { return m_rx.framesToAnalyze; }
-int GGWave::rxFramesLeftToAnalyze() const { return m_rx.framesLeftToAnalyze; }
-int GGWave::rxDurationFrames()      const { return m_rx.recvDuration_frames; }
+void GGWave::Protocols::enableAll() {
+    for (int i = 0; i < GGWAVE_PROTOCOL_COUNT; i++) {
+        auto & p = this->data[i];
+        if (p.name && p.ofdm == false) {
+            p.enabled = true;
+        }
+    }
+}
 
-bool GGWave::rxStopReceiving() {
-    if (m_rx.receiving == false) {
-        return false;
+void GGWave::Protocols::disableAll() {
+    for (int i = 0; i < GGWAVE_PROTOCOL_COUNT; i++) {
+        auto & p = this->data[i];
+        p.enabled = false;
     }
+}
 
-    m_rx.receiving = false;
+void GGWave::Protocols::toggle(ProtocolId id, bool state) {
+    if (state) {
+        // enable protocol
+        data[id].enabled = true;
+    } else {
+        // disable protocol
+        data[id].enabled = false;
+    }
+}
 
-    return true;
+void GGWave::Protocols::only(ProtocolId id) {
+    disableAll();
+    data[id].enabled = true;
 }
 
-GGWave::RxProtocols & GGWave::rxProtocols() { return m_rx.protocols; }
+GGWave::TxProtocols & GGWave::Protocols::tx() {
+    static TxProtocols protocols = kDefault();
 
-int GGWave::rxDataLength() const { return m_rx.dataLength; }
+    return protocols;
+}
 
-const GGWave::TxRxData &      GGWave::rxData()       const { return m_rx.data; }
-const GGWave::RxProtocol &    GGWave::rxProtocol()   const { return m_rx.protocol; }
-const GGWave::RxProtocolId &  GGWave::rxProtocolId() const { return m_rx.protocolId; }
-const GGWave::Spectrum &      GGWave::rxSpectrum()   const { return m_rx.spectrum; }
-const GGWave::Amplitude &     GGWave::rxAmplitude()  const { return m_rx.amplitude; }
+GGWave::RxProtocols & GGWave::Protocols::rx() {
+    static RxProtocols protocols = kDefault();
 
-int GGWave::rxTakeData(TxRxData & dst) {
-    if (m_rx.dataLength == 0) return 0;
+    return protocols;
+}
 
-    auto res = m_rx.dataLength;
-    m_rx.dataLength = 0;
+const int kAlignment = GGWave::Layout::kAlignment;
 
-    if (res != -1) {
-        dst.assign({ m_rx.data.data(), res });
+//template <typename T>
+//void ggalloc(std::vector<T> & v, int n, void * buf, int & bufSize) {
+//    if (buf == nullptr) {
+//        bufSize += n*sizeof(T);
+//        bufSize = ((bufSize + kAlignment - 1)/kAlignment)*kAlignment;
+//        return;
+//    }
+//
+//    v.resize(n);
+//    bufSize += n*sizeof(T);
+//    bufSize = ((bufSize + kAlignment - 1)/kAlignment)*kAlignment;
+//}
+//
+//template <typename T>
+//void ggalloc(std::vector<std::vector<T>> & v, int n, int m, void * buf, int & bufSize) {
+//    if (buf == nullptr) {
+//        bufSize += n*m*sizeof(T);
+//        bufSize = ((bufSize + kAlignment - 1)/kAlignment)*kAlignment;
+//        return;
+//    }
+//
+//    v.resize(n);
+//    for (int i = 0; i < n; i++) {
+//        v[i].resize(m);
+//    }
+//    bufSize += n*m*sizeof(T);
+//    bufSize = ((bufSize + kAlignment - 1)/kAlignment)*kAlignment;
+//}
+
+template <typename T>
+void ggalloc(ggvector<T> & v, int n, void * buf, int & bufSize) {
+    if (buf == nullptr) {
+        bufSize += n*sizeof(T);
+        bufSize = ((bufSize + kAlignment - 1)/kAlignment)*kAlignment;
+        return;
     }
 
-    return res;
+    v.assign(ggvector<T>((T *)((char *) buf + bufSize), n));
+    bufSize += n*sizeof(T);
+    bufSize = ((bufSize + kAlignment - 1)/kAlignment)*kAlignment;
 }
 
-bool GGWave::rxTakeSpectrum(Spectrum & dst) {
-    if (m_rx.hasNewSpectrum == false) return false;
-
-    m_rx.hasNewSpectrum = false;
-    dst.assign(m_rx.spectrum);
+template <typename T>
+void ggalloc(ggmatrix<T> & v, int n, int m, void * buf, int & bufSize) {
+    if (buf == nullptr) {
+        bufSize += n*m*sizeof(T);
+        bufSize = ((bufSize + kAlignment - 1) / kAlignment)*kAlignment;
+        return;
+    }
 
-    return true;
+    v = ggmatrix<T>((T *)((char *) buf + bufSize), n, m);
+    bufSize += n*m*sizeof(T);
+    bufSize = ((bufSize + kAlignment - 1)/kAlignment)*kAlignment;
 }
 
-bool GGWave::rxTakeAmplitude(Amplitude & dst) {
-    if (m_rx.hasNewAmplitude == false) return false;
+//
+// GGWave
+//
 
-    m_rx.hasNewAmplitude = false;
-    dst.assign(m_rx.amplitude);
+GGWave::GGWave(const Parameters & parameters) {
+    prepare(parameters);
+}
 
-    return true;
+GGWave::~GGWave() {
+    if (m_heap && m_heapOwned) {
+        free(m_heap);
+    }
 }
 
-bool GGWave::computeFFTR(const float * src, float * dst, int N) {
-    if (N != m_samplesPerFrame) {
-        ggprintf("computeFFTR: N (%d) must be equal to 'samplesPerFrame' %d\n", N, m_samplesPerFrame);
+bool GGWave::prepare(const Parameters & parameters, bool allocate) {
+    if (prepareParameters(parameters, Protocols::rx(), Protocols::tx()) == false) {
         return false;
     }
 
-    FFT(src, dst, N, m_rx.fftWorkI.data(), m_rx.fftWorkF.data());
-
-    return true;
-}
-
-int GGWave::computeFFTR(const float * src, float * dst, int N, int * wi, float * wf) {
-    if (wi == nullptr) return 2*N;
-    if (wf == nullptr) return 3 + sqrt(N/2);
+    if (allocate == false) {
+        return true;
+    }
 
-    FFT(src, dst, N, wi, wf);
+    m_heap = calloc(m_heapSize, 1);
+    m_heapOwned = true;
 
-    return 1;
+    return prepareMemory();
 }
 
-int GGWave::filter(ggwave_Filter filter, float * waveform, int N, float p0, float p1, float * w) {
-    if (w == nullptr) {
-        switch (filter) {
-            case GGWAVE_FILTER_HANN:                  return N;
-            case GGWAVE_FILTER_HAMMING:               return N;
-            case GGWAVE_FILTER_FIRST_ORDER_HIGH_PASS: return 11;
-        };
+bool GGWave::prepare(const Parameters & parameters, void * buffer, int bufferSize, const RxProtocols & rxProtocols, const TxProtocols & txProtocols) {
+    if (buffer == nullptr) {
+        ggprintf("Error: invalid memory buffer\n");
+        return false;
     }
 
-    if (w[0] == 0.0f && w[1] == 0.0f) {
-        switch (filter) {
-            case GGWAVE_FILTER_HANN:
-                {
-                    const float f = 2.0f*M_PI/(float)N;
-                    for (int i = 0; i < N; i++) {
-                        w[i] = 0.5f - 0.5f*cosf(f*(float)i);
-                    }
-                } break;
-            case GGWAVE_FILTER_HAMMING:
-                {
-                    const float f = 2.0f*M_PI/(float)N;
-                    for (int i = 0; i < N; i++) {
-                        w[i] = 0.54f - 0.46f*cosf(f*(float)i);
-                    }
-                } break;
-            case GGWAVE_FILTER_FIRST_ORDER_HIGH_PASS:
-                {
-                    const float th = 2.0f*M_PI*p0/p1;
-                    const float g = cos(th)/(1.0f + sin(th));
-                    w[0] = (1.0f + g)/2.0f;
-                    w[1] = -((1.0f + g)/2.0f);
-                    w[2] = 0.0f;
-                    w[3] = -g;
-                    w[4] = 0.0f;
+    if (prepareParameters(parameters, rxProtocols, txProtocols) == false) {
+        return false;
+    }
 
-                    w[5] = 0.0f;
-                    w[6] = 0.0f;
-                    w[7] = 0.0f;
-                    w[8] = 0.0f;
-                } break;
-        };
+    if (bufferSize < m_heapSize) {
+        ggprintf("Error: memory buffer is too small - required: %d, provided: %d\n", m_heapSize, bufferSize);
+        return false;
     }
 
-    switch (filter) {
-        case GGWAVE_FILTER_HANN:
-        case GGWAVE_FILTER_HAMMING:
-            {
-                for (int i = 0; i < N; i++) {
-                    waveform[i] *= w[i];
-                }
-            } break;
-        case GGWAVE_FILTER_FIRST_ORDER_HIGH_PASS:
-            {
-                for (int i = 0; i < N; i++) {
-                    float xn = waveform[i];
-                    float yn = w[0]*xn + w[1]*w[5] + w[2]*w[6] + w[3]*w[7] + w[4]*w[8];
-                    w[6] = w[5];
-                    w[5] = xn;
-                    w[8] = w[7];
-                    w[7] = yn;
+    m_heap = buffer;
+    m_heapOwned = false;
 
-                    waveform[i] = yn;
-                }
-            } break;
-    };
+    memset(m_heap, 0, m_heapSize);
 
-    return 1;
+    return prepareMemory();
 }
 
-//
-// GGWave::Resampler
-//
-
-GGWave::Resampler::Resampler() {}
-
-bool GGWave::Resampler::alloc(void * p, int & n) {
-    ggalloc(m_sincTable,   kWidth*kSamplesPerZeroCrossing, p, n);
-    ggalloc(m_delayBuffer, 3*kWidth, p, n);
-    ggalloc(m_edgeSamples, kWidth, p, n);
-    ggalloc(m_samplesInp,  4096, p, n);
-
-    if (p) {
-        makeSinc();
-        reset();
+bool GGWave::prepareParameters(const Parameters & parameters, const RxProtocols & rxProtocols, const TxProtocols & txProtocols) {
+    if (m_heap && m_heapOwned) {
+        free(m_heap);
     }
 
-    return true;
-}
+    m_heap = nullptr;
+    m_heapSize = 0;
+    m_heapOwned = false;
 
-void GGWave::Resampler::reset() {
-    m_state = {};
+    // parameter initialization:
+
+    m_sampleRateInp        = parameters.sampleRateInp;
+    m_sampleRateOut        = parameters.sampleRateOut;
+    m_sampleRate           = parameters.sampleRate;
+    m_samplesPerFrame      = parameters.samplesPerFrame;
+    m_isamplesPerFrame     = 1.0f/m_samplesPerFrame;
+    m_sampleSizeInp        = bytesForSampleFormat(parameters.sampleFormatInp);
+    m_sampleSizeOut        = bytesForSampleFormat(parameters.sampleFormatOut);
+    m_sampleFormatInp      = parameters.sampleFormatInp;
+    m_sampleFormatOut      = parameters.sampleFormatOut;
+    m_channelsInp          = GG_MAX(1, parameters.channelsInp);
+    m_channelMode          = parameters.channelMode;
+    m_hzPerSample          = m_sampleRate/m_samplesPerFrame;
+    m_ihzPerSample         = 1.0f/m_hzPerSample;
+    m_freqDelta_bin        = 1;
+    m_freqDelta_hz         = 2*m_hzPerSample;
+    m_nBitsInMarker        = 16;
+    m_nMarkerFrames        = parameters.payloadLength > 0 ? 0 :
+                             (parameters.operatingMode & GGWAVE_OPERATING_MODE_SHORT_PREAMBLE) ? kPreambleFrames : kDefaultMarkerFrames;
+    m_nMarkerFramesEnd     = (parameters.operatingMode & GGWAVE_OPERATING_MODE_SHORT_PREAMBLE) ? 0 : m_nMarkerFrames;
+    m_encodedDataOffset    = parameters.payloadLength > 0 ? 0 : kDefaultEncodedDataOffset;
+    m_soundMarkerThreshold = parameters.soundMarkerThreshold;
+    m_isFixedPayloadLength = parameters.payloadLength > 0;
+    m_payloadLength        = parameters.payloadLength;
+    m_isRxEnabled          = parameters.operatingMode & GGWAVE_OPERATING_MODE_RX;
+    m_isTxEnabled          = parameters.operatingMode & GGWAVE_OPERATING_MODE_TX;
+    m_needResampling       = m_sampleRateInp != m_sampleRate || m_sampleRateOut != m_sampleRate;
+    m_txOnlyTones          = parameters.operatingMode & GGWAVE_OPERATING_MODE_TX_ONLY_TONES;
+    m_isDSSEnabled         = parameters.operatingMode & GGWAVE_OPERATING_MODE_USE_DSS;
+    m_isRxMultiStream      = parameters.operatingMode & GGWAVE_OPERATING_MODE_RX_MULTI_STREAM;
+    m_isTxMultiStream      = parameters.operatingMode & GGWAVE_OPERATING_MODE_TX_MULTI_STREAM;
+    m_isLongPayload        = parameters.operatingMode & GGWAVE_OPERATING_MODE_LONG_PAYLOAD;
+    m_isRxContinuous       = parameters.operatingMode & GGWAVE_OPERATING_MODE_RX_CONTINUOUS;
+    m_isRxEnergyGate       = parameters.operatingMode & GGWAVE_OPERATING_MODE_RX_ENERGY_GATE;
+    m_isTxIFFT             = parameters.operatingMode & GGWAVE_OPERATING_MODE_TX_IFFT;
+    m_isTxNCO              = parameters.operatingMode & GGWAVE_OPERATING_MODE_TX_NCO;
+    m_isTxLowCrest         = parameters.operatingMode & GGWAVE_OPERATING_MODE_TX_LOW_CREST;
+    m_isShortPreamble      = parameters.operatingMode & GGWAVE_OPERATING_MODE_SHORT_PREAMBLE;
+
+    if (m_sampleSizeInp == 0) {
+        ggprintf("Invalid or unsupported capture sample format: %d\n", (int) parameters.sampleFormatInp);
+        return false;
+    }
+
+    if (m_sampleSizeOut == 0) {
+        ggprintf("Invalid or unsupported playback sample format: %d\n", (int) parameters.sampleFormatOut);
+        return false;
+    }
+
+    if (parameters.samplesPerFrame > kMaxSamplesPerFrame) {
+        ggprintf("Invalid samples per frame: %d, max: %d\n", parameters.samplesPerFrame, kMaxSamplesPerFrame);
+        return false;
+    }
+
+    if (m_sampleRateInp < kSampleRateMin) {
+        ggprintf("Error: capture sample rate (%g Hz) must be >= %g Hz\n", m_sampleRateInp, kSampleRateMin);
+        return false;
+    }
+
+    if (m_sampleRateInp > kSampleRateMax) {
+        ggprintf("Error: capture sample rate (%g Hz) must be <= %g Hz\n", m_sampleRateInp, kSampleRateMax);
+        return false;
+    }
+
+    if (m_channelsInp > kMaxChannelsInp) {
+        ggprintf("Invalid number of capture channels: %d, max: %d\n", m_channelsInp, kMaxChannelsInp);
+        return false;
+    }
+
+    if (m_channelMode < GGWAVE_CHANNEL_MODE_DOWNMIX || m_channelMode > GGWAVE_CHANNEL_MODE_PER_CHANNEL) {
+        ggprintf("Invalid channel mode: %d\n", (int) m_channelMode);
+        return false;
+    }
+
+    if (m_channelsInp > 1 && m_channelMode != GGWAVE_CHANNEL_MODE_DOWNMIX && m_sampleRateInp != m_sampleRate) {
+        ggprintf("Error: channel mode %d requires the capture sample rate to be equal to the operating sample rate\n", (int) m_channelMode);
+        return false;
+    }
+
+    if (m_isRxMultiStream && m_isFixedPayloadLength) {
+        ggprintf("Error: multi-stream Rx is supported only with variable payload length\n");
+        return false;
+    }
+
+    if (m_isRxContinuous && m_isFixedPayloadLength == false) {
+        ggprintf("Error: continuous Rx is supported only with fixed payload length\n");
+        return false;
+    }
+
+    if (m_isLongPayload && m_isFixedPayloadLength) {
+        ggprintf("Error: long payloads are supported only with variable payload length\n");
+        return false;
+    }
+
+    if (m_isLongPayload && (m_isRxMultiStream || m_isTxMultiStream)) {
+        ggprintf("Error: long payloads cannot be used together with multi-stream Rx or Tx\n");
+        return false;
+    }
+
+    if (m_isTxMultiStream && m_txOnlyTones) {
+        ggprintf("Error: multi-stream Tx cannot be used together with GGWAVE_OPERATING_MODE_TX_ONLY_TONES\n");
+        return false;
+    }
+
+    if (m_isShortPreamble && m_isFixedPayloadLength) {
+        ggprintf("Error: the short preamble is supported only with variable payload length\n");
+        return false;
+    }
+
+    if (m_isShortPreamble && m_txOnlyTones) {
+        ggprintf("Error: the short preamble cannot be used together with GGWAVE_OPERATING_MODE_TX_ONLY_TONES\n");
+        return false;
+    }
+
+    if (m_isShortPreamble && (m_samplesPerFrame & (m_samplesPerFrame - 1)) != 0) {
+        ggprintf("Error: the short preamble requires a power-of-2 number of samples per frame: %d\n", m_samplesPerFrame);
+        return false;
+    }
+
+    if (m_isTxIFFT && m_isTxNCO) {
+        ggprintf("Error: GGWAVE_OPERATING_MODE_TX_IFFT and GGWAVE_OPERATING_MODE_TX_NCO cannot be used together\n");
+        return false;
+    }
+
+    // the phases of the low-crest mode change from symbol to symbol, so they cannot be stored in the sine tables
+    if (m_isTxLowCrest && m_isTxIFFT == false) {
+        m_isTxNCO = true;
+    }
+
+    if (m_isTxIFFT && (m_samplesPerFrame & (m_samplesPerFrame - 1)) != 0) {
+        ggprintf("Error: IFFT synthesis requires a power-of-2 number of samples per frame: %d\n", m_samplesPerFrame);
+        return false;
+    }
+
+#ifdef GGWAVE_CONFIG_FIXED_POINT
+    if (m_isRxEnabled && m_isFixedPayloadLength && (m_samplesPerFrame & (m_samplesPerFrame - 1)) != 0) {
+        ggprintf("Error: the fixed-point FFT requires a power-of-2 number of samples per frame: %d\n", m_samplesPerFrame);
+        return false;
+    }
+#endif
+
+    // each Tx carries a whole number of symbols and the mono-tone protocols transmit nibbles
+    for (int i = 0; i < 2*GGWAVE_PROTOCOL_COUNT; ++i) {
+        const auto & protocol = i < GGWAVE_PROTOCOL_COUNT ? rxProtocols[i] : txProtocols[i - GGWAVE_PROTOCOL_COUNT];
+        if (protocol.enabled == false) {
+            continue;
+        }
+
+        const int nBits = protocol.nSymbolBits();
+        if (nBits > 6 || protocol.nDataBitsPerTx() % nBits != 0 || protocol.binSpacing < 0 || (protocol.extra != 1 && nBits != 4)) {
+            ggprintf("Error: protocol %d has invalid symbols - bits per symbol: %d, bin spacing: %d\n",
+                     i % GGWAVE_PROTOCOL_COUNT, nBits, protocol.nBinSpacing());
+            return false;
+        }
+
+        // the OFDM symbols of a block carry an equal number of bytes in groups of 8 subcarriers,
+        // below the Nyquist frequency of the frame
+        if (protocol.ofdm && (protocol.framesPerTx < 3 || nBits != 2 ||
+                              protocol.bytesPerTx % (2*(protocol.framesPerTx - 2)) != 0 || protocol.freqStart < 1)) {
+            ggprintf("Error: protocol %d has an invalid OFDM block - frames per Tx: %d, bytes per Tx: %d\n",
+                     i % GGWAVE_PROTOCOL_COUNT, (int) protocol.framesPerTx, (int) protocol.bytesPerTx);
+            return false;
+        }
+
+        if (protocol.ofdm && m_isFixedPayloadLength == false &&
+            ((m_samplesPerFrame & (m_samplesPerFrame - 1)) != 0 || m_samplesPerFrame % protocol.nOFDMSymbols() != 0 ||
+             2*(protocol.freqStart + protocol.nOFDMCarriers()) >= m_samplesPerFrame)) {
+            ggprintf("Error: protocol %d does not fit in an OFDM symbol of %d samples\n", i % GGWAVE_PROTOCOL_COUNT, m_samplesPerFrame);
+            return false;
+        }
+    }
+
+    m_rx.protocols = rxProtocols;
+    m_tx.protocols = txProtocols;
+
+    // memory requirements:
+
+    if (this->alloc(m_heap, m_heapSize) == false) {
+        ggprintf("Error: failed to compute the size of the required memory\n");
+        return false;
+    }
+
+    return true;
+}
+
+bool GGWave::prepareMemory() {
+    const auto heapSize0 = m_heapSize;
+
+    m_heapSize = 0;
+    if (this->alloc(m_heap, m_heapSize) == false) {
+        ggprintf("Error: failed to allocate the required memory: %d\n", m_heapSize);
+        return false;
+    }
+
+    if (heapSize0 != m_heapSize) {
+        ggprintf("Error: failed to allocate memory - heapSize0: %d, heapSize: %d\n", heapSize0, m_heapSize);
+        return false;
+    }
+
+    if (m_isRxEnabled) {
+        m_rx.samplesNeeded = m_samplesPerFrame;
+
+        m_rx.fftWorkI[0] = 0;
+        if (m_isShortPreamble) {
+            m_rx.preambleWorkI[0] = 0;
+        }
+
+        m_rx.protocol   = {};
+        m_rx.protocolId = GGWAVE_PROTOCOL_COUNT;
+
+        m_rx.minFreqStart = minFreqStart(m_rx.protocols);
+
+        m_rx.channelId = 0;
+
+        // compile the decode plan
+        for (int i = 0; i < m_rx.protocols.size(); ++i) {
+            const int b = m_rx.bandId[i];
+            if (m_isFixedPayloadLength || b < 0) {
+                continue;
+            }
+
+            const auto & protocol = m_rx.protocols[i];
+
+            m_rx.bandFreqStart[b] = protocol.freqStart;
+            m_rx.bandDataBin[b]   = round(double(m_hzPerSample*protocol.freqStart)*m_ihzPerSample);
+
+            for (int k = 0; k < m_nBitsInMarker; ++k) {
+                m_rx.bandMarkerBins[b][k] = round(bitFreq(protocol, k)*m_ihzPerSample);
+            }
+
+            if (m_isShortPreamble) {
+                auto & x = m_rx.preambleFFT;
+
+                x.zero();
+                ::preambleChirp(protocol.freqStart, 2*m_nBitsInMarker, x.data(), m_samplesPerFrame);
+                rdft(2*m_samplesPerFrame, 1, x.data(), m_rx.preambleWorkI.data(), m_rx.preambleWorkF.data());
+
+                for (int i = 0; i < 2*m_samplesPerFrame; ++i) {
+                    m_rx.preambleTemplate[b][i] = x[i];
+                }
+
+                m_rx.preambleLag[b] = -1;
+            }
+        }
+
+        // the energy gate passes the frequency bands of all enabled protocols
+        {
+            int freqEnd = m_rx.minFreqStart;
+            for (int i = 0; i < m_rx.protocols.size(); ++i) {
+                const auto & protocol = m_rx.protocols[i];
+                if (protocol.enabled) {
+                    freqEnd = GG_MAX(freqEnd, protocol.freqStart + protocol.nDataBins());
+                }
+            }
+
+            ::initBiquad(m_rx.gateFilter[0], true,  m_hzPerSample*m_rx.minFreqStart, m_sampleRate);
+            ::initBiquad(m_rx.gateFilter[1], false, m_hzPerSample*freqEnd,           m_sampleRate);
+        }
+    }
+
+    if (m_isTxEnabled && (m_isTxIFFT || anyOFDM(m_tx.protocols)) && m_txOnlyTones == false) {
+        m_tx.synthWorkI[0] = 0;
+    }
+
+    return init("", {}, 0);
+}
+
+bool GGWave::alloc(void * p, int & n) {
+    const int n0 = n;
+
+    // the decode plan - the ring buffers of the fixed-length protocols and the frequency bands of the variable-length ones
+    const int nGroups = maxSymbolsPerTx(m_rx.protocols);
+
+    int nSlots = 0;
+    int nVotes = 0;
+
+    m_rx.nBands = 0;
+    for (int i = 0; i < m_rx.protocols.size(); ++i) {
+        const auto & protocol = m_rx.protocols[i];
+
+        // the OFDM protocols are received only with variable payload length
+        m_rx.slotsFixed[i] = m_isFixedPayloadLength && protocol.enabled && protocol.ofdm == false ? nSlots++ : -1;
+        if (m_rx.slotsFixed[i] >= 0) {
+            // the votes of each group are kept for all tones of its symbol
+            nVotes = GG_MAX(nVotes, protocol.nSymbolTones()*nGroups);
+        }
+
+        m_rx.bandId[i] = -1;
+        if (m_isFixedPayloadLength || protocol.enabled == false) {
+            continue;
+        }
+
+        for (int j = 0; j < i; ++j) {
+            if (m_rx.bandId[j] >= 0 && m_rx.protocols[j].freqStart == protocol.freqStart) {
+                m_rx.bandId[i] = m_rx.bandId[j];
+                break;
+            }
+        }
+
+        if (m_rx.bandId[i] < 0) {
+            m_rx.bandId[i] = m_rx.nBands++;
+        }
+    }
+
+    const Layout layout = {
+        m_samplesPerFrame,
+        m_sampleSizeInp,
+        m_sampleSizeOut,
+        m_channelsInp,
+        m_channelMode,
+        m_isFixedPayloadLength ? m_payloadLength : -1,
+        m_nBitsInMarker,
+
+        m_isRxEnabled,
+        m_isTxEnabled,
+        m_needResampling,
+        m_isRxMultiStream,
+        m_isTxMultiStream,
+        m_isLongPayload,
+        m_isShortPreamble,
+        m_txOnlyTones,
+        m_isTxIFFT,
+        m_isTxNCO,
+
+        minBytesPerTx(m_rx.protocols),
+        maxFramesPerTx(m_rx.protocols),
+        nGroups,
+        nVotes,
+        nSlots,
+        m_rx.nBands,
+        minBytesPerTx(m_tx.protocols),
+        maxDataBins(m_tx.protocols),
+        maxTonesPerTx(m_tx.protocols),
+        anyOFDM(m_tx.protocols),
+    };
+
+    if (layout.totalLength() > kMaxDataSize) {
+        ggprintf("Error: total length %d (payload %d + ECC %d bytes) is too large ( > %d)\n",
+                 layout.totalLength(), layout.maxLength(), layout.eccLength(), kMaxDataSize);
+        return false;
+    }
+
+    // common
+    ::ggalloc(m_dataEncoded, layout.maxEncodedLength() + layout.encodedDataOffset(), p, n);
+
+    if (m_isRxEnabled) {
+        ::ggalloc(m_rx.fftOut,   2*m_samplesPerFrame, p, n);
+        ::ggalloc(m_rx.fftWorkI, layout.fftWorkI(m_samplesPerFrame), p, n);
+        ::ggalloc(m_rx.fftWorkF, m_samplesPerFrame/2, p, n);
+
+        ::ggalloc(m_rx.spectrum,           m_samplesPerFrame, p, n);
+        // small extra space because sometimes resampling needs a few more samples:
+        ::ggalloc(m_rx.amplitude,          layout.amplitude(), p, n);
+        // min input sampling rate is 0.125*m_sampleRate:
+        ::ggalloc(m_rx.amplitudeResampled, layout.amplitudeResampled(), p, n);
+        ::ggalloc(m_rx.amplitudeTmp,       layout.amplitudeTmp(), p, n);
+
+        if (layout.channels() > 0) {
+            ::ggalloc(m_rx.spectrumChannel,   m_samplesPerFrame, p, n);
+            ::ggalloc(m_rx.amplitudeChannels, layout.channels(), m_samplesPerFrame, p, n);
+        }
+
+        ::ggalloc(m_rx.data, layout.maxDataLength() + 1, p, n); // extra byte for null-termination
+
+        ::ggalloc(m_rx.confidence, layout.maxEncodedLength() + layout.encodedDataOffset(), p, n);
+        ::ggalloc(m_rx.erasures,   layout.eccLength(), p, n);
+
+        m_rx.nStreams = 0;
+
+        if (m_isFixedPayloadLength) {
+            if (m_payloadLength > kMaxLengthFixed) {
+                ggprintf("Invalid payload length: %d, max: %d\n", m_payloadLength, kMaxLengthFixed);
+                return false;
+            }
+
+            m_rx.historySizeFixed = layout.historySizeFixed();
+
+            ::ggalloc(m_rx.spectrumFixed, m_samplesPerFrame, p, n);
+            ::ggalloc(m_rx.tonesFixed,    nSlots*m_rx.historySizeFixed, nGroups, p, n);
+            ::ggalloc(m_rx.majorityFixed, nSlots*m_rx.historySizeFixed, nGroups, p, n);
+            ::ggalloc(m_rx.votesMaxFixed, nSlots*m_rx.historySizeFixed, nGroups, p, n);
+            ::ggalloc(m_rx.votesFixed,    nSlots, nVotes, p, n);
+            ::ggalloc(m_rx.detectedFixed, nSlots*m_rx.historySizeFixed, p, n);
+
+#ifdef GGWAVE_CONFIG_FIXED_POINT
+            ::ggalloc(m_rx.fftQ15,   m_samplesPerFrame, p, n);
+            ::ggalloc(m_rx.powerQ15, m_samplesPerFrame/2 + 1, p, n);
+#endif
+        } else {
+            // variable payload length
+            ::ggalloc(m_rx.amplitudeRecorded, layout.maxRecordedFrames()*m_samplesPerFrame, p, n);
+            ::ggalloc(m_rx.amplitudeAverage,  m_samplesPerFrame, p, n);
+            ::ggalloc(m_rx.amplitudeHistory,  kMaxSpectrumHistory, m_samplesPerFrame, p, n);
+
+            ::ggalloc(m_rx.bandFreqStart,  m_rx.nBands, p, n);
+            ::ggalloc(m_rx.bandDataBin,    m_rx.nBands, p, n);
+            ::ggalloc(m_rx.bandMarkerBins, m_rx.nBands, m_nBitsInMarker, p, n);
+
+            if (m_isShortPreamble) {
+                ::ggalloc(m_rx.preambleFFT,      2*m_samplesPerFrame, p, n);
+                ::ggalloc(m_rx.preambleCorr,     2*m_samplesPerFrame, p, n);
+                ::ggalloc(m_rx.preambleWorkI,    layout.fftWorkI(2*m_samplesPerFrame), p, n);
+                ::ggalloc(m_rx.preambleWorkF,    m_samplesPerFrame, p, n);
+                ::ggalloc(m_rx.preambleTemplate, m_rx.nBands, 2*m_samplesPerFrame, p, n);
+                ::ggalloc(m_rx.preambleLag,      m_rx.nBands, p, n);
+            }
+
+            m_rx.nStreams = layout.rxStreams();
+
+            if (m_isRxMultiStream) {
+                for (int i = 0; i < m_rx.nStreams; ++i) {
+                    ::ggalloc(m_rx.streams[i].data, layout.maxLength() + 1, p, n);
+                }
+            } else {
+                // a single stream decodes directly into the Rx data
+                m_rx.streams[0].data.assign(m_rx.data);
+            }
+        }
+    }
+
+    if (m_isTxEnabled) {
+        const int maxDataBits = layout.txMaxDataBins;
+
+        for (int i = 0; i < layout.txStreams(); ++i) {
+            auto & stream = m_tx.streams[i];
+
+            if (m_txOnlyTones == false) {
+                ::ggalloc(stream.phaseOffsets,  maxDataBits, p, n);
+                if (m_isTxIFFT == false && m_isTxNCO == false) {
+                    ::ggalloc(stream.bit0Amplitude, maxDataBits, m_samplesPerFrame, p, n);
+                    ::ggalloc(stream.bit1Amplitude, maxDataBits, m_samplesPerFrame, p, n);
+                }
+            }
+
+            ::ggalloc(stream.data, layout.maxDataLength() + 1, p, n); // first byte stores the length
+
+            if (i == 0) {
+                stream.dataEncoded.assign(m_dataEncoded);
+            } else {
+                ::ggalloc(stream.dataEncoded, layout.maxEncodedLength() + layout.encodedDataOffset(), p, n);
+            }
+        }
+
+        if (m_txOnlyTones == false) {
+            ::ggalloc(m_tx.output,          m_samplesPerFrame, p, n);
+            ::ggalloc(m_tx.outputResampled, 2*m_samplesPerFrame, p, n);
+            ::ggalloc(m_tx.outputTmp,       layout.maxRecordedFrames()*m_samplesPerFrame*m_sampleSizeOut, p, n);
+            ::ggalloc(m_tx.outputI16,       layout.maxRecordedFrames()*m_samplesPerFrame, p, n);
+
+            // inverse FFT, NCO, OFDM and short preamble synthesis
+            if (layout.txSynth() > 0) {
+                ::ggalloc(m_tx.synth, layout.txSynth(), p, n);
+            }
+
+            if (layout.txSynthWorkF() > 0) {
+                ::ggalloc(m_tx.synthWorkI, layout.fftWorkI(m_samplesPerFrame), p, n);
+                ::ggalloc(m_tx.synthWorkF, layout.txSynthWorkF(), p, n);
+            }
+
+            // the OFDM frame is assembled from the symbols that overlap it
+            if (layout.txAnyOFDM) {
+                ::ggalloc(m_tx.ofdmFrame, m_samplesPerFrame, p, n);
+            }
+
+            // the tones of a single frame of one stream, in groups of 4
+            if (layout.txOscillators() > 0) {
+                ::ggalloc(m_tx.ncoRe,  layout.txOscillators(), p, n);
+                ::ggalloc(m_tx.ncoIm,  layout.txOscillators(), p, n);
+                ::ggalloc(m_tx.ncoCr,  layout.txOscillators(), p, n);
+                ::ggalloc(m_tx.ncoCi,  layout.txOscillators(), p, n);
+            }
+        }
+
+        // the tones of the built-in protocols fit in a Tone
+        m_tx.isWideTones = layout.txWideTones();
+
+        ::ggalloc(m_tx.dataBits, maxDataBits, p, n);
+        if (m_tx.isWideTones) {
+            ::ggalloc(m_tx.tonesWide, layout.txTones(), p, n);
+        } else {
+            ::ggalloc(m_tx.tones,     layout.txTones(), p, n);
+        }
+    }
+
+    // pre-allocate Reed-Solomon memory buffers
+    if (m_isFixedPayloadLength == false) {
+        ::ggalloc(m_workRSLength, layout.rsWorkLength(), p, n);
+    }
+    ::ggalloc(m_workRSData, layout.rsWorkData(), p, n);
+
+    if (m_needResampling) {
+        m_resampler.alloc(p, n, layout.resamplerSamples());
+    }
+
+    // the buffers above must match Layout::heapSize()
+    if (n - n0 != layout.heapSize()) {
+        ggprintf("Error: the allocated memory %d does not match the memory layout %d\n", n - n0, layout.heapSize());
+        return false;
+    }
+
+    return true;
+}
+
+void GGWave::setLogFile(FILE * fptr) {
+    g_fptr = fptr;
+}
+
+const GGWave::Parameters & GGWave::getDefaultParameters() {
+    static ggwave_Parameters result {
+        -1, // vaiable payload length
+        kDefaultSampleRate,
+        kDefaultSampleRate,
+        kDefaultSampleRate,
+        kDefaultSamplesPerFrame,
+        kDefaultSoundMarkerThreshold,
+        GGWAVE_SAMPLE_FORMAT_F32,
+        GGWAVE_SAMPLE_FORMAT_F32,
+        GGWAVE_OPERATING_MODE_RX | GGWAVE_OPERATING_MODE_TX,
+        1,
+        GGWAVE_CHANNEL_MODE_DOWNMIX,
+    };
+
+    return result;
+}
+
+bool GGWave::init(const char * text, TxProtocolId protocolId, const int volume) {
+    return init(strlen(text), text, protocolId, volume);
+}
+
+bool GGWave::init(int dataSize, const char * dataBuffer, TxProtocolId protocolId, const int volume) {
+    if (dataSize < 0) {
+        ggprintf("Negative data size: %d\n", dataSize);
+        return false;
+    }
+
+    // Tx
+    if (m_isTxEnabled) {
+        if (volume < 0 || volume > 100) {
+            ggprintf("Invalid volume: %d\n", volume);
+            return false;
+        }
+
+        m_tx.hasData = false;
+        m_tx.nStreams = 0;
+        m_tx.streams[0].data.zero();
+        m_dataEncoded.zero();
+
+        if (dataSize > 0) {
+            if (init_stream(m_tx.streams[0], dataSize, dataBuffer, protocolId) == false) {
+                return false;
+            }
+
+            m_tx.sendVolume = ((double)(volume))/100.0f;
+            m_tx.nStreams = 1;
+            m_tx.hasData = true;
+        }
+    } else {
+        if (dataSize > 0) {
+            ggprintf("Tx is disabled - cannot transmit data with this GGWave instance\n");
+        }
+    }
+
+    // Rx
+    if (m_isRxEnabled) {
+        for (int i = 0; i < m_rx.nStreams; ++i) {
+            auto & stream = m_rx.streams[i];
+
+            stream.receiving = false;
+            stream.analyzing = false;
+
+            stream.framesToAnalyze = 0;
+            stream.framesLeftToAnalyze = 0;
+            stream.framesToRecord = 0;
+            stream.framesLeftToRecord = 0;
+
+            stream.dataLength = 0;
+            stream.data.zero();
+        }
+
+        m_rx.recordedId = 0;
+        m_rx.streamId = 0;
+
+        m_rx.spectrum.zero();
+        m_rx.amplitude.zero();
+        m_rx.amplitudeHistory.zero();
+
+        m_rx.data.zero();
+
+        m_rx.votesFixed.zero();
+
+        m_rx.historyIdFixed = 0;
+        m_rx.framesFixed    = 0;
+
+        m_rx.lockedProtocolId = GGWAVE_PROTOCOL_COUNT;
+        m_rx.lockFrames       = 0;
+        m_rx.framesToBoundary = 0;
+        m_rx.lockRun          = 0;
+
+        m_rx.gateFloor = 0.0f;
+        m_rx.gateHold  = 0;
+    }
+
+    return true;
+}
+
+bool GGWave::init(int nPayloads, const int * dataSizes, const char * const * dataBuffers, const TxProtocolId * protocolIds, const int volume) {
+    if (m_isTxEnabled == false) {
+        ggprintf("Tx is disabled - cannot transmit data with this GGWave instance\n");
+        return false;
+    }
+
+    if (nPayloads > 1 && m_isTxMultiStream == false) {
+        ggprintf("Multi-stream Tx is disabled - enable it with GGWAVE_OPERATING_MODE_TX_MULTI_STREAM\n");
+        return false;
+    }
+
+    if (nPayloads < 1 || nPayloads > kMaxTxStreams) {
+        ggprintf("Invalid number of payloads: %d, max: %d\n", nPayloads, kMaxTxStreams);
+        return false;
+    }
+
+    if (volume < 0 || volume > 100) {
+        ggprintf("Invalid volume: %d\n", volume);
+        return false;
+    }
+
+    for (int i = 0; i < nPayloads; ++i) {
+        if (dataSizes[i] <= 0) {
+            ggprintf("Invalid data size for payload %d: %d\n", i, dataSizes[i]);
+            return false;
+        }
+
+        if (protocolIds[i] < 0 || protocolIds[i] >= m_tx.protocols.size()) {
+            ggprintf("Invalid protocol ID: %d\n", protocolIds[i]);
+            return false;
+        }
+    }
+
+    // the frequency bins used by the markers and the data tones of each protocol must not overlap
+    for (int i = 0; i < nPayloads; ++i) {
+        for (int j = i + 1; j < nPayloads; ++j) {
+            const auto & pi = m_tx.protocols[protocolIds[i]];
+            const auto & pj = m_tx.protocols[protocolIds[j]];
+
+            const int wi = GG_MAX(m_nMarkerFrames > 0 ? 2*m_nBitsInMarker : 0, pi.nDataBins()/pi.extra);
+            const int wj = GG_MAX(m_nMarkerFrames > 0 ? 2*m_nBitsInMarker : 0, pj.nDataBins()/pj.extra);
+
+            if (pi.freqStart < pj.freqStart + wj && pj.freqStart < pi.freqStart + wi) {
+                ggprintf("Protocols %d and %d use overlapping frequency bands\n", protocolIds[i], protocolIds[j]);
+                return false;
+            }
+        }
+    }
+
+    m_tx.hasData = false;
+    m_tx.nStreams = 0;
+
+    for (int i = 0; i < nPayloads; ++i) {
+        auto & stream = m_tx.streams[i];
+
+        stream.data.zero();
+        stream.dataEncoded.zero();
+
+        if (init_stream(stream, dataSizes[i], dataBuffers[i], protocolIds[i]) == false) {
+            return false;
+        }
+    }
+
+    m_tx.sendVolume = ((double)(volume))/100.0f;
+    m_tx.nStreams = nPayloads;
+    m_tx.hasData = true;
+
+    return true;
+}
+
+bool GGWave::init_stream(TxStream & stream, int dataSize, const char * dataBuffer, TxProtocolId protocolId) {
+    const auto maxLength = m_isFixedPayloadLength ? m_payloadLength : (m_isLongPayload ? kMaxLengthLong : kMaxLengthVariable);
+
+    if (dataSize > maxLength) {
+        ggprintf("Truncating data from %d to %d bytes\n", dataSize, maxLength);
+        dataSize = maxLength;
+    }
+
+    if (protocolId < 0 || protocolId >= m_tx.protocols.size()) {
+        ggprintf("Invalid protocol ID: %d\n", protocolId);
+        return false;
+    }
+
+    const auto & protocol = m_tx.protocols[protocolId];
+
+    if (protocol.enabled == false) {
+        ggprintf("Protocol %d is not enabled - make sure to enable it before creating the instance\n", protocolId);
+        return false;
+    }
+
+    if (protocol.ofdm && (m_isFixedPayloadLength || m_txOnlyTones)) {
+        ggprintf("OFDM protocols require variable payload length and cannot be used with GGWAVE_OPERATING_MODE_TX_ONLY_TONES\n");
+        return false;
+    }
+
+    if (m_isTxIFFT && 2*(protocol.freqStart + GG_MAX(2*m_nBitsInMarker, protocol.nDataBins())) > m_samplesPerFrame) {
+        ggprintf("Protocol %d does not fit below the Nyquist frequency - cannot use IFFT synthesis\n", protocolId);
+        return false;
+    }
+
+    stream.protocol   = protocol;
+    stream.dataLength = m_isFixedPayloadLength ? m_payloadLength : dataSize;
+
+    stream.envelopeMarker = ::getEnvelope(m_nMarkerFrames,      m_samplesPerFrame);
+    stream.envelopeData   = ::getEnvelope(protocol.framesPerTx, m_samplesPerFrame);
+
+    if (stream.dataLength > kMaxLengthVariable) {
+        const int nBlocks = getLongBlocks(stream.dataLength);
+
+        stream.data[0] = kMaxLengthVariable + nBlocks;
+        for (int i = 0; i < nBlocks; ++i) {
+            uint8_t * block = stream.data.data() + 1 + i*kLongBlockSize;
+
+            block[0] = i;
+            block[1] = GG_MIN(kLongBlockLength, stream.dataLength - i*kLongBlockLength);
+
+            for (int j = 0; j < block[1]; ++j) {
+                const int k = i*kLongBlockLength + j;
+                block[kLongBlockHeader + j] = dataBuffer[k];
+                if (m_isDSSEnabled) {
+                    block[kLongBlockHeader + j] ^= getDSSMagic(k);
+                }
+            }
+        }
+    } else {
+        stream.data[0] = stream.dataLength;
+        for (int i = 0; i < stream.dataLength; ++i) {
+            stream.data[i + 1] = i < dataSize ? dataBuffer[i] : 0;
+            if (m_isDSSEnabled) {
+                stream.data[i + 1] ^= getDSSMagic(i);
+            }
+        }
+    }
+
+    if (encodeSize_frames(stream) > maxRecordedFrames()) {
+        ggprintf("Payload of %d bytes is too long for protocol '%s' - max duration is %d frames\n",
+                 stream.dataLength, protocol.name, maxRecordedFrames());
+        return false;
+    }
+
+    return true;
+}
+
+uint32_t GGWave::encodeSize_bytes() const {
+    return encodeSize_samples()*m_sampleSizeOut;
+}
+
+uint32_t GGWave::encodeSize_samples() const {
+    if (m_tx.hasData == false) {
+        return 0;
+    }
+
+    float factor = 1.0f;
+    int samplesPerFrameOut = m_samplesPerFrame;
+    if (m_needResampling) {
+        factor = m_sampleRate/m_sampleRateOut;
+        // note : +1 extra sample in order to overestimate the buffer size
+        samplesPerFrameOut = m_resampler.resample(factor, m_samplesPerFrame, m_tx.output.data(), nullptr) + 1;
+    }
+
+    int totalFrames = 0;
+    for (int is = 0; is < m_tx.nStreams; ++is) {
+        totalFrames = GG_MAX(totalFrames, encodeSize_frames(m_tx.streams[is]));
+    }
+
+    return totalFrames*samplesPerFrameOut;
+}
+
+int GGWave::encodeSize_frames(const TxStream & stream) const {
+    const int totalBytes = m_encodedDataOffset + getEncodedLength(stream.dataLength);
+    const int totalDataFrames = stream.protocol.extra*((totalBytes + stream.protocol.bytesPerTx - 1)/stream.protocol.bytesPerTx)*stream.protocol.framesPerTx;
+
+    return m_nMarkerFrames + totalDataFrames + m_nMarkerFramesEnd;
+}
+
+uint32_t GGWave::encode() {
+    if (m_isTxEnabled == false) {
+        ggprintf("Tx is disabled - cannot transmit data with this GGWave instance\n");
+        return 0;
+    }
+
+    if (m_needResampling) {
+        m_resampler.reset();
+    }
+
+    for (int is = 0; is < m_tx.nStreams; ++is) {
+        auto & stream = m_tx.streams[is];
+
+        const int nECCBytesPerTx = getECCBytesForLength(stream.dataLength);
+
+        if (m_isFixedPayloadLength == false) {
+            RS::ReedSolomon rsLength(1, m_encodedDataOffset - 1, m_workRSLength.data());
+            rsLength.Encode(stream.data.data(), stream.dataEncoded.data());
+        }
+
+        if (stream.dataLength > kMaxLengthVariable) {
+            RS::ReedSolomon rsBlock(kLongBlockSize, getECCBytesForLength(kLongBlockSize), m_workRSData.data());
+
+            for (int i = 0; i < getLongBlocks(stream.dataLength); ++i) {
+                rsBlock.Encode(stream.data.data() + 1 + i*kLongBlockSize, stream.dataEncoded.data() + m_encodedDataOffset + i*kLongBlockEncoded);
+            }
+
+            continue;
+        }
+
+        // first byte of stream.data contains the length of the payload, so we skip it:
+        RS::ReedSolomon rsData = RS::ReedSolomon(stream.dataLength, nECCBytesPerTx, m_workRSData.data());
+        rsData.Encode(stream.data.data() + 1, stream.dataEncoded.data() + m_encodedDataOffset);
+    }
+
+    // generate tones
+    {
+        const auto & stream = m_tx.streams[0];
+        const int totalDataFrames = encodeSize_frames(stream) - m_nMarkerFrames - m_nMarkerFramesEnd;
+
+        int frameId = 0;
+        bool hasData = m_tx.hasData;
+
+        const auto pushTone = [&](int k) {
+            if (m_tx.isWideTones) {
+                m_tx.tonesWide[m_tx.nTones++] = k;
+            } else {
+                m_tx.tones[m_tx.nTones++] = k;
+            }
+        };
+
+        m_tx.nTones = 0;
+        while (hasData) {
+            if (frameId < m_nMarkerFrames) {
+                // the short preamble has no individual tones
+                for (int i = 0; i < m_nBitsInMarker && m_isShortPreamble == false; ++i) {
+                    pushTone(2*i + i%2);
+                }
+            } else if (frameId < m_nMarkerFrames + totalDataFrames) {
+                const int txId = (frameId - m_nMarkerFrames)/stream.protocol.framesPerTx;
+
+                // the OFDM blocks have no individual tones
+                if (stream.protocol.ofdm == false) {
+                    ::setDataBits(stream.protocol, stream.dataEncoded.data(), txId, m_tx.dataBits);
+
+                    for (int k = 0; k < stream.protocol.nDataBins(); ++k) {
+                        if (m_tx.dataBits[k] == 0) continue;
+
+                        pushTone(k);
+                    }
+                }
+            } else if (frameId < m_nMarkerFrames + totalDataFrames + m_nMarkerFramesEnd) {
+                for (int i = 0; i < m_nBitsInMarker; ++i) {
+                    pushTone(2*i + (1 - i%2));
+                }
+            } else {
+                hasData = false;
+                break;
+            }
+
+            if (stream.protocol.nTones() > 1) {
+                pushTone(-1);
+            }
+
+            frameId += stream.protocol.framesPerTx;
+        }
+
+        if (m_txOnlyTones) {
+            m_tx.hasData = false;
+            return true;
+        }
+    }
+
+    // compute Tx data
+    for (int is = 0; is < m_tx.nStreams; ++is) {
+        auto & stream = m_tx.streams[is];
+
+        for (int k = 0; k < (int) stream.phaseOffsets.size(); ++k) {
+            stream.phaseOffsets[k] = (M_PI*k)/(stream.protocol.nDataBitsPerTx());
+        }
+
+        // note : what is the purpose of this shuffle ? I forgot .. :(
+        //std::random_device rd;
+        //std::mt19937 g(rd());
+
+        //std::shuffle(phaseOffsets.begin(), phaseOffsets.end(), g);
+
+        // the IFFT and NCO synthesis compute the tones for each frame
+        if (m_isTxIFFT || m_isTxNCO) {
+            continue;
+        }
+
+#ifdef GGWAVE_CONFIG_FIXED_POINT
+        // a phase accumulator per tone, with a full period of 2^32
+        constexpr double kPeriod = 4294967296.0;
+        constexpr float  kScale  = 1.0f/32767;
+
+        for (int k = 0; k < (int) m_tx.dataBits.size(); ++k) {
+            const int bin1 = round(bitFreq(stream.protocol, k)*m_ihzPerSample);
+            const int bin0 = bin1 + m_freqDelta_bin;
+
+            const uint32_t phaseOffset = uint32_t(fmod(stream.phaseOffsets[k]/(2.0*M_PI), 1.0)*kPeriod);
+            const uint32_t step1 = uint32_t((uint64_t(bin1) << 32)/m_samplesPerFrame);
+            const uint32_t step0 = uint32_t((uint64_t(bin0) << 32)/m_samplesPerFrame);
+
+            uint32_t phase = phaseOffset;
+            for (int i = 0; i < m_samplesPerFrame; i++) {
+                stream.bit1Amplitude[k][i] = kScale*::sinQ15(phase);
+                phase += step1;
+            }
+
+            phase = phaseOffset;
+            for (int i = 0; i < m_samplesPerFrame; i++) {
+                stream.bit0Amplitude[k][i] = kScale*::sinQ15(phase);
+                phase += step0;
+            }
+        }
+#else
+        for (int k = 0; k < (int) m_tx.dataBits.size(); ++k) {
+            const double freq = bitFreq(stream.protocol, k);
+
+            const double phaseOffset = stream.phaseOffsets[k];
+            const double curHzPerSample = m_hzPerSample;
+            const double curIHzPerSample = 1.0/curHzPerSample;
+
+            for (int i = 0; i < m_samplesPerFrame; i++) {
+                const double curi = i;
+                stream.bit1Amplitude[k][i] = sin((2.0*M_PI)*(curi*m_isamplesPerFrame)*(freq*curIHzPerSample) + phaseOffset);
+            }
+
+            for (int i = 0; i < m_samplesPerFrame; i++) {
+                const double curi = i;
+                stream.bit0Amplitude[k][i] = sin((2.0*M_PI)*(curi*m_isamplesPerFrame)*((freq + m_hzPerSample*m_freqDelta_bin)*curIHzPerSample) + phaseOffset);
+            }
+        }
+#endif
+    }
+
+    int totalFrames = 0;
+    for (int is = 0; is < m_tx.nStreams; ++is) {
+        totalFrames = GG_MAX(totalFrames, encodeSize_frames(m_tx.streams[is]));
+    }
+
+    int frameId = 0;
+    uint32_t offset = 0;
+    const float factor = m_sampleRate/m_sampleRateOut;
+
+    while (m_tx.hasData) {
+        if (frameId >= totalFrames) {
+            m_tx.hasData = false;
+            break;
+        }
+
+        m_tx.output.zero();
+
+        // the tones of all streams are normalized together
+        float norm = 0.0f;
+        for (int is = 0; is < m_tx.nStreams; ++is) {
+            norm += encode_frame(m_tx.streams[is], frameId);
+        }
+
+        if (norm == 0.0f) norm = 1.0f;
+        const float scale = 1.0f/norm;
+        for (int i = 0; i < m_samplesPerFrame; ++i) {
+            m_tx.output[i] *= scale;
+        }
+
+        int samplesPerFrameOut = m_samplesPerFrame;
+        if (m_needResampling) {
+            samplesPerFrameOut = m_resampler.resample(factor, m_samplesPerFrame, m_tx.output.data(), m_tx.outputResampled.data());
+        } else {
+            m_tx.outputResampled.copy(m_tx.output);
+        }
+
+        // default output is in 16-bit signed int so we always compute it
+        for (int i = 0; i < samplesPerFrameOut; ++i) {
+            m_tx.outputI16[offset + i] = 32768*m_tx.outputResampled[i];
+        }
+
+        // convert from 32-bit float
+        switch (m_sampleFormatOut) {
+            case GGWAVE_SAMPLE_FORMAT_UNDEFINED: break;
+            case GGWAVE_SAMPLE_FORMAT_U8:
+                {
+                    auto p = reinterpret_cast<uint8_t *>(m_tx.outputTmp.data());
+                    for (int i = 0; i < samplesPerFrameOut; ++i) {
+                        p[offset + i] = 128*(m_tx.outputResampled[i] + 1.0f);
+                    }
+                } break;
+            case GGWAVE_SAMPLE_FORMAT_I8:
+                {
+                    auto p = reinterpret_cast<uint8_t *>(m_tx.outputTmp.data());
+                    for (int i = 0; i < samplesPerFrameOut; ++i) {
+                        p[offset + i] = 128*m_tx.outputResampled[i];
+                    }
+                } break;
+            case GGWAVE_SAMPLE_FORMAT_U16:
+                {
+                    auto p = reinterpret_cast<uint16_t *>(m_tx.outputTmp.data());
+                    for (int i = 0; i < samplesPerFrameOut; ++i) {
+                        p[offset + i] = 32768*(m_tx.outputResampled[i] + 1.0f);
+                    }
+                } break;
+            case GGWAVE_SAMPLE_FORMAT_I16:
+                {
+                    // skip because we already have the data in m_tx.outputI16
+                    //auto p = reinterpret_cast<uint16_t *>(m_tx.outputTmp.data());
+                    //for (int i = 0; i < samplesPerFrameOut; ++i) {
+                    //    p[offset + i] = 32768*m_tx.outputResampled[i];
+                    //}
+                } break;
+            case GGWAVE_SAMPLE_FORMAT_F32:
+                {
+                    auto p = reinterpret_cast<float *>(m_tx.outputTmp.data());
+                    for (int i = 0; i < samplesPerFrameOut; ++i) {
+                        p[offset + i] = m_tx.outputResampled[i];
+                    }
+                } break;
+        }
+
+        ++frameId;
+        offset += samplesPerFrameOut;
+    }
+
+    m_tx.lastAmplitudeSize = offset;
+
+    // the encoded waveform can be accessed via the txWaveform() method
+    // we return the size of the waveform in bytes:
+    return offset*m_sampleSizeOut;
+}
+
+float GGWave::encode_frame(TxStream & stream, int frameId) {
+    const int totalDataFrames = encodeSize_frames(stream) - m_nMarkerFrames - m_nMarkerFramesEnd;
+
+    // the short preamble is the chirp followed by its negation
+    if (frameId < m_nMarkerFrames && m_isShortPreamble) {
+        ::preambleChirp(stream.protocol.freqStart, 2*m_nBitsInMarker, m_tx.synth.data(), m_samplesPerFrame);
+
+        float peak = 0.0f;
+        for (int i = 0; i < m_samplesPerFrame; ++i) {
+            peak = GG_MAX(peak, fabsf(m_tx.synth[i]));
+        }
+
+        const float sign = frameId == 0 ? 1.0f : -1.0f;
+        ::addAmplitudeSmooth(m_tx.synth, m_tx.output, sign*m_tx.sendVolume, stream.envelopeMarker, frameId, m_samplesPerFrame);
+
+        return peak;
+    }
+
+    // with IFFT synthesis, the tones are placed in the spectrum of the frame and the
+    // envelope is applied once to their sum
+    // with NCO synthesis, the tones are generated by oscillators and the envelope is applied
+    // in the same way
+    if (m_isTxIFFT || m_isTxNCO) {
+        m_tx.synth.zero();
+    }
+
+    int nFreq = 0;
+    int cycleMod = 0;
+    const TxEnvelope * envelope = nullptr;
+    int nOscillators = 0;
+
+    // in low-crest mode, the tones of the frame get Newman phases in the order of increasing frequency
+    int nTones = 0;
+    int iTone = 0;
+    const auto tonePhase = [&](int k) {
+        if (m_isTxLowCrest) {
+            const int j = iTone++;
+            return (M_PI*j*j)/nTones;
+        }
+
+        return stream.phaseOffsets[k/2];
+    };
+
+    // tone k is on bin (freqStart + k), with the phase of the sine tables
+    const auto addTone = [&](int k) {
+        if (m_isTxIFFT) {
+            const int bin = stream.protocol.freqStart + k;
+            const double phase = tonePhase(k);
+
+            m_tx.synth[2*bin + 0] += sin(phase);
+            m_tx.synth[2*bin + 1] += cos(phase);
+        } else if (m_isTxNCO) {
+            // each frame has a whole number of periods, so starting every frame from the initial
+            // phase keeps the tone continuous and prevents the rounding errors from accumulating
+            const double omega = (2.0*M_PI*(stream.protocol.freqStart + k))/m_samplesPerFrame;
+            const double phase = tonePhase(k);
+
+            m_tx.ncoRe[nOscillators] = cos(phase);
+            m_tx.ncoIm[nOscillators] = sin(phase);
+            m_tx.ncoCr[nOscillators] = cos(omega);
+            m_tx.ncoCi[nOscillators] = sin(omega);
+            ++nOscillators;
+        } else {
+            auto & table = k%2 ? stream.bit0Amplitude : stream.bit1Amplitude;
+            ::addAmplitudeSmooth(table[k/2], m_tx.output, m_tx.sendVolume, *envelope, cycleMod, m_samplesPerFrame);
+        }
+    };
+
+    if (frameId < m_nMarkerFrames) {
+        nFreq = m_nBitsInMarker;
+        cycleMod = frameId;
+        envelope = &stream.envelopeMarker;
+        nTones = m_nBitsInMarker;
+
+        for (int i = 0; i < m_nBitsInMarker; ++i) {
+            addTone(2*i + i%2);
+        }
+    } else if (frameId < m_nMarkerFrames + totalDataFrames) {
+        const int dataFrame = frameId - m_nMarkerFrames;
+
+        if (stream.protocol.ofdm) {
+            return encode_frameOFDM(stream, dataFrame);
+        }
+
+        cycleMod = dataFrame%stream.protocol.framesPerTx;
+        envelope = &stream.envelopeData;
+        nTones = stream.protocol.nTones();
+
+        ::setDataBits(stream.protocol, stream.dataEncoded.data(), dataFrame/stream.protocol.framesPerTx, m_tx.dataBits);
+
+        for (int k = 0; k < stream.protocol.nDataBins(); ++k) {
+            if (m_tx.dataBits[k] == 0) continue;
+
+            ++nFreq;
+            addTone(k);
+        }
+    } else if (frameId < m_nMarkerFrames + totalDataFrames + m_nMarkerFramesEnd) {
+        nFreq = m_nBitsInMarker;
+        cycleMod = frameId - (m_nMarkerFrames + totalDataFrames);
+        envelope = &stream.envelopeMarker;
+        nTones = m_nBitsInMarker;
+
+        for (int i = 0; i < m_nBitsInMarker; ++i) {
+            addTone(2*i + 1 - i%2);
+        }
+    }
+
+    if (m_isTxIFFT && nFreq > 0) {
+        rdft(m_samplesPerFrame, -1, m_tx.synth.data(), m_tx.synthWorkI.data(), m_tx.synthWorkF.data());
+    }
+
+    if (m_isTxNCO && nOscillators > 0) {
+        while (nOscillators%4 != 0) {
+            m_tx.ncoRe[nOscillators] = 0.0f;
+            m_tx.ncoIm[nOscillators] = 0.0f;
+            m_tx.ncoCr[nOscillators] = 1.0f;
+            m_tx.ncoCi[nOscillators] = 0.0f;
+            ++nOscillators;
+        }
+
+        ::synthNCO(m_tx.ncoRe.data(), m_tx.ncoIm.data(), m_tx.ncoCr.data(), m_tx.ncoCi.data(), nOscillators, m_tx.synth.data(), m_samplesPerFrame);
+    }
+
+    // the frame is normalized by its actual peak instead of the worst case of nFreq tones in phase
+    // the tones of a symbol are the same in all of its frames, so the envelope is not affected
+    float norm = nFreq;
+    if (m_isTxLowCrest && nFreq > 0) {
+        norm = 0.0f;
+        for (int i = 0; i < m_samplesPerFrame; ++i) {
+            norm = GG_MAX(norm, fabsf(m_tx.synth[i]));
+        }
+    }
+
+    if ((m_isTxIFFT || m_isTxNCO) && nFreq > 0) {
+        ::addAmplitudeSmooth(m_tx.synth, m_tx.output, m_tx.sendVolume, *envelope, cycleMod, m_samplesPerFrame);
+    }
+
+    return norm;
+}
+
+// The symbols of an OFDM block straddle the frame boundaries, so each frame is assembled from the
+// one or two symbols that overlap it. The block is normalized by its peak, found when its first
+// frame is synthesized, so that all of its symbols have the same gain.
+//
+// The first half of each cyclic prefix cross-fades from the continuation of the previous symbol,
+// which is also the last symbol of the previous block. The receiver skips it, and without it the
+// jumps between the symbols would leak to the whole spectrum.
+float GGWave::encode_frameOFDM(TxStream & stream, int dataFrame) {
+    const auto & protocol = stream.protocol;
+
+    const int n        = m_samplesPerFrame;
+    const int nSymbols = protocol.nOFDMSymbols();
+    const int nPrefix  = n/nSymbols;
+    const int nSymbol  = n + nPrefix;
+    const int nFade    = nPrefix/2;
+
+    const int txId  = dataFrame/protocol.framesPerTx;
+    const int frame = dataFrame%protocol.framesPerTx;
+
+    // the padding of the last block is not stored
+    const auto synthSymbol = [&](int tx, int s) {
+        const int offset = tx*protocol.bytesPerTx;
+        const int nBytes = GG_MIN((int) protocol.bytesPerTx, (int) stream.dataEncoded.size() - offset);
+
+        ::ofdmSpectrum(protocol, stream.dataEncoded.data() + offset, nBytes, s, m_tx.synth.data(), n);
+        rdft(n, -1, m_tx.synth.data(), m_tx.synthWorkI.data(), m_tx.synthWorkF.data());
+    };
+
+    if (frame == 0) {
+        stream.ofdmPeakPrev = txId > 0 ? stream.ofdmPeak : 0.0f;
+        stream.ofdmPeak = 0.0f;
+        for (int s = 0; s < nSymbols; ++s) {
+            synthSymbol(txId, s);
+            for (int i = 0; i < n; ++i) {
+                stream.ofdmPeak = GG_MAX(stream.ofdmPeak, fabsf(m_tx.synth[i]));
+            }
+        }
+    }
+
+    m_tx.ofdmFrame.zero();
+
+    // sample k of the block is sample k - frame*n of the frame
+    const int k0 = frame*n;
+    for (int s = k0/nSymbol; s <= (k0 + n - 1)/nSymbol; ++s) {
+        const int k1 = GG_MAX(k0, s*nSymbol);
+        const int k2 = GG_MIN(k0 + n, (s + 1)*nSymbol);
+
+        const auto fade = [&](int j) { return j < nFade ? 0.5f - 0.5f*cos((M_PI*(j + 0.5))/nFade) : 1.0f; };
+
+        synthSymbol(txId, s);
+
+        // the cyclic prefix repeats the end of the symbol
+        for (int k = k1; k < k2; ++k) {
+            const int j = k - s*nSymbol;
+            m_tx.ofdmFrame[k - k0] = fade(j)*m_tx.synth[(j - nPrefix + n) % n];
+        }
+
+        const int kf = GG_MIN(k2, s*nSymbol + nFade);
+        if (k1 >= kf || (s == 0 && txId == 0)) {
+            continue;
+        }
+
+        // the previous block is brought to the gain of this one
+        const float scale = s > 0 ? 1.0f : stream.ofdmPeak/stream.ofdmPeakPrev;
+
+        synthSymbol(s > 0 ? txId : txId - 1, s > 0 ? s - 1 : nSymbols - 1);
+
+        for (int k = k1; k < kf; ++k) {
+            const int j = k - s*nSymbol;
+            m_tx.ofdmFrame[k - k0] += (1.0f - fade(j))*scale*m_tx.synth[j];
+        }
+    }
+
+    for (int i = 0; i < n; ++i) {
+        m_tx.output[i] += m_tx.sendVolume*m_tx.ofdmFrame[i];
+    }
+
+    return stream.ofdmPeak;
+}
+
+bool GGWave::decode(const void * data, uint32_t nBytes) {
+    return decode(data, nBytes, nullptr, 0);
+}
+
+bool GGWave::decode(const void * data, uint32_t nBytes, GGWave * const * backends, int nBackends) {
+    if (m_isRxEnabled == false) {
+        ggprintf("Rx is disabled - cannot receive data with this GGWave instance\n");
+        return false;
+    }
+
+    if (m_tx.hasData) {
+        ggprintf("Cannot decode while transmitting\n");
+        return false;
+    }
+
+    if (nBackends < 0 || (nBackends > 0 && backends == nullptr)) {
+        ggprintf("Invalid decoder back-ends\n");
+        return false;
+    }
+
+    for (int ib = 0; ib < nBackends; ++ib) {
+        const GGWave * backend = backends[ib];
+        if (backend == nullptr || backend == this) {
+            ggprintf("Invalid decoder back-end %d\n", ib);
+            return false;
+        }
+
+        if (backend->m_isRxEnabled == false) {
+            ggprintf("Rx is disabled for decoder back-end %d\n", ib);
+            return false;
+        }
+
+        if (backend->m_tx.hasData) {
+            ggprintf("Decoder back-end %d is transmitting\n", ib);
+            return false;
+        }
+
+        if (backend->m_samplesPerFrame != m_samplesPerFrame || backend->m_sampleRate != m_sampleRate) {
+            ggprintf("Decoder back-end %d does not match the front-end: samplesPerFrame %d vs %d, sampleRate %g vs %g\n",
+                    ib, backend->m_samplesPerFrame, m_samplesPerFrame, backend->m_sampleRate, m_sampleRate);
+            return false;
+        }
+    }
+
+    const bool isPerChannel = m_channelsInp > 1 && m_channelMode == GGWAVE_CHANNEL_MODE_PER_CHANNEL;
+    if (isPerChannel && nBackends != m_channelsInp) {
+        ggprintf("Channel mode %d requires one decoder back-end per channel: %d back-ends, %d channels\n",
+                (int) m_channelMode, nBackends, m_channelsInp);
+        return false;
+    }
+
+    auto dataBuffer = (uint8_t *) data;
+    const float factor = m_sampleRateInp/m_sampleRate;
+    const int sampleSizeInp = m_sampleSizeInp*m_channelsInp; // size of a sample in all channels
+
+    while (true) {
+        // read capture data
+        uint32_t nBytesNeeded = m_rx.samplesNeeded*sampleSizeInp;
+
+        if (m_needResampling) {
+            // note : predict 4 extra samples just to make sure we have enough data
+            nBytesNeeded = (m_resampler.resample(1.0f/factor, m_rx.samplesNeeded, m_rx.amplitudeResampled.data(), nullptr) + 4)*sampleSizeInp;
+        }
+
+        const uint32_t nBytesRecorded = GG_MIN(nBytes, nBytesNeeded);
+
+        if (nBytesRecorded == 0) {
+            break;
+        }
+
+        switch (m_sampleFormatInp) {
+            case GGWAVE_SAMPLE_FORMAT_UNDEFINED: break;
+            case GGWAVE_SAMPLE_FORMAT_U8:
+            case GGWAVE_SAMPLE_FORMAT_I8:
+            case GGWAVE_SAMPLE_FORMAT_U16:
+            case GGWAVE_SAMPLE_FORMAT_I16:
+                {
+                    memcpy(m_rx.amplitudeTmp.data(), dataBuffer, nBytesRecorded);
+                } break;
+            case GGWAVE_SAMPLE_FORMAT_F32:
+                {
+                    if (m_channelsInp > 1) {
+                        memcpy(m_rx.amplitudeTmp.data(), dataBuffer, nBytesRecorded);
+                    } else {
+                        memcpy(m_rx.amplitudeResampled.data(), dataBuffer, nBytesRecorded);
+                    }
+                } break;
+        }
+
+        dataBuffer += nBytesRecorded;
+        nBytes -= nBytesRecorded;
+
+        if (nBytesRecorded % sampleSizeInp != 0) {
+            ggprintf("Failure during capture - provided bytes (%d) are not multiple of sample size (%d)\n",
+                    nBytesRecorded, sampleSizeInp);
+            m_rx.samplesNeeded = m_samplesPerFrame;
+            break;
+        }
+
+        // convert to 32-bit float
+        int nSamplesRecorded = nBytesRecorded/sampleSizeInp;
+        if (m_channelsInp > 1) {
+            // the downmix goes through the regular processing below, while the separate channels
+            // are stored directly in the current frame (there is no resampling in this case)
+            const int offset = m_samplesPerFrame - m_rx.samplesNeeded;
+            auto dstChannels = m_channelMode == GGWAVE_CHANNEL_MODE_DOWNMIX ? nullptr : &m_rx.amplitudeChannels;
+            auto src = m_rx.amplitudeTmp.data();
+            auto dst = m_rx.amplitudeResampled.data();
+            switch (m_sampleFormatInp) {
+                case GGWAVE_SAMPLE_FORMAT_UNDEFINED: break;
+                case GGWAVE_SAMPLE_FORMAT_U8:  convertChannels(reinterpret_cast<uint8_t *>(src),  nSamplesRecorded, m_channelsInp, 128.0f,   1.0f/128,   dst, dstChannels, offset); break;
+                case GGWAVE_SAMPLE_FORMAT_I8:  convertChannels(reinterpret_cast<int8_t *>(src),   nSamplesRecorded, m_channelsInp, 0.0f,     1.0f/128,   dst, dstChannels, offset); break;
+                case GGWAVE_SAMPLE_FORMAT_U16: convertChannels(reinterpret_cast<uint16_t *>(src), nSamplesRecorded, m_channelsInp, 32768.0f, 1.0f/32768, dst, dstChannels, offset); break;
+                case GGWAVE_SAMPLE_FORMAT_I16: convertChannels(reinterpret_cast<int16_t *>(src),  nSamplesRecorded, m_channelsInp, 0.0f,     1.0f/32768, dst, dstChannels, offset); break;
+                case GGWAVE_SAMPLE_FORMAT_F32: convertChannels(reinterpret_cast<float *>(src),    nSamplesRecorded, m_channelsInp, 0.0f,     1.0f,       dst, dstChannels, offset); break;
+            }
+        } else {
+            switch (m_sampleFormatInp) {
+                case GGWAVE_SAMPLE_FORMAT_UNDEFINED: break;
+                case GGWAVE_SAMPLE_FORMAT_U8:
+                    {
+                        constexpr float scale = 1.0f/128;
+                        auto p = reinterpret_cast<uint8_t *>(m_rx.amplitudeTmp.data());
+                        for (int i = 0; i < nSamplesRecorded; ++i) {
+                            m_rx.amplitudeResampled[i] = float(int16_t(*(p + i)) - 128)*scale;
+                        }
+                    } break;
+                case GGWAVE_SAMPLE_FORMAT_I8:
+                    {
+                        constexpr float scale = 1.0f/128;
+                        auto p = reinterpret_cast<int8_t *>(m_rx.amplitudeTmp.data());
+                        for (int i = 0; i < nSamplesRecorded; ++i) {
+                            m_rx.amplitudeResampled[i] = float(*(p + i))*scale;
+                        }
+                    } break;
+                case GGWAVE_SAMPLE_FORMAT_U16:
+                    {
+                        constexpr float scale = 1.0f/32768;
+                        auto p = reinterpret_cast<uint16_t *>(m_rx.amplitudeTmp.data());
+                        for (int i = 0; i < nSamplesRecorded; ++i) {
+                            m_rx.amplitudeResampled[i] = float(int32_t(*(p + i)) - 32768)*scale;
+                        }
+                    } break;
+                case GGWAVE_SAMPLE_FORMAT_I16:
+                    {
+                        constexpr float scale = 1.0f/32768;
+                        auto p = reinterpret_cast<int16_t *>(m_rx.amplitudeTmp.data());
+                        for (int i = 0; i < nSamplesRecorded; ++i) {
+                            m_rx.amplitudeResampled[i] = float(*(p + i))*scale;
+                        }
+                    } break;
+                case GGWAVE_SAMPLE_FORMAT_F32: break;
+            }
+        }
+
+        uint32_t offset = m_samplesPerFrame - m_rx.samplesNeeded;
+
+        bool isReceiving = rxReceiving();
+        for (int ib = 0; ib < nBackends; ++ib) {
+            isReceiving = isReceiving || backends[ib]->rxReceiving();
+        }
+
+        if (m_needResampling) {
+            if (nSamplesRecorded <= 2*Resampler::kWidth) {
+                m_rx.samplesNeeded = m_samplesPerFrame;
+                break;
+            }
+
+            // reset resampler state every minute
+            if (!isReceiving && m_resampler.nSamplesTotal() > 60.0f*factor*m_sampleRate) {
+                m_resampler.reset();
+            }
+
+            int nSamplesResampled = offset + m_resampler.resample(factor, nSamplesRecorded, m_rx.amplitudeResampled.data(), m_rx.amplitude.data() + offset);
+            nSamplesRecorded = nSamplesResampled;
+        } else {
+            for (int i = 0; i < nSamplesRecorded; ++i) {
+                m_rx.amplitude[offset + i] = m_rx.amplitudeResampled[i];
+            }
+            nSamplesRecorded += offset;
+        }
+
+        // we have enough bytes to do analysis
+        if (nSamplesRecorded >= m_samplesPerFrame) {
+            m_rx.hasNewAmplitude = true;
+
+            bool isActive = true;
+            if (m_isRxEnergyGate) {
+                bool isBusy = isReceiving || rxLocked();
+                for (int ib = 0; ib < nBackends; ++ib) {
+                    isBusy = isBusy || backends[ib]->rxLocked();
+                }
+
+                isActive = decode_gate(isBusy);
+            }
+
+            if (isActive && m_channelsInp > 1) {
+                decode_channels(isReceiving);
+            }
+
+            if (isActive == false) {
+                decode_idle(backends, nBackends);
+            } else if (nBackends > 0) {
+                decode_shared(backends, nBackends);
+            } else if (m_isFixedPayloadLength) {
+                decode_fixed(nullptr);
+            } else {
+                decode_variable(nullptr);
+            }
+
+            int nExtraSamples = nSamplesRecorded - m_samplesPerFrame;
+            for (int i = 0; i < nExtraSamples; ++i) {
+                m_rx.amplitude[i] = m_rx.amplitude[m_samplesPerFrame + i];
+            }
+
+            m_rx.samplesNeeded = m_samplesPerFrame - nExtraSamples;
+        } else {
+            m_rx.samplesNeeded = m_samplesPerFrame - nSamplesRecorded;
+            break;
+        }
+    }
+
+    return true;
+}
+
+//
+// instance state
+//
+
+bool GGWave::isDSSEnabled() const { return m_isDSSEnabled; }
+
+int GGWave::samplesPerFrame() const { return m_samplesPerFrame; }
+int GGWave::sampleSizeInp()   const { return m_sampleSizeInp; }
+int GGWave::sampleSizeOut()   const { return m_sampleSizeOut; }
+
+float GGWave::hzPerSample()   const { return m_hzPerSample; }
+float GGWave::sampleRateInp() const { return m_sampleRateInp; }
+float GGWave::sampleRateOut() const { return m_sampleRateOut; }
+GGWave::SampleFormat GGWave::sampleFormatInp() const { return m_sampleFormatInp; }
+GGWave::SampleFormat GGWave::sampleFormatOut() const { return m_sampleFormatOut; }
+
+int GGWave::channelsInp() const { return m_channelsInp; }
+GGWave::ChannelMode GGWave::channelMode() const { return m_channelMode; }
+
+int GGWave::heapSize() const { return m_heapSize; }
+
+//
+// Tx
+//
+
+const void * GGWave::txWaveform() const {
+    switch (m_sampleFormatOut) {
+        case GGWAVE_SAMPLE_FORMAT_UNDEFINED: break;
+        case GGWAVE_SAMPLE_FORMAT_I16:
+            {
+                return m_tx.outputI16.data();
+            } break;
+        case GGWAVE_SAMPLE_FORMAT_U8:
+        case GGWAVE_SAMPLE_FORMAT_I8:
+        case GGWAVE_SAMPLE_FORMAT_U16:
+        case GGWAVE_SAMPLE_FORMAT_F32:
+            {
+                return m_tx.outputTmp.data();
+            } break;
+    }
+
+    return nullptr;
+}
+
+const GGWave::Tones GGWave::txTones() const { return { m_tx.tones.data(), m_tx.isWideTones ? 0 : m_tx.nTones }; }
+const GGWave::TonesWide GGWave::txTonesWide() const { return { m_tx.tonesWide.data(), m_tx.isWideTones ? m_tx.nTones : 0 }; }
+
+float GGWave::txPAPR() const {
+    // computed on request from the 16-bit output, so that encode() does not pay for it
+    const int n = m_tx.lastAmplitudeSize;
+
+    float peak   = 0.0f;
+    float energy = 0.0f;
+    for (int i = 0; i < n; i += m_samplesPerFrame) {
+        // the frames are summed separately to limit the rounding errors
+        float energyFrame = 0.0f;
+        for (int j = i; j < GG_MIN(i + m_samplesPerFrame, n); ++j) {
+            const float x = m_tx.outputI16[j];
+            peak = GG_MAX(peak, fabsf(x));
+            energyFrame += x*x;
+        }
+        energy += energyFrame;
+    }
+
+    return energy > 0.0f ? 10.0f*log10f(peak*peak*n/energy) : 0.0f;
+}
+
+bool GGWave::txHasData() const { return m_tx.hasData; }
+
+bool GGWave::txTakeAmplitudeI16(AmplitudeI16 & dst) {
+    if (m_tx.lastAmplitudeSize == 0) return false;
+
+    dst.assign({ m_tx.outputI16.data(), m_tx.lastAmplitudeSize });
+    m_tx.lastAmplitudeSize = 0;
+
+    return true;
+}
+
+const GGWave::RxProtocols & GGWave::txProtocols() const { return m_tx.protocols; }
+
+//
+// Rx
+//
+
+bool GGWave::rxReceiving() const {
+    for (int i = 0; i < m_rx.nStreams; ++i) {
+        if (m_rx.streams[i].receiving) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool GGWave::rxAnalyzing() const {
+    for (int i = 0; i < m_rx.nStreams; ++i) {
+        if (m_rx.streams[i].analyzing) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+int GGWave::rxChannel() const { return m_rx.channelId; }
+
+bool GGWave::rxLocked() const { return m_rx.lockedProtocolId != GGWAVE_PROTOCOL_COUNT; }
+
+bool GGWave::rxIdle() const { return m_isRxEnergyGate && m_rx.gateHold == 0; }
+
+int GGWave::rxSamplesNeeded()       const { return m_rx.samplesNeeded; }
+int GGWave::rxFramesToRecord()      const { return m_rx.streams[m_rx.streamId].framesToRecord; }
+int GGWave::rxFramesLeftToRecord()  const { return m_rx.streams[m_rx.streamId].framesLeftToRecord; }
+int GGWave::rxFramesToAnalyze()     const { return m_rx.streams[m_rx.streamId].framesToAnalyze; }
+int GGWave::rxFramesLeftToAnalyze() const { return m_rx.streams[m_rx.streamId].framesLeftToAnalyze; }
+int GGWave::rxDurationFrames()      const { return m_rx.streams[m_rx.streamId].recvDuration_frames; }
+
+bool GGWave::rxStopReceiving() {
+    bool res = false;
+
+    for (int i = 0; i < m_rx.nStreams; ++i) {
+        if (m_rx.streams[i].receiving) {
+            m_rx.streams[i].receiving = false;
+            res = true;
+        }
+    }
+
+    return res;
+}
+
+GGWave::RxProtocols & GGWave::rxProtocols() { return m_rx.protocols; }
+
+int GGWave::rxDataLength() const { return m_rx.dataLength; }
+
+const GGWave::TxRxData &      GGWave::rxData()       const { return m_rx.data; }
+const GGWave::RxProtocol &    GGWave::rxProtocol()   const { return m_rx.protocol; }
+const GGWave::RxProtocolId &  GGWave::rxProtocolId() const { return m_rx.protocolId; }
+const GGWave::Spectrum &      GGWave::rxSpectrum()   const { return m_rx.spectrum; }
+const GGWave::Amplitude &     GGWave::rxAmplitude()  const { return m_rx.amplitude; }
+
+int GGWave::rxTakeData(TxRxData & dst) {
+    if (m_rx.dataLength == 0 && m_isRxMultiStream) {
+        decode_variable_publish();
+    }
+
+    if (m_rx.dataLength == 0) return 0;
+
+    auto res = m_rx.dataLength;
+    m_rx.dataLength = 0;
+
+    if (res != -1) {
+        dst.assign({ m_rx.data.data(), res });
+    }
+
+    return res;
+}
+
+bool GGWave::rxTakeSpectrum(Spectrum & dst) {
+    if (m_rx.hasNewSpectrum == false) return false;
+
+    m_rx.hasNewSpectrum = false;
+    dst.assign(m_rx.spectrum);
+
+    return true;
+}
+
+bool GGWave::rxTakeAmplitude(Amplitude & dst) {
+    if (m_rx.hasNewAmplitude == false) return false;
+
+    m_rx.hasNewAmplitude = false;
+    dst.assign(m_rx.amplitude);
+
+    return true;
+}
+
+bool GGWave::computeFFTR(const float * src, float * dst, int N) {
+    if (N != m_samplesPerFrame) {
+        ggprintf("computeFFTR: N (%d) must be equal to 'samplesPerFrame' %d\n", N, m_samplesPerFrame);
+        return false;
+    }
+
+    FFT(src, dst, N, m_rx.fftWorkI.data(), m_rx.fftWorkF.data());
+
+    return true;
+}
+
+int GGWave::computeFFTR(const float * src, float * dst, int N, int * wi, float * wf) {
+    if (wi == nullptr) return 2*N;
+    if (wf == nullptr) return 3 + sqrt(N/2);
+
+    FFT(src, dst, N, wi, wf);
+
+    return 1;
+}
+
+int GGWave::filter(ggwave_Filter filter, float * waveform, int N, float p0, float p1, float * w) {
+    if (w == nullptr) {
+        switch (filter) {
+            case GGWAVE_FILTER_HANN:                  return N;
+            case GGWAVE_FILTER_HAMMING:               return N;
+            case GGWAVE_FILTER_FIRST_ORDER_HIGH_PASS: return 11;
+        };
+    }
+
+    if (w[0] == 0.0f && w[1] == 0.0f) {
+        switch (filter) {
+            case GGWAVE_FILTER_HANN:
+                {
+                    const float f = 2.0f*M_PI/(float)N;
+                    for (int i = 0; i < N; i++) {
+                        w[i] = 0.5f - 0.5f*cosf(f*(float)i);
+                    }
+                } break;
+            case GGWAVE_FILTER_HAMMING:
+                {
+                    const float f = 2.0f*M_PI/(float)N;
+                    for (int i = 0; i < N; i++) {
+                        w[i] = 0.54f - 0.46f*cosf(f*(float)i);
+                    }
+                } break;
+            case GGWAVE_FILTER_FIRST_ORDER_HIGH_PASS:
+                {
+                    const float th = 2.0f*M_PI*p0/p1;
+                    const float g = cos(th)/(1.0f + sin(th));
+                    w[0] = (1.0f + g)/2.0f;
+                    w[1] = -((1.0f + g)/2.0f);
+                    w[2] = 0.0f;
+                    w[3] = -g;
+                    w[4] = 0.0f;
+
+                    w[5] = 0.0f;
+                    w[6] = 0.0f;
+                    w[7] = 0.0f;
+                    w[8] = 0.0f;
+                } break;
+        };
+    }
+
+    switch (filter) {
+        case GGWAVE_FILTER_HANN:
+        case GGWAVE_FILTER_HAMMING:
+            {
+                for (int i = 0; i < N; i++) {
+                    waveform[i] *= w[i];
+                }
+            } break;
+        case GGWAVE_FILTER_FIRST_ORDER_HIGH_PASS:
+            {
+                for (int i = 0; i < N; i++) {
+                    float xn = waveform[i];
+                    float yn = w[0]*xn + w[1]*w[5] + w[2]*w[6] + w[3]*w[7] + w[4]*w[8];
+                    w[6] = w[5];
+                    w[5] = xn;
+                    w[8] = w[7];
+                    w[7] = yn;
+
+                    waveform[i] = yn;
+                }
+            } break;
+    };
+
+    return 1;
+}
+
+//
+// GGWave::Resampler
+//
+
+GGWave::Resampler::Resampler() {}
+
+bool GGWave::Resampler::alloc(void * p, int & n, int nSamplesMax) {
+    ggalloc(m_sincTable,   kWidth*kSamplesPerZeroCrossing, p, n);
+    ggalloc(m_delayBuffer, 3*kWidth, p, n);
+    ggalloc(m_edgeSamples, kWidth, p, n);
+    ggalloc(m_samplesInp,  nSamplesMax + kWidth, p, n);
+
+    if (p) {
+        makeSinc();
+        reset();
+    }
+
+    return true;
+}
+
+void GGWave::Resampler::reset() {
+    m_state = {};
     m_edgeSamples.zero();
     m_delayBuffer.zero();
     m_samplesInp.zero();
 }
 
-int GGWave::Resampler::resample(
-        float factor,
-        int nSamples,
-        const float * samplesInp,
-        float * samplesOut) {
-    int idxInp = -1;
-    int idxOut = 0;
-    int notDone = 1;
-    float data_in = 0.0f;
-    float data_out = 0.0f;
-    double one_over_factor = 1.0;
+int GGWave::Resampler::resample(
+        float factor,
+        int nSamples,
+        const float * samplesInp,
+        float * samplesOut) {
+    int idxInp = -1;
+    int idxOut = 0;
+    int notDone = 1;
+    float data_in = 0.0f;
+    float data_out = 0.0f;
+    double one_over_factor = 1.0;
+
+    auto stateSave = m_state;
+
+    m_state.nSamplesTotal += nSamples;
+
+    if (samplesOut) {
+        assert(nSamples > kWidth);
+        assert((int) m_samplesInp.size() >= nSamples + kWidth);
+        //if ((int) m_samplesInp.size() < nSamples + kWidth) {
+        //    m_samplesInp.resize(nSamples + kWidth);
+        //}
+        for (int i = 0; i < kWidth; ++i) {
+            m_samplesInp[i] = m_edgeSamples[i];
+            m_edgeSamples[i] = samplesInp[nSamples - kWidth + i];
+        }
+        for (int i = 0; i < nSamples; ++i) {
+            m_samplesInp[i + kWidth] = samplesInp[i];
+        }
+        samplesInp = m_samplesInp.data();
+    }
+
+    while (notDone) {
+        while (m_state.timeLast < m_state.timeInt) {
+            if (++idxInp >= nSamples) {
+                notDone = 0;
+                break;
+            } else {
+                data_in = samplesInp[idxInp];
+            }
+            //printf("xxxx idxInp = %d\n", idxInp);
+            if (samplesOut) newData(data_in);
+            m_state.timeLast += 1;
+        }
+
+        if (notDone == false) break;
+
+        double temp1 = 0.0;
+        int left_limit = m_state.timeNow - kWidth + 1; /* leftmost neighboring sample used for interp.*/
+        int right_limit = m_state.timeNow + kWidth;    /* rightmost leftmost neighboring sample used for interp.*/
+        if (left_limit < 0) left_limit = 0;
+        if (right_limit > m_state.nSamplesTotal + kWidth) right_limit = m_state.nSamplesTotal + kWidth;
+        if (factor < 1.0) {
+            for (int j = left_limit; j < right_limit; j++) {
+                temp1 += getData(j - m_state.timeInt)*sinc(m_state.timeNow - (double) j);
+            }
+            data_out = temp1;
+        }
+        else {
+            one_over_factor = 1.0 / factor;
+            for (int j = left_limit; j < right_limit; j++) {
+                temp1 += getData(j - m_state.timeInt)*one_over_factor*sinc(one_over_factor*(m_state.timeNow - (double) j));
+            }
+            data_out = temp1;
+        }
+
+        if (samplesOut) {
+            //printf("inp = %d, l = %d, r = %d, n = %d, a = %d, b = %d\n", idxInp, left_limit, right_limit, m_state.nSamplesTotal, left_limit - m_state.timeInt, right_limit - m_state.timeInt - 1);
+            samplesOut[idxOut] = data_out;
+        }
+        ++idxOut;
+
+        m_state.timeNow += factor;
+        m_state.timeLast = m_state.timeInt;
+        m_state.timeInt = m_state.timeNow;
+        while (m_state.timeLast < m_state.timeInt) {
+            if (++idxInp >= nSamples) {
+                notDone = 0;
+                break;
+            } else {
+                data_in = samplesInp[idxInp];
+            }
+            if (samplesOut) newData(data_in);
+            m_state.timeLast += 1;
+        }
+        //printf("last idxInp = %d, nSamples = %d\n", idxInp, nSamples);
+    }
+
+    if (samplesOut == nullptr) {
+        m_state = stateSave;
+    }
+
+    return idxOut;
+}
+
+float GGWave::Resampler::getData(int j) const {
+    return m_delayBuffer[(int) j + kWidth];
+}
+
+void GGWave::Resampler::newData(float data) {
+    for (int i = 0; i < kDelaySize - 5; i++) {
+        m_delayBuffer[i] = m_delayBuffer[i + 1];
+    }
+    m_delayBuffer[kDelaySize - 5] = data;
+}
+
+void GGWave::Resampler::makeSinc() {
+    double temp, win_freq, win;
+    win_freq = M_PI/kWidth/kSamplesPerZeroCrossing;
+    m_sincTable[0] = 1.0;
+    for (int i = 1; i < kWidth*kSamplesPerZeroCrossing; i++) {
+        temp = (double) i*M_PI/kSamplesPerZeroCrossing;
+        m_sincTable[i] = sin(temp)/temp;
+        win = 0.5 + 0.5*cos(win_freq*i);
+        m_sincTable[i] *= win;
+    }
+}
+
+double GGWave::Resampler::sinc(double x) const {
+    int low;
+    double temp, delta;
+    if (fabs(x) >= kWidth - 1) {
+        return 0.0;
+    } else {
+        temp = fabs(x)*(double) kSamplesPerZeroCrossing;
+        low = temp;          /* these are interpolation steps */
+        delta = temp - low;  /* and can be ommited if desired */
+        return linear_interp(m_sincTable[low], m_sincTable[low + 1], delta);
+    }
+}
+
+//
+// Variable payload length
+//
+
+void GGWave::decode_channels(bool isReceiving) {
+    switch (m_channelMode) {
+        case GGWAVE_CHANNEL_MODE_DOWNMIX:
+            break;
+        case GGWAVE_CHANNEL_MODE_MAX_SNR:
+            {
+                // keep the selected channel until the reception is over. While idle, it is re-selected
+                // only at the start of an averaging window of the variable-length decoder and not
+                // between the two chirps of the short preamble, so no history mixes the channels
+                bool isLocked = isReceiving || rxLocked() || m_rx.historyId != 0;
+                for (int b = 0; b < m_rx.preambleLag.size(); ++b) {
+                    isLocked = isLocked || m_rx.preambleLag[b] >= 0;
+                }
+
+                if (isLocked == false) {
+                    float best = -1.0f;
+                    for (int c = 0; c < m_channelsInp; ++c) {
+                        FFT(m_rx.amplitudeChannels[c].data(), m_rx.fftOut.data(), m_samplesPerFrame, m_rx.fftWorkI.data(), m_rx.fftWorkF.data());
+
+                        float amax = 0.0f;
+                        float asum = 0.0f;
+                        for (int i = GG_MAX(1, m_rx.minFreqStart); i < m_samplesPerFrame/2; ++i) {
+                            const float a =
+                                m_rx.fftOut[2*i + 0]*m_rx.fftOut[2*i + 0] + m_rx.fftOut[2*i + 1]*m_rx.fftOut[2*i + 1] +
+                                m_rx.fftOut[2*(m_samplesPerFrame - i) + 0]*m_rx.fftOut[2*(m_samplesPerFrame - i) + 0] +
+                                m_rx.fftOut[2*(m_samplesPerFrame - i) + 1]*m_rx.fftOut[2*(m_samplesPerFrame - i) + 1];
+                            amax = GG_MAX(amax, a);
+                            asum += a;
+                        }
+
+                        // peak-to-average ratio of the power spectrum
+                        const float snr = asum > 0.0f ? amax/asum : 0.0f;
+                        if (snr > best) {
+                            best = snr;
+                            m_rx.channelId = c;
+                        }
+                    }
+                }
+
+                m_rx.amplitude.copy(m_rx.amplitudeChannels[m_rx.channelId]);
+            } break;
+        case GGWAVE_CHANNEL_MODE_SUM_SPECTRA:
+        case GGWAVE_CHANNEL_MODE_PER_CHANNEL:
+            // the downmix is in m_rx.amplitude and the channels are used directly
+            break;
+    }
+}
+
+void GGWave::decode_spectrum(bool averaged, float * dst) {
+    if (averaged == false && m_channelsInp > 1 && m_channelMode == GGWAVE_CHANNEL_MODE_SUM_SPECTRA) {
+        for (int i = 0; i < m_samplesPerFrame; ++i) {
+            dst[i] = 0.0f;
+        }
+
+        for (int c = 0; c < m_channelsInp; ++c) {
+            FFT(m_rx.amplitudeChannels[c].data(), m_rx.fftOut.data(), m_samplesPerFrame, m_rx.fftWorkI.data(), m_rx.fftWorkF.data());
+
+            for (int i = 0; i < m_samplesPerFrame; ++i) {
+                m_rx.spectrumChannel[i] = (m_rx.fftOut[2*i + 0]*m_rx.fftOut[2*i + 0] + m_rx.fftOut[2*i + 1]*m_rx.fftOut[2*i + 1]);
+            }
+            for (int i = 1; i < m_samplesPerFrame/2; ++i) {
+                m_rx.spectrumChannel[i] += m_rx.spectrumChannel[m_samplesPerFrame - i];
+            }
+            for (int i = 0; i < m_samplesPerFrame; ++i) {
+                dst[i] += m_rx.spectrumChannel[i];
+            }
+        }
+
+        return;
+    }
+
+    const float * src = m_rx.amplitude.data();
+
+    if (averaged) {
+        m_rx.amplitudeAverage.zero();
+        for (int j = 0; j < (int) m_rx.amplitudeHistory.size(); ++j) {
+            auto s = m_rx.amplitudeHistory[j];
+            for (int i = 0; i < m_samplesPerFrame; ++i) {
+                m_rx.amplitudeAverage[i] += s[i];
+            }
+        }
+
+        float norm = 1.0f/kMaxSpectrumHistory;
+        for (int i = 0; i < m_samplesPerFrame; ++i) {
+            m_rx.amplitudeAverage[i] *= norm;
+        }
+
+        src = m_rx.amplitudeAverage.data();
+    }
+
+    // calculate spectrum
+    FFT(src, m_rx.fftOut.data(), m_samplesPerFrame, m_rx.fftWorkI.data(), m_rx.fftWorkF.data());
+
+    for (int i = 0; i < m_samplesPerFrame; ++i) {
+        dst[i] = (m_rx.fftOut[2*i + 0]*m_rx.fftOut[2*i + 0] + m_rx.fftOut[2*i + 1]*m_rx.fftOut[2*i + 1]);
+    }
+    for (int i = 1; i < m_samplesPerFrame/2; ++i) {
+        dst[i] += dst[m_samplesPerFrame - i];
+    }
+}
+
+bool GGWave::decode_gate(bool isBusy) {
+    // in-band energy at the end of the frame - the filters start from rest and settle during the warm-up
+    const int nSamples = GG_MIN(kGateSamples + kGateWarmup, m_samplesPerFrame);
+    const int nWarmup  = GG_MIN(kGateWarmup, nSamples/4);
+
+    float z[2][2] = { { 0.0f, 0.0f }, { 0.0f, 0.0f } };
+
+    float energy = 0.0f;
+    for (int i = m_samplesPerFrame - nSamples; i < m_samplesPerFrame; ++i) {
+        float x = m_rx.amplitude[i];
+        for (int f = 0; f < 2; ++f) {
+            const float * c = m_rx.gateFilter[f];
+
+            const float y = c[0]*x + z[f][0];
+            z[f][0] = c[1]*x - c[3]*y + z[f][1];
+            z[f][1] = c[2]*x - c[4]*y;
+            x = y;
+        }
+        energy += x*x;
+
+        if (i == m_samplesPerFrame - nSamples + nWarmup - 1) {
+            energy = 0.0f;
+        }
+    }
+    energy = GG_MAX(kGateEnergyMin, energy/(nSamples - nWarmup));
+
+    if (m_rx.gateFloor == 0.0f) {
+        m_rx.gateFloor = energy;
+    }
+
+    const bool isLoud = energy > kGateThreshold*m_rx.gateFloor;
+
+    // the noise floor follows any drop immediately, but rises slowly and not during a reception
+    if (energy < m_rx.gateFloor) {
+        m_rx.gateFloor = energy;
+    } else if (isBusy == false) {
+        m_rx.gateFloor = GG_MIN(energy, kGateFloorRise*m_rx.gateFloor);
+    }
+
+    if (isLoud || isBusy) {
+        // a fixed-length payload that starts now must fit in the history before the gate closes
+        m_rx.gateHold = m_isFixedPayloadLength ? m_rx.historySizeFixed : 2*m_nMarkerFrames;
+    } else if (m_rx.gateHold > 0) {
+        --m_rx.gateHold;
+    }
+
+    return m_rx.gateHold > 0;
+}
+
+void GGWave::decode_idle(GGWave * const * backends, int nBackends) {
+    // keep the frame history of the variable-length decoders up to date, so that the first averaged
+    // spectrum after the gate opens does not contain stale frames
+    if (m_isFixedPayloadLength == false) {
+        m_rx.amplitudeHistory[m_rx.historyId].copy(m_rx.amplitude);
+
+        if (++m_rx.historyId >= kMaxSpectrumHistory) {
+            m_rx.historyId = 0;
+        }
+    }
+
+    const bool isPerChannel = m_channelsInp > 1 && m_channelMode == GGWAVE_CHANNEL_MODE_PER_CHANNEL;
+
+    for (int ib = 0; ib < nBackends; ++ib) {
+        auto & backend = *backends[ib];
+        if (backend.m_isFixedPayloadLength) {
+            continue;
+        }
+
+        const float * src = isPerChannel ? m_rx.amplitudeChannels[ib].data() : m_rx.amplitude.data();
+        memcpy(backend.m_rx.amplitudeHistory[backend.m_rx.historyId].data(), src, m_samplesPerFrame*sizeof(float));
+
+        if (++backend.m_rx.historyId >= kMaxSpectrumHistory) {
+            backend.m_rx.historyId = 0;
+        }
+    }
+}
+
+void GGWave::decode_shared(GGWave * const * backends, int nBackends) {
+    m_rx.hasSharedSpectrum        = false;
+    m_rx.hasSharedSpectrumAverage = false;
+
+    if (m_isFixedPayloadLength == false) {
+        m_rx.amplitudeHistory[m_rx.historyId].copy(m_rx.amplitude);
+
+        if (++m_rx.historyId >= kMaxSpectrumHistory) {
+            m_rx.historyId = 0;
+        }
+    }
+
+    // each back-end decodes its own channel and computes its own spectrum
+    const bool isPerChannel = m_channelsInp > 1 && m_channelMode == GGWAVE_CHANNEL_MODE_PER_CHANNEL;
+
+    for (int ib = 0; ib < nBackends; ++ib) {
+        auto & backend = *backends[ib];
+
+        const float * src = isPerChannel ? m_rx.amplitudeChannels[ib].data() : m_rx.amplitude.data();
+        memcpy(backend.m_rx.amplitude.data(), src, m_samplesPerFrame*sizeof(float));
+        backend.m_rx.hasNewAmplitude = true;
+
+        if (backend.m_isFixedPayloadLength) {
+            backend.decode_fixed(isPerChannel ? nullptr : this);
+        } else {
+            backend.decode_variable(isPerChannel ? nullptr : this);
+        }
+    }
+}
+
+const float * GGWave::decode_sharedSpectrum(bool averaged) {
+    if (averaged) {
+        // the frame history is available only in variable-length mode
+        if (m_isFixedPayloadLength) {
+            return nullptr;
+        }
+
+        // note : the averaged frame is no longer needed after the FFT, so its buffer holds the result
+        if (m_rx.hasSharedSpectrumAverage == false) {
+            decode_spectrum(true, m_rx.amplitudeAverage.data());
+            m_rx.hasSharedSpectrumAverage = true;
+        }
+
+        return m_rx.amplitudeAverage.data();
+    }
+
+    if (m_rx.hasSharedSpectrum == false) {
+        decode_spectrum(false, m_rx.spectrum.data());
+        m_rx.hasSharedSpectrum = true;
+        m_rx.hasNewSpectrum    = true;
+    }
+
+    return m_rx.spectrum.data();
+}
+
+void GGWave::decode_variable(GGWave * frontEnd) {
+    m_rx.amplitudeHistory[m_rx.historyId].copy(m_rx.amplitude);
+
+    if (++m_rx.historyId >= kMaxSpectrumHistory) {
+        m_rx.historyId = 0;
+    }
+
+    if (m_rx.historyId == 0 || rxReceiving()) {
+        m_rx.hasNewSpectrum = true;
+
+        const float * shared = frontEnd ? frontEnd->decode_sharedSpectrum(true) : nullptr;
+        if (shared) {
+            memcpy(m_rx.spectrum.data(), shared, m_samplesPerFrame*sizeof(float));
+        } else {
+            decode_spectrum(true, m_rx.spectrum.data());
+        }
+    }
+
+    // record the frame once for all streams that need it
+    bool isRecorded = false;
+    {
+        bool isRecording = false;
+        for (int is = 0; is < m_rx.nStreams; ++is) {
+            if (m_rx.streams[is].framesLeftToRecord > 0) {
+                isRecording = true;
+                break;
+            }
+        }
+
+        if (isRecording) {
+            memcpy(m_rx.amplitudeRecorded.data() + m_rx.recordedId*m_samplesPerFrame,
+                   m_rx.amplitude.data(),
+                   m_samplesPerFrame*sizeof(float));
+
+            if (++m_rx.recordedId >= maxRecordedFrames()) {
+                m_rx.recordedId = 0;
+            }
+
+            isRecorded = true;
+
+            for (int is = 0; is < m_rx.nStreams; ++is) {
+                auto & stream = m_rx.streams[is];
+                if (stream.framesLeftToRecord > 0) {
+                    if (--stream.framesLeftToRecord <= 0) {
+                        stream.analyzing = true;
+                    }
+                }
+            }
+        }
+    }
+
+    // with the short preamble, the recording stops once the length is known
+    for (int is = 0; is < m_rx.nStreams && m_isShortPreamble; ++is) {
+        auto & stream = m_rx.streams[is];
+        if (stream.receiving && stream.analyzing == false && stream.hasHeader == false) {
+            decode_header(stream);
+        }
+    }
+
+    // bands with at least one enabled protocol, and with an enabled mono-tone protocol
+    bool isBandActive[GGWAVE_PROTOCOL_COUNT] = {};
+    bool isBandMonoTone[GGWAVE_PROTOCOL_COUNT] = {};
+    for (int i = 0; i < m_rx.protocols.size(); ++i) {
+        if (m_rx.protocols[i].enabled && m_rx.bandId[i] >= 0) {
+            isBandActive[m_rx.bandId[i]] = true;
+            isBandMonoTone[m_rx.bandId[i]] |= m_rx.protocols[i].extra != 1;
+        }
+    }
+
+    // the end marker has the opposite pattern of the start marker
+    const auto isMarker = [&](int bandId, bool isStart) {
+        const auto bins = m_rx.bandMarkerBins[bandId];
+
+        float toneMin = 0.0f;
+        float toneMax = 0.0f;
+
+        for (int i = 0; i < m_nBitsInMarker; ++i) {
+            const float a = m_rx.spectrum[bins[i]];
+            const float b = m_soundMarkerThreshold*m_rx.spectrum[bins[i] + m_freqDelta_bin];
+
+            if ((i%2 == 0) == isStart) {
+                if (a <= b) return false;
+            } else {
+                if (a >= b) return false;
+            }
+
+            const float tone = (i%2 == 0) == isStart ? a : m_rx.spectrum[bins[i] + m_freqDelta_bin];
+            toneMin = i == 0 ? tone : GG_MIN(toneMin, tone);
+            toneMax = GG_MAX(toneMax, tone);
+        }
+
+        // in the bands of the mono-tone protocols, the tones of the end marker must all be present (within
+        // ~30 dB). The leakage of a single data tone can pass the checks above and would end the recording
+        constexpr float kToneRatioMin = 1e-3f;
+
+        return isStart || isBandMonoTone[bandId] == false || toneMin > kToneRatioMin*toneMax;
+    };
+
+    // check if receiving data has ended - there is no end marker after the short preamble
+    for (int is = 0; is < m_rx.nStreams; ++is) {
+        auto & stream = m_rx.streams[is];
+        if (stream.receiving == false || stream.analyzing || m_isShortPreamble) {
+            continue;
+        }
+
+        bool isEnded = false;
+
+        for (int b = 0; b < m_rx.nBands; ++b) {
+            if (isBandActive[b] == false) {
+                continue;
+            }
 
-    auto stateSave = m_state;
+            // in multi-stream mode, each stream looks only for its own end marker
+            if (m_isRxMultiStream && m_rx.bandFreqStart[b] != stream.markerFreqStart) {
+                continue;
+            }
 
-    m_state.nSamplesTotal += nSamples;
+            if (isMarker(b, false)) {
+                isEnded = true;
+                break;
+            }
+        }
 
-    if (samplesOut) {
-        assert(nSamples > kWidth);
-        assert((int) m_samplesInp.size() >= nSamples + kWidth);
-        //if ((int) m_samplesInp.size() < nSamples + kWidth) {
-        //    m_samplesInp.resize(nSamples + kWidth);
-        //}
-        for (int i = 0; i < kWidth; ++i) {
-            m_samplesInp[i] = m_edgeSamples[i];
-            m_edgeSamples[i] = samplesInp[nSamples - kWidth + i];
+        if (isEnded) {
+            if (++stream.nMarkersSuccess >= 1) {
+            } else {
+                isEnded = false;
+            }
+        } else {
+            stream.nMarkersSuccess = 0;
         }
-        for (int i = 0; i < nSamples; ++i) {
-            m_samplesInp[i + kWidth] = samplesInp[i];
+
+        if (isEnded && stream.framesToRecord > 1) {
+            stream.recvDuration_frames -= stream.framesLeftToRecord - 1;
+            ggprintf("Received end marker. Frames left = %d, recorded = %d\n", stream.framesLeftToRecord, stream.recvDuration_frames);
+            stream.nMarkersSuccess = 0;
+            stream.framesLeftToRecord = 1;
         }
-        samplesInp = m_samplesInp.data();
     }
 
-    while (notDone) {
-        while (m_state.timeLast < m_state.timeInt) {
-            if (++idxInp >= nSamples) {
-                notDone = 0;
-                break;
-            } else {
-                data_in = samplesInp[idxInp];
-            }
-            //printf("xxxx idxInp = %d\n", idxInp);
-            if (samplesOut) newData(data_in);
-            m_state.timeLast += 1;
+    // the matched filter of the short preamble runs on the spectrum of the last 2 frames
+    if (m_isShortPreamble) {
+        const int n = m_samplesPerFrame;
+        const auto & prev = m_rx.amplitudeHistory[(m_rx.historyId + kMaxSpectrumHistory - 2) % kMaxSpectrumHistory];
+
+        memcpy(m_rx.preambleFFT.data(),     prev.data(),           n*sizeof(float));
+        memcpy(m_rx.preambleFFT.data() + n, m_rx.amplitude.data(), n*sizeof(float));
+
+        rdft(2*n, 1, m_rx.preambleFFT.data(), m_rx.preambleWorkI.data(), m_rx.preambleWorkF.data());
+    }
+
+    // check if receiving data has started
+    for (int b = 0; b < m_rx.nBands; ++b) {
+        if (isBandActive[b] == false) {
+            continue;
         }
 
-        if (notDone == false) break;
+        const int freqStart = m_rx.bandFreqStart[b];
 
-        double temp1 = 0.0;
-        int left_limit = m_state.timeNow - kWidth + 1; /* leftmost neighboring sample used for interp.*/
-        int right_limit = m_state.timeNow + kWidth;    /* rightmost leftmost neighboring sample used for interp.*/
-        if (left_limit < 0) left_limit = 0;
-        if (right_limit > m_state.nSamplesTotal + kWidth) right_limit = m_state.nSamplesTotal + kWidth;
-        if (factor < 1.0) {
-            for (int j = left_limit; j < right_limit; j++) {
-                temp1 += getData(j - m_state.timeInt)*sinc(m_state.timeNow - (double) j);
+        // find a stream that is free to receive on this frequency band
+        int streamId = -1;
+        for (int is = 0; is < m_rx.nStreams; ++is) {
+            const auto & stream = m_rx.streams[is];
+            if (stream.receiving) {
+                if (m_isRxMultiStream == false || stream.markerFreqStart == freqStart) {
+                    streamId = -1;
+                    break;
+                }
+            } else if (streamId == -1) {
+                streamId = is;
             }
-            data_out = temp1;
         }
-        else {
-            one_over_factor = 1.0 / factor;
-            for (int j = left_limit; j < right_limit; j++) {
-                temp1 += getData(j - m_state.timeInt)*one_over_factor*sinc(one_over_factor*(m_state.timeNow - (double) j));
+
+        if (streamId == -1) {
+            if (m_isShortPreamble) {
+                m_rx.preambleLag[b] = -1;
             }
-            data_out = temp1;
+            continue;
         }
 
-        if (samplesOut) {
-            //printf("inp = %d, l = %d, r = %d, n = %d, a = %d, b = %d\n", idxInp, left_limit, right_limit, m_state.nSamplesTotal, left_limit - m_state.timeInt, right_limit - m_state.timeInt - 1);
-            samplesOut[idxOut] = data_out;
+        auto & stream = m_rx.streams[streamId];
+
+        bool isReceiving = false;
+
+        if (m_isShortPreamble) {
+            // the negated chirp must follow one frame after the chirp, at the same lag
+            int lag = 0;
+            bool isNegated = false;
+
+            if (decode_preamble(b, lag, isNegated)) {
+                const int lagPrev = m_rx.preambleLag[b];
+
+                isReceiving = isNegated && lagPrev >= 0 && lag - lagPrev >= -2 && lag - lagPrev <= 2;
+                m_rx.preambleLag[b] = isNegated ? -1 : lag;
+
+                // the data starts after the negated chirp
+                if (isReceiving) {
+                    stream.dataOffset = lag;
+                }
+            } else {
+                m_rx.preambleLag[b] = -1;
+            }
+        } else {
+            isReceiving = isMarker(b, true);
+
+            if (isReceiving) {
+                if (++stream.nMarkersSuccess >= 1) {
+                } else {
+                    isReceiving = false;
+                }
+            } else {
+                stream.nMarkersSuccess = 0;
+            }
         }
-        ++idxOut;
 
-        m_state.timeNow += factor;
-        m_state.timeLast = m_state.timeInt;
-        m_state.timeInt = m_state.timeNow;
-        while (m_state.timeLast < m_state.timeInt) {
-            if (++idxInp >= nSamples) {
-                notDone = 0;
+        if (isReceiving) {
+            ggprintf("Receiving sound data ...\n");
+
+            stream.receiving = true;
+            stream.markerFreqStart = freqStart;
+            stream.data.zero();
+
+            // max recieve duration
+            stream.recvDuration_frames =
+                2*m_nMarkerFrames +
+                maxFramesPerTx(m_rx.protocols)*(
+                        ::getEncodedLength(m_isLongPayload ? kMaxLengthLong : kMaxLengthVariable)/minBytesPerTx(m_rx.protocols) + 1
+                        );
+            stream.recvDuration_frames = GG_MIN(stream.recvDuration_frames, maxRecordedFrames());
+
+            stream.nMarkersSuccess = 0;
+            stream.framesToRecord = stream.recvDuration_frames;
+            stream.framesLeftToRecord = stream.recvDuration_frames;
+            stream.recordedStart = m_rx.recordedId;
+
+            // the short preamble ends in this frame, so the recording starts with it
+            if (m_isShortPreamble) {
+                if (isRecorded == false) {
+                    memcpy(m_rx.amplitudeRecorded.data() + m_rx.recordedId*m_samplesPerFrame,
+                           m_rx.amplitude.data(),
+                           m_samplesPerFrame*sizeof(float));
+
+                    if (++m_rx.recordedId >= maxRecordedFrames()) {
+                        m_rx.recordedId = 0;
+                    }
+
+                    isRecorded = true;
+                }
+
+                stream.recordedStart = (m_rx.recordedId + maxRecordedFrames() - 1) % maxRecordedFrames();
+                stream.framesLeftToRecord -= 1;
+
+                stream.hasHeader    = false;
+                stream.headerFrames = 0;
+                stream.headerLength = 0;
+            }
+
+            m_rx.streamId = streamId;
+
+            if (m_isRxMultiStream == false) {
                 break;
-            } else {
-                data_in = samplesInp[idxInp];
             }
-            if (samplesOut) newData(data_in);
-            m_state.timeLast += 1;
         }
-        //printf("last idxInp = %d, nSamples = %d\n", idxInp, nSamples);
     }
 
-    if (samplesOut == nullptr) {
-        m_state = stateSave;
-    }
+    for (int is = 0; is < m_rx.nStreams; ++is) {
+        auto & stream = m_rx.streams[is];
+        if (stream.analyzing == false) {
+            continue;
+        }
 
-    return idxOut;
-}
+        ggprintf("Analyzing captured data ..\n");
 
-float GGWave::Resampler::getData(int j) const {
-    return m_delayBuffer[(int) j + kWidth];
-}
+        const int stepsPerFrame = 16;
+        const int step = m_samplesPerFrame/stepsPerFrame;
 
-void GGWave::Resampler::newData(float data) {
-    for (int i = 0; i < kDelaySize - 5; i++) {
-        m_delayBuffer[i] = m_delayBuffer[i + 1];
-    }
-    m_delayBuffer[kDelaySize - 5] = data;
-}
+        // the short preamble gives the position of the data
+        const int nOffsets = m_isShortPreamble ? 2*kPreambleSearchSteps + 1 : m_nMarkerFrames*stepsPerFrame;
 
-void GGWave::Resampler::makeSinc() {
-    double temp, win_freq, win;
-    win_freq = M_PI/kWidth/kSamplesPerZeroCrossing;
-    m_sincTable[0] = 1.0;
-    for (int i = 1; i < kWidth*kSamplesPerZeroCrossing; i++) {
-        temp = (double) i*M_PI/kSamplesPerZeroCrossing;
-        m_sincTable[i] = sin(temp)/temp;
-        win = 0.5 + 0.5*cos(win_freq*i);
-        m_sincTable[i] *= win;
-    }
-}
+        bool isValid = false;
+        for (int protocolId = 0; protocolId < (int) m_rx.protocols.size(); ++protocolId) {
+            const auto & protocol = m_rx.protocols[protocolId];
+            if (protocol.enabled == false || m_rx.bandId[protocolId] < 0) {
+                continue;
+            }
 
-double GGWave::Resampler::sinc(double x) const {
-    int low;
-    double temp, delta;
-    if (fabs(x) >= kWidth - 1) {
-        return 0.0;
-    } else {
-        temp = fabs(x)*(double) kSamplesPerZeroCrossing;
-        low = temp;          /* these are interpolation steps */
-        delta = temp - low;  /* and can be ommited if desired */
-        return linear_interp(m_sincTable[low], m_sincTable[low + 1], delta);
-    }
-}
+            // skip Rx protocol if start frequency is different from detected one
+            if (protocol.freqStart != stream.markerFreqStart) {
+                continue;
+            }
 
-//
-// Variable payload length
-//
+            m_rx.spectrum.zero();
 
-void GGWave::decode_variable() {
-    m_rx.amplitudeHistory[m_rx.historyId].copy(m_rx.amplitude);
+            stream.framesToAnalyze = nOffsets;
+            stream.framesLeftToAnalyze = stream.framesToAnalyze;
 
-    if (++m_rx.historyId >= kMaxSpectrumHistory) {
-        m_rx.historyId = 0;
+            // the first offset that decodes only with a correction that uses the ECC reserve.
+            // it is accepted in a second pass, if none of the offsets decodes without it
+            int iiWeak = -1;
+
+            for (int pass = 0; pass < 2 && isValid == false; ++pass) {
+                const bool isStrict = pass == 0;
+                if (isStrict == false && iiWeak < 0) {
+                    break;
+                }
+
+                // note : not sure if looping backwards here is more meaningful than looping forwards
+                for (int ii = nOffsets - 1; ii >= 0; --ii) {
+                    if (isStrict == false && ii != iiWeak) {
+                        continue;
+                    }
+
+                    // with the short preamble, start at its data offset and alternate around it: 0, +1, -1, +2, ..
+                    int offsetStart = ii*step;
+                    if (m_isShortPreamble) {
+                        const int k = nOffsets - 1 - ii;
+                        offsetStart = stream.dataOffset + (k%2 == 1 ? 1 : -1)*((k + 1)/2)*step;
+                        if (offsetStart < 0) {
+                            continue;
+                        }
+                    }
+
+                    bool knownLength = false;
+
+                    int decodedLength = 0;
+                    for (int itx = 0; ; ++itx) {
+                        int offsetTx = offsetStart + itx*protocol.framesPerTx*protocol.extra*stepsPerFrame*step;
+                        if (offsetTx >= stream.recvDuration_frames*stepsPerFrame*step || itx*protocol.bytesPerTx >= (int) m_dataEncoded.size()) {
+                            break;
+                        }
+
+                        // the last block may be truncated by the size of the buffer
+                        uint8_t * dst        = m_dataEncoded.data()   + itx*protocol.bytesPerTx;
+                        float   * confidence = m_rx.confidence.data() + itx*protocol.bytesPerTx;
+
+                        const int nBytes = GG_MIN((int) protocol.bytesPerTx, (int) m_dataEncoded.size() - itx*protocol.bytesPerTx);
+
+                        decode_block(stream, protocolId, offsetTx, protocol.framesPerTx, dst, confidence, nBytes);
+
+                        if ((itx + 1)*protocol.bytesPerTx >= m_encodedDataOffset && knownLength == false) {
+                            // most candidate offsets are wrong - reject them based on the syndromes first
+                            decodedLength = decode_length(m_dataEncoded.data(), stream.data.data());
+                            if (decodedLength == 0) {
+                                break;
+                            }
+
+                            knownLength = true;
+                            //printf("decoded length = %d, recvDuration_frames = %d\n", decodedLength, stream.recvDuration_frames);
+
+                            const int nTotalBytesExpected = m_encodedDataOffset + ::getEncodedLength(decodedLength);
+                            const int nTotalTxsExpected = (nTotalBytesExpected + protocol.bytesPerTx - 1)/protocol.bytesPerTx;
+
+                            // the length must match the header that stopped the recording, which must fit the transmission
+                            if (m_isShortPreamble) {
+                                const int nTotalSamples = stream.dataOffset + nTotalTxsExpected*protocol.framesPerTx*protocol.extra*m_samplesPerFrame;
+                                if (decodedLength != stream.headerLength ||
+                                    stream.recvDuration_frames*m_samplesPerFrame < nTotalSamples) {
+                                    //printf("  - length %d does not match the header %d\n", decodedLength, stream.headerLength);
+                                    knownLength = false;
+                                    break;
+                                }
+                            }
+
+                            const int nTotalFramesExpected = 2*m_nMarkerFrames + nTotalTxsExpected*protocol.framesPerTx*protocol.extra;
+                            if (m_isShortPreamble == false &&
+                                (stream.recvDuration_frames > nTotalFramesExpected ||
+                                 stream.recvDuration_frames < nTotalFramesExpected - 2*m_nMarkerFrames)) {
+                                //printf("  - invalid number of frames: %d (expected %d)\n", stream.recvDuration_frames, nTotalFramesExpected);
+                                knownLength = false;
+                                break;
+                            }
+                        }
+
+                        {
+                            const int nTotalBytesExpected = m_encodedDataOffset + ::getEncodedLength(decodedLength);
+                            if (knownLength && itx*protocol.bytesPerTx > nTotalBytesExpected + 1) {
+                                break;
+                            }
+                        }
+                    }
+
+                    if (knownLength) {
+                        if (decodedLength > kMaxLengthVariable) {
+                            decodedLength = ::decodeLong(m_workRSData.data(), ::getLongBlocks(decodedLength),
+                                                         m_dataEncoded.data() + m_encodedDataOffset, m_rx.confidence.data() + m_encodedDataOffset,
+                                                         m_rx.erasures.data(), stream.data.data());
+                        } else {
+                            RS::ReedSolomon rsData(decodedLength, ::getECCBytesForLength(decodedLength), m_workRSData.data());
+
+                            const int res = ::decodeRSCandidate(rsData, m_dataEncoded.data() + m_encodedDataOffset, stream.data.data(),
+                                                       m_rx.confidence.data() + m_encodedDataOffset, m_rx.erasures.data(), isStrict);
+                            if (res == 2 && iiWeak < 0) {
+                                iiWeak = ii;
+                            }
+                            if (res != 0) {
+                                decodedLength = -1;
+                            }
+                        }
+
+                        if (decodedLength > 0) {
+                            if (m_isDSSEnabled) {
+                                for (int i = 0; i < decodedLength; ++i) {
+                                    stream.data[i] = stream.data[i] ^ getDSSMagic(i);
+                                }
+                            }
+
+                            ggprintf("Decoded length = %d, protocol = '%s' (%d)\n", decodedLength, protocol.name, protocolId);
+                            ggprintf("Received sound data successfully: '%s'\n", stream.data.data());
+
+                            isValid = true;
+                            stream.dataLength = decodedLength;
+                            stream.protocol = protocol;
+                            stream.protocolId = RxProtocolId(protocolId);
+                        }
+                    }
+
+                    if (isValid) {
+                        break;
+                    }
+                    if (isStrict) {
+                        --stream.framesLeftToAnalyze;
+                    }
+                }
+            }
+
+            if (isValid) break;
+        }
+
+        stream.framesToRecord = 0;
+
+        if (isValid == false) {
+            ggprintf("Failed to capture sound data. Please try again (length = %d)\n", stream.data[0]);
+            stream.dataLength = -1;
+            stream.framesToRecord = -1;
+        }
+
+        stream.receiving = false;
+        stream.analyzing = false;
+
+        m_rx.spectrum.zero();
+
+        stream.framesToAnalyze = 0;
+        stream.framesLeftToAnalyze = 0;
+
+        m_rx.streamId = is;
     }
 
-    if (m_rx.historyId == 0 || m_rx.receiving) {
-        m_rx.hasNewSpectrum = true;
+    decode_variable_publish();
+}
 
-        m_rx.amplitudeAverage.zero();
-        for (int j = 0; j < (int) m_rx.amplitudeHistory.size(); ++j) {
-            auto s = m_rx.amplitudeHistory[j];
-            for (int i = 0; i < m_samplesPerFrame; ++i) {
-                m_rx.amplitudeAverage[i] += s[i];
+void GGWave::decode_variable_publish() {
+    for (int is = 0; is < m_rx.nStreams; ++is) {
+        auto & stream = m_rx.streams[is];
+        if (stream.dataLength == 0) {
+            continue;
+        }
+
+        // in multi-stream mode, keep the data in the stream until the previous data is taken
+        if (m_isRxMultiStream && m_rx.dataLength != 0) {
+            break;
+        }
+
+        if (stream.dataLength > 0) {
+            if (stream.data.data() != m_rx.data.data()) {
+                m_rx.data.copy(stream.data);
             }
+
+            m_rx.hasNewRxData = true;
+            m_rx.protocol = stream.protocol;
+            m_rx.protocolId = stream.protocolId;
         }
 
-        float norm = 1.0f/kMaxSpectrumHistory;
-        for (int i = 0; i < m_samplesPerFrame; ++i) {
-            m_rx.amplitudeAverage[i] *= norm;
-        }
+        m_rx.dataLength = stream.dataLength;
+        stream.dataLength = 0;
+    }
+}
+
+// Matched filter of the short preamble on frequency band bandId
+//
+//   The spectrum of the last 2 frames is multiplied by the conjugate spectrum of the chirp over
+//   the bins of the band, which gives the correlation of the chirp with the window at each lag.
+//   The largest correlation is normalized by the energy of the chirp and the in-band energy of
+//   the window, so the detection does not depend on the volume.
+//
+bool GGWave::decode_preamble(int bandId, int & lag, bool & isNegated) {
+    const int n = 2*m_samplesPerFrame;
+
+    const float * x = m_rx.preambleFFT.data();
+    const float * c = m_rx.preambleTemplate[bandId].data();
+    float * r = m_rx.preambleCorr.data();
 
-        // calculate spectrum
-        FFT(m_rx.amplitudeAverage.data(), m_rx.fftOut.data(), m_samplesPerFrame, m_rx.fftWorkI.data(), m_rx.fftWorkF.data());
+    const int freqStart = 2*m_rx.bandFreqStart[bandId];
+    const int k0 = GG_MAX(1, freqStart - 2);
+    const int k1 = GG_MIN(n/2 - 1, freqStart + 4*m_nBitsInMarker + 2);
 
-        for (int i = 0; i < m_samplesPerFrame; ++i) {
-            m_rx.spectrum[i] = (m_rx.fftOut[2*i + 0]*m_rx.fftOut[2*i + 0] + m_rx.fftOut[2*i + 1]*m_rx.fftOut[2*i + 1]);
-        }
-        for (int i = 1; i < m_samplesPerFrame/2; ++i) {
-            m_rx.spectrum[i] += m_rx.spectrum[m_samplesPerFrame - i];
-        }
+    for (int i = 0; i < n; ++i) {
+        r[i] = 0.0f;
     }
 
-    if (m_rx.framesLeftToRecord > 0) {
-        memcpy(m_rx.amplitudeRecorded.data() + (m_rx.framesToRecord - m_rx.framesLeftToRecord)*m_samplesPerFrame,
-               m_rx.amplitude.data(),
-               m_samplesPerFrame*sizeof(float));
+    float energyX = 0.0f;
+    float energyC = 0.0f;
+    for (int k = k0; k < k1; ++k) {
+        r[2*k + 0] = x[2*k + 0]*c[2*k + 0] + x[2*k + 1]*c[2*k + 1];
+        r[2*k + 1] = x[2*k + 1]*c[2*k + 0] - x[2*k + 0]*c[2*k + 1];
 
-        if (--m_rx.framesLeftToRecord <= 0) {
-            m_rx.analyzing = true;
-        }
+        energyX += x[2*k + 0]*x[2*k + 0] + x[2*k + 1]*x[2*k + 1];
+        energyC += c[2*k + 0]*c[2*k + 0] + c[2*k + 1]*c[2*k + 1];
     }
 
-    if (m_rx.analyzing) {
-        ggprintf("Analyzing captured data ..\n");
+    if (energyX <= 0.0f) {
+        return false;
+    }
 
-        const int stepsPerFrame = 16;
-        const int step = m_samplesPerFrame/stepsPerFrame;
+    rdft(n, -1, r, m_rx.preambleWorkI.data(), m_rx.preambleWorkF.data());
 
-        bool isValid = false;
-        for (int protocolId = 0; protocolId < (int) m_rx.protocols.size(); ++protocolId) {
-            const auto & protocol = m_rx.protocols[protocolId];
-            if (protocol.enabled == false) {
-                continue;
-            }
+    // the chirp is fully inside the window for lags [0, samplesPerFrame)
+    lag = 0;
+    for (int i = 1; i < m_samplesPerFrame; ++i) {
+        if (fabsf(r[i]) > fabsf(r[lag])) {
+            lag = i;
+        }
+    }
 
-            // skip Rx protocol if it is mono-tone
-            if (protocol.extra == 2) {
-                continue;
-            }
+    isNegated = r[lag] < 0.0f;
 
-            // skip Rx protocol if start frequency is different from detected one
-            if (protocol.freqStart != m_rx.markerFreqStart) {
-                continue;
-            }
+    return r[lag]*r[lag] >= kPreambleThreshold*energyX*energyC;
+}
 
-            m_rx.spectrum.zero();
+// Copy samplesPerFrame recorded samples, starting offset samples after the start of the stream
+void GGWave::decode_recorded(const RxStream & stream, float * dst, int offset, bool accumulate) {
+    const float * src = m_rx.amplitudeRecorded.data();
 
-            m_rx.framesToAnalyze = m_nMarkerFrames*stepsPerFrame;
-            m_rx.framesLeftToAnalyze = m_rx.framesToAnalyze;
+    // the recorded frames are stored in a ring buffer
+    const int nRecorded = m_rx.amplitudeRecorded.size();
 
-            // note : not sure if looping backwards here is more meaningful than looping forwards
-            for (int ii = m_nMarkerFrames*stepsPerFrame - 1; ii >= 0; --ii) {
-                bool knownLength = false;
+    offset = (stream.recordedStart*m_samplesPerFrame + offset) % nRecorded;
 
-                int decodedLength = 0;
-                const int offsetStart = ii;
-                for (int itx = 0; itx < 1024; ++itx) {
-                    int offsetTx = offsetStart + itx*protocol.framesPerTx*stepsPerFrame;
-                    if (offsetTx >= m_rx.recvDuration_frames*stepsPerFrame || (itx + 1)*protocol.bytesPerTx >= (int) m_dataEncoded.size()) {
-                        break;
-                    }
+    const int n0 = GG_MIN(m_samplesPerFrame, nRecorded - offset);
+    for (int i = 0; i < n0; ++i) {
+        dst[i] = accumulate ? dst[i] + src[offset + i] : src[offset + i];
+    }
+    for (int i = n0; i < m_samplesPerFrame; ++i) {
+        dst[i] = accumulate ? dst[i] + src[i - n0] : src[i - n0];
+    }
+}
 
-                    memcpy(m_rx.fftOut.data(),
-                           m_rx.amplitudeRecorded.data() + offsetTx*step,
-                           m_samplesPerFrame*sizeof(float));
+// Demodulate nBytes of a single Tx that starts offset samples after the start of the stream
+//
+//   The tones are detected in the sum of nFrames frames. The mono-tone protocols transmit the low and
+//   the high nibbles of the bytes in two consecutive Txs - both are demodulated, framesPerTx frames
+//   apart. The OFDM blocks are always demodulated whole.
+//
+void GGWave::decode_block(const RxStream & stream, int protocolId, int offset, int nFrames, uint8_t * dst, float * confidence, int nBytes) {
+    const auto & protocol = m_rx.protocols[protocolId];
 
-                    // note : should we skip the first and last frame here as they are amplitude-smoothed?
-                    for (int k = 1; k < protocol.framesPerTx; ++k) {
-                        for (int i = 0; i < m_samplesPerFrame; ++i) {
-                            m_rx.fftOut[i] += m_rx.amplitudeRecorded[(offsetTx + k*stepsPerFrame)*step + i];
-                        }
-                    }
+    const int stepsPerFrame = 16;
+    const int step = m_samplesPerFrame/stepsPerFrame;
 
-                    FFT(m_rx.fftOut.data(), m_samplesPerFrame, m_rx.fftWorkI.data(), m_rx.fftWorkF.data());
+    if (protocol.ofdm) {
+        const int nPrefix = m_samplesPerFrame/protocol.nOFDMSymbols();
 
-                    for (int i = 0; i < m_samplesPerFrame; ++i) {
-                        m_rx.spectrum[i] = (m_rx.fftOut[2*i + 0]*m_rx.fftOut[2*i + 0] + m_rx.fftOut[2*i + 1]*m_rx.fftOut[2*i + 1]);
-                    }
-                    for (int i = 1; i < m_samplesPerFrame/2; ++i) {
-                        m_rx.spectrum[i] += m_rx.spectrum[m_samplesPerFrame - i];
-                    }
+        // each symbol is analyzed after its cyclic prefix - the spectrum holds the subcarriers of the previous one
+        for (int s = 0; s < protocol.nOFDMSymbols(); ++s) {
+            decode_recorded(stream, m_rx.fftOut.data(), offset + s*(m_samplesPerFrame + nPrefix) + nPrefix, false);
 
-                    uint8_t curByte = 0;
-                    for (int i = 0; i < 2*protocol.bytesPerTx; ++i) {
-                        double freq = m_hzPerSample*protocol.freqStart;
-                        int bin = round(freq*m_ihzPerSample) + 16*i;
-
-                        int kmax = 0;
-                        double amax = 0.0;
-                        for (int k = 0; k < 16; ++k) {
-                            if (m_rx.spectrum[bin + k] > amax) {
-                                kmax = k;
-                                amax = m_rx.spectrum[bin + k];
-                            }
-                        }
+            FFT(m_rx.fftOut.data(), m_samplesPerFrame, m_rx.fftWorkI.data(), m_rx.fftWorkF.data());
 
-                        if (i%2) {
-                            curByte += (kmax << 4);
-                            m_dataEncoded[itx*protocol.bytesPerTx + i/2] = curByte;
-                            curByte = 0;
-                        } else {
-                            curByte = kmax;
-                        }
-                    }
+            ::ofdmDemodulate(protocol, m_rx.fftOut.data(), m_rx.spectrum.data(), s, dst, confidence, nBytes);
+        }
 
-                    if (itx*protocol.bytesPerTx > m_encodedDataOffset && knownLength == false) {
-                        RS::ReedSolomon rsLength(1, m_encodedDataOffset - 1, m_workRSLength.data());
-                        if ((rsLength.Decode(m_dataEncoded.data(), m_rx.data.data()) == 0) && (m_rx.data[0] > 0 && m_rx.data[0] <= 140)) {
-                            knownLength = true;
-                            decodedLength = m_rx.data[0];
-                            //printf("decoded length = %d, recvDuration_frames = %d\n", decodedLength, m_rx.recvDuration_frames);
-
-                            const int nTotalBytesExpected = m_encodedDataOffset + decodedLength + ::getECCBytesForLength(decodedLength);
-                            const int nTotalFramesExpected = 2*m_nMarkerFrames + ((nTotalBytesExpected + protocol.bytesPerTx - 1)/protocol.bytesPerTx)*protocol.framesPerTx;
-                            if (m_rx.recvDuration_frames > nTotalFramesExpected ||
-                                m_rx.recvDuration_frames < nTotalFramesExpected - 2*m_nMarkerFrames) {
-                                //printf("  - invalid number of frames: %d (expected %d)\n", m_rx.recvDuration_frames, nTotalFramesExpected);
-                                knownLength = false;
-                                break;
-                            }
-                        } else {
-                            break;
-                        }
-                    }
+        return;
+    }
 
-                    {
-                        const int nTotalBytesExpected = m_encodedDataOffset + decodedLength + ::getECCBytesForLength(decodedLength);
-                        if (knownLength && itx*protocol.bytesPerTx > nTotalBytesExpected + 1) {
-                            break;
-                        }
-                    }
-                }
+    const int binStart = m_rx.bandDataBin[m_rx.bandId[protocolId]];
+    const int nTones   = protocol.nSymbolTones();
+    const int nSpacing = protocol.nBinSpacing();
 
-                if (knownLength) {
-                    RS::ReedSolomon rsData(decodedLength, ::getECCBytesForLength(decodedLength), m_workRSData.data());
+    // a group of nTones tones carries one symbol
+    const int nGroups    = protocol.extra == 1 ? protocol.nSymbolsPerTx() : protocol.bytesPerTx;
+    const int groupDelta = protocol.extra == 1 ? nTones*nSpacing : 2*nTones*nSpacing;
 
-                    if (rsData.Decode(m_dataEncoded.data() + m_encodedDataOffset, m_rx.data.data()) == 0) {
-                        if (decodedLength > 0) {
-                            if (m_isDSSEnabled) {
-                                for (int i = 0; i < decodedLength; ++i) {
-                                    m_rx.data[i] = m_rx.data[i] ^ getDSSMagic(i);
-                                }
-                            }
+    for (int h = 0; h < protocol.extra; ++h) {
+        const int offsetTx = offset + h*protocol.framesPerTx*m_samplesPerFrame;
 
-                            ggprintf("Decoded length = %d, protocol = '%s' (%d)\n", decodedLength, protocol.name, protocolId);
-                            ggprintf("Received sound data successfully: '%s'\n", m_rx.data.data());
+        decode_recorded(stream, m_rx.fftOut.data(), offsetTx, false);
 
-                            isValid = true;
-                            m_rx.hasNewRxData = true;
-                            m_rx.dataLength = decodedLength;
-                            m_rx.protocol = protocol;
-                            m_rx.protocolId = RxProtocolId(protocolId);
-                        }
-                    }
-                }
+        // note : should we skip the first and last frame here as they are amplitude-smoothed?
+        for (int k = 1; k < nFrames; ++k) {
+            decode_recorded(stream, m_rx.fftOut.data(), offsetTx + k*stepsPerFrame*step, true);
+        }
 
-                if (isValid) {
-                    break;
-                }
-                --m_rx.framesLeftToAnalyze;
-            }
+        FFT(m_rx.fftOut.data(), m_samplesPerFrame, m_rx.fftWorkI.data(), m_rx.fftWorkF.data());
 
-            if (isValid) break;
+        for (int i = 0; i < m_samplesPerFrame; ++i) {
+            m_rx.spectrum[i] = (m_rx.fftOut[2*i + 0]*m_rx.fftOut[2*i + 0] + m_rx.fftOut[2*i + 1]*m_rx.fftOut[2*i + 1]);
+        }
+        for (int i = 1; i < m_samplesPerFrame/2; ++i) {
+            m_rx.spectrum[i] += m_rx.spectrum[m_samplesPerFrame - i];
         }
 
-        m_rx.framesToRecord = 0;
+        for (int g = 0; g < nGroups; ++g) {
+            const int bin = binStart + g*groupDelta;
 
-        if (isValid == false) {
-            ggprintf("Failed to capture sound data. Please try again (length = %d)\n", m_rx.data[0]);
-            m_rx.dataLength = -1;
-            m_rx.framesToRecord = -1;
+            float amax, amax2; // peak and runner-up
+            const int kmax = ::argmaxSymbol(m_rx.spectrum.data() + bin, nTones, nSpacing, amax, amax2);
+
+            // the closer the runner-up is to the peak, the less reliable the symbol
+            const float c = amax > 0.0f ? 1.0f - amax2/amax : 0.0f;
+
+            ::addSymbol(dst, confidence, nBytes, protocol.nSymbolBits(), protocol.extra*g + h, kmax, c);
         }
+    }
+}
 
-        m_rx.receiving = false;
-        m_rx.analyzing = false;
+// Payload length from the Reed-Solomon protected header in front of the encoded data, 0 if invalid
+int GGWave::decode_length(const uint8_t * encoded, uint8_t * dst) {
+    RS::ReedSolomon rsLength(1, m_encodedDataOffset - 1, m_workRSLength.data());
 
-        m_rx.spectrum.zero();
+    const int maxLengthByte = m_isLongPayload ? kMaxLengthVariable + kMaxLongBlocks : kMaxLengthVariable;
 
-        m_rx.framesToAnalyze = 0;
-        m_rx.framesLeftToAnalyze = 0;
+    if (rsLength.Check(encoded) < 0 || rsLength.Decode(encoded, dst) != 0 || dst[0] == 0 || dst[0] > maxLengthByte) {
+        return 0;
     }
 
-    // check if receiving data
-    if (m_rx.receiving == false) {
-        bool isReceiving = false;
-
-        for (int i = 0; i < m_rx.protocols.size(); ++i) {
-            const auto & protocol = m_rx.protocols[i];
-            if (protocol.enabled == false) {
-                continue;
-            }
+    int length = dst[0];
 
-            int nDetectedMarkerBits = m_nBitsInMarker;
+    // long payload - the exact length is known after decoding the blocks
+    if (length > kMaxLengthVariable) {
+        length = (length - kMaxLengthVariable)*kLongBlockLength;
+        if (length <= kMaxLengthVariable) {
+            return 0;
+        }
+    }
 
-            for (int i = 0; i < m_nBitsInMarker; ++i) {
-                double freq = bitFreq(protocol, i);
-                int bin = round(freq*m_ihzPerSample);
+    return length;
+}
 
-                if (i%2 == 0) {
-                    if (m_rx.spectrum[bin] <= m_soundMarkerThreshold*m_rx.spectrum[bin + m_freqDelta_bin]) --nDetectedMarkerBits;
-                } else {
-                    if (m_rx.spectrum[bin] >= m_soundMarkerThreshold*m_rx.spectrum[bin + m_freqDelta_bin]) --nDetectedMarkerBits;
-                }
-            }
+// Decode the length header of a stream that started with the short preamble
+//
+//   The header of each candidate protocol is decoded as soon as its first Tx is recorded. The
+//   protocols of a band differ only in the duration of their symbols, so a slower transmission
+//   has a valid header for the faster protocols as well. Therefore, the recording continues
+//   until all candidates are checked and stops at the end of the longest of the transmissions.
+//   The first valid header is usually from the fastest of them. A slower protocol averages
+//   several of its symbols, which sometimes decode to a valid header as well. Therefore, its
+//   header must be decoded again from the last third of its symbols, which is a different
+//   symbol of the faster protocols.
+//
+void GGWave::decode_header(RxStream & stream) {
+    const int nRecordedFrames = stream.framesToRecord - stream.framesLeftToRecord;
+    const int nRecorded = nRecordedFrames*m_samplesPerFrame;
 
-            if (nDetectedMarkerBits == m_nBitsInMarker) {
-                m_rx.markerFreqStart = protocol.freqStart;
-                isReceiving = true;
-                break;
-            }
+    int nNeededMax = 0;
+    for (int protocolId = 0; protocolId < (int) m_rx.protocols.size(); ++protocolId) {
+        const auto & protocol = m_rx.protocols[protocolId];
+        if (protocol.enabled == false || m_rx.bandId[protocolId] < 0 || protocol.freqStart != stream.markerFreqStart) {
+            continue;
         }
 
-        if (isReceiving) {
-            if (++m_rx.nMarkersSuccess >= 1) {
-            } else {
-                isReceiving = false;
-            }
-        } else {
-            m_rx.nMarkersSuccess = 0;
+        const int nTxs = (m_encodedDataOffset + protocol.bytesPerTx - 1)/protocol.bytesPerTx;
+        const int samplesPerTx = protocol.framesPerTx*protocol.extra*m_samplesPerFrame;
+
+        const int nNeeded = stream.dataOffset + nTxs*samplesPerTx;
+        nNeededMax = GG_MAX(nNeededMax, nNeeded);
+
+        // the header was checked in one of the previous frames or is not recorded yet
+        if (nNeeded <= nRecorded - m_samplesPerFrame || nNeeded > nRecorded) {
+            continue;
         }
 
-        if (isReceiving) {
-            ggprintf("Receiving sound data ...\n");
+        const auto decodeHeader = [&](int nSkip, int nFrames) {
+            m_rx.spectrum.zero();
 
-            m_rx.receiving = true;
-            m_rx.data.zero();
+            for (int itx = 0; itx < nTxs; ++itx) {
+                const int nBytes = GG_MIN((int) protocol.bytesPerTx, (int) m_dataEncoded.size() - itx*protocol.bytesPerTx);
 
-            // max recieve duration
-            m_rx.recvDuration_frames =
-                2*m_nMarkerFrames +
-                maxFramesPerTx(m_rx.protocols, true)*(
-                        (kMaxLengthVariable + ::getECCBytesForLength(kMaxLengthVariable))/minBytesPerTx(m_rx.protocols) + 1
-                        );
+                decode_block(stream, protocolId, stream.dataOffset + itx*samplesPerTx + nSkip*m_samplesPerFrame, nFrames,
+                             m_dataEncoded.data() + itx*protocol.bytesPerTx, m_rx.confidence.data() + itx*protocol.bytesPerTx, nBytes);
+            }
+
+            return decode_length(m_dataEncoded.data(), stream.data.data());
+        };
 
-            m_rx.nMarkersSuccess = 0;
-            m_rx.framesToRecord = m_rx.recvDuration_frames;
-            m_rx.framesLeftToRecord = m_rx.recvDuration_frames;
+        const int length = decodeHeader(0, protocol.framesPerTx);
+        if (length == 0) {
+            continue;
         }
-    } else {
-        bool isEnded = false;
 
-        for (int i = 0; i < m_rx.protocols.size(); ++i) {
-            const auto & protocol = m_rx.protocols[i];
-            if (protocol.enabled == false) {
+        if (stream.headerLength > 0 && protocol.ofdm == false) {
+            const int nThird = GG_MAX(1, protocol.framesPerTx/3);
+            if (length != stream.headerLength || decodeHeader(protocol.framesPerTx - nThird, nThird) != length) {
                 continue;
             }
+        }
 
-            int nDetectedMarkerBits = m_nBitsInMarker;
+        stream.headerLength = length;
 
-            for (int i = 0; i < m_nBitsInMarker; ++i) {
-                double freq = bitFreq(protocol, i);
-                int bin = round(freq*m_ihzPerSample);
+        const int nTotalBytes = m_encodedDataOffset + ::getEncodedLength(length);
+        // the analysis may start up to kPreambleSearchSteps later
+        const int nSearch = kPreambleSearchSteps*(m_samplesPerFrame/16);
+        const int nTotal = stream.dataOffset + nSearch + ((nTotalBytes + protocol.bytesPerTx - 1)/protocol.bytesPerTx)*samplesPerTx;
 
-                if (i%2 == 0) {
-                    if (m_rx.spectrum[bin] >= m_soundMarkerThreshold*m_rx.spectrum[bin + m_freqDelta_bin]) nDetectedMarkerBits--;
-                } else {
-                    if (m_rx.spectrum[bin] <= m_soundMarkerThreshold*m_rx.spectrum[bin + m_freqDelta_bin]) nDetectedMarkerBits--;
-                }
-            }
+        stream.headerFrames = GG_MAX(stream.headerFrames, (nTotal + m_samplesPerFrame - 1)/m_samplesPerFrame);
+    }
 
-            if (nDetectedMarkerBits == m_nBitsInMarker) {
-                isEnded = true;
-                break;
-            }
-        }
+    if (nRecorded < nNeededMax) {
+        return;
+    }
 
-        if (isEnded) {
-            if (++m_rx.nMarkersSuccess >= 1) {
-            } else {
-                isEnded = false;
-            }
-        } else {
-            m_rx.nMarkersSuccess = 0;
-        }
+    stream.hasHeader = true;
 
-        if (isEnded && m_rx.framesToRecord > 1) {
-            m_rx.recvDuration_frames -= m_rx.framesLeftToRecord - 1;
-            ggprintf("Received end marker. Frames left = %d, recorded = %d\n", m_rx.framesLeftToRecord, m_rx.recvDuration_frames);
-            m_rx.nMarkersSuccess = 0;
-            m_rx.framesLeftToRecord = 1;
-        }
+    // without a valid header, the analysis reports the failure
+    const int nFrames = GG_MIN(GG_MAX(stream.headerFrames, nRecordedFrames), stream.framesToRecord);
+
+    ggprintf("Decoded length header. Frames to record = %d, recorded = %d\n", nFrames, nRecordedFrames);
+
+    stream.recvDuration_frames = nFrames;
+    stream.framesToRecord      = nFrames;
+    stream.framesLeftToRecord  = nFrames - nRecordedFrames;
+
+    if (stream.framesLeftToRecord <= 0 || stream.headerFrames == 0) {
+        stream.framesLeftToRecord = 0;
+        stream.analyzing = true;
     }
 }
 
 //
 // Fixed payload length
 
-void GGWave::decode_fixed() {
+#ifdef GGWAVE_CONFIG_FIXED_POINT
+void GGWave::decode_spectrumQ15() {
+    const int n = m_samplesPerFrame;
+    const int m = n/2;
+
+    int log2n = 0;
+    while ((1 << log2n) < n) {
+        ++log2n;
+    }
+
+    const int shift = ::powerSpectrumQ15(m_rx.amplitude.data(), m_rx.fftQ15.data(), m_rx.powerQ15.data(), log2n);
+    const auto & power = m_rx.powerQ15;
+
+    uint32_t amax = 0;
+    for (int i = GG_MAX(1, m_rx.minFreqStart); i < m; ++i) {
+        amax = GG_MAX(amax, power[i]);
+    }
+
+    // uint32_t -> uint8_t, with the same rounding as the floating-point path
+    // 255*power has to fit in 32 bits
+    int sh = 0;
+    while ((amax >> sh) >= (uint32_t(1) << 24)) {
+        ++sh;
+    }
+    const uint32_t a = GG_MAX(uint32_t(1), amax >> sh);
+
+    // rxSpectrum() is in the units of the floating-point path
+    const float norm  = float(n)/32768.0f/(shift < 0 ? 0.5f : float(1 << shift));
+    const float scale = norm*norm;
+
+    // as with rdft(), bin 0 also holds the Nyquist frequency and bins [n/2, n) are empty
+    for (int i = 0; i < m; ++i) {
+        const uint32_t p = i == 0 ? power[0] + power[m] : power[i];
+        const uint32_t q = GG_MIN(p >> sh, a);
+
+        m_rx.spectrumFixed[i] = (255*q + a/2)/a;
+        m_rx.spectrum[i]      = scale*p;
+    }
+
+    for (int i = m; i < n; ++i) {
+        m_rx.spectrumFixed[i] = 0;
+        m_rx.spectrum[i]      = 0.0f;
+    }
+}
+#endif
+
+void GGWave::decode_fixed(GGWave * frontEnd) {
     m_rx.hasNewSpectrum = true;
 
-    // calculate spectrum
-    FFT(m_rx.amplitude.data(), m_rx.fftOut.data(), m_samplesPerFrame, m_rx.fftWorkI.data(), m_rx.fftWorkF.data());
+    bool isQuantized = false;
 
-    float amax = 0.0f;
-    for (int i = 0; i < m_samplesPerFrame; ++i) {
-        m_rx.spectrum[i] = (m_rx.fftOut[2*i + 0]*m_rx.fftOut[2*i + 0] + m_rx.fftOut[2*i + 1]*m_rx.fftOut[2*i + 1]);
+#ifdef GGWAVE_CONFIG_FIXED_POINT
+    // the spectra of a front-end and the sum of the channel spectra are computed in floating point
+    if (frontEnd == nullptr && (m_channelsInp == 1 || m_channelMode != GGWAVE_CHANNEL_MODE_SUM_SPECTRA)) {
+        decode_spectrumQ15();
+        isQuantized = true;
     }
-    for (int i = 1; i < m_samplesPerFrame/2; ++i) {
-        m_rx.spectrum[i] += m_rx.spectrum[m_samplesPerFrame - i];
-        if (i >= m_rx.minFreqStart) {
-            amax = GG_MAX(amax, m_rx.spectrum[i]);
+#endif
+
+    if (isQuantized == false) {
+        if (frontEnd) {
+            memcpy(m_rx.spectrum.data(), frontEnd->decode_sharedSpectrum(false), m_samplesPerFrame*sizeof(float));
+        } else {
+            decode_spectrum(false, m_rx.spectrum.data());
         }
-    }
 
-    // original, floating-point version
-    //m_rx.spectrumHistoryFixed[m_rx.historyIdFixed].copy(m_rx.spectrum);
+        float amax = 0.0f;
+        for (int i = GG_MAX(1, m_rx.minFreqStart); i < m_samplesPerFrame/2; ++i) {
+            amax = GG_MAX(amax, m_rx.spectrum[i]);
+        }
 
-    // float -> uint8_t
-    amax = 255.0f/(amax == 0.0f ? 1.0f : amax);
-    for (int i = 0; i < m_samplesPerFrame; ++i) {
-        m_rx.spectrumHistoryFixed[m_rx.historyIdFixed][i] = GG_MIN(255.0f, GG_MAX(0.0f, (float) round(m_rx.spectrum[i]*amax)));
+        // float -> uint8_t
+        amax = 255.0f/(amax == 0.0f ? 1.0f : amax);
+        for (int i = 0; i < m_samplesPerFrame; ++i) {
+            m_rx.spectrumFixed[i] = GG_MIN(255.0f, GG_MAX(0.0f, (float) round(m_rx.spectrum[i]*amax)));
+        }
     }
 
-    // float -> uint16_t
-    //amax = 65535.0f/(amax == 0.0f ? 1.0f : amax);
-    //for (int i = 0; i < m_samplesPerFrame; ++i) {
-    //    m_rx.spectrumHistoryFixed[m_rx.historyIdFixed][i] = GG_MIN(65535.0f, GG_MAX(0.0f, (float) round(m_rx.spectrum[i]*amax)));
-    //}
+    const int nHistory = m_rx.historySizeFixed;
+    const int nFrames  = m_rx.framesFixed; // frames before the current one
 
-    if (++m_rx.historyIdFixed >= (int) m_rx.spectrumHistoryFixed.size()) {
+    const int frameId = m_rx.historyIdFixed;
+    if (++m_rx.historyIdFixed >= nHistory) {
         m_rx.historyIdFixed = 0;
     }
+    m_rx.framesFixed = GG_MIN(nFrames + 1, nHistory);
+
+    // when locked, only the frame at the end of the next payload is decoded
+    const bool isLocked    = rxLocked();
+    const bool isAcquiring = isLocked && m_rx.lockRun > 0;
+    const bool isSkipped   = isLocked && isAcquiring == false && --m_rx.framesToBoundary > 0;
+
+    const int totalLength = m_payloadLength + getECCBytesForLength(m_payloadLength);
 
     bool isValid = false;
     for (int protocolId = 0; protocolId < (int) m_rx.protocols.size(); ++protocolId) {
         const auto & protocol = m_rx.protocols[protocolId];
-        if (protocol.enabled == false) {
+        const int slot = m_rx.slotsFixed[protocolId];
+        if (protocol.enabled == false || slot < 0) {
             continue;
         }
 
         const int binStart = protocol.freqStart;
-        const int binDelta = 16;
-        const int binOffset = protocol.extra == 1 ? binDelta : 0;
+        const int binDelta = protocol.nBinSpacing();
+        const int nTones   = protocol.nSymbolTones();
 
         if (binStart > m_samplesPerFrame) {
             continue;
         }
 
-        const int totalLength = m_payloadLength + getECCBytesForLength(m_payloadLength);
-        const int totalTxs = protocol.extra*((totalLength + protocol.bytesPerTx - 1)/protocol.bytesPerTx);
-
-        int historyStartId = m_rx.historyIdFixed - totalTxs*protocol.framesPerTx;
-        if (historyStartId < 0) {
-            historyStartId += m_rx.spectrumHistoryFixed.size();
-        }
+        // a group of nTones tones carries one symbol - the MT protocols transmit one nibble per byte at a time
+        const int nGroups      = protocol.extra == 1 ? protocol.nSymbolsPerTx() : protocol.bytesPerTx;
+        const int groupDelta   = protocol.extra == 1 ? nTones*binDelta : 2*nTones*binDelta;
+        const int framesPerTx  = protocol.framesPerTx;
+        const int totalTxs     = protocol.extra*((totalLength + protocol.bytesPerTx - 1)/protocol.bytesPerTx);
+        const int framesWindow = totalTxs*framesPerTx;
 
-        const int nTones = 2*protocol.bytesPerTx;
-        m_rx.detectedBins.zero();
+        // row of the frame that arrived framesAgo frames before the current one
+        const auto row = [&](int framesAgo) {
+            return slot*nHistory + (frameId - framesAgo + nHistory)%nHistory;
+        };
 
-        int txNeededTotal   = 0;
-        int txDetectedTotal = 0;
-        bool detectedSignal = true;
+        auto tones    = m_rx.tonesFixed[row(0)];
+        auto majority = m_rx.majorityFixed[row(0)];
+        auto votesMax = m_rx.votesMaxFixed[row(0)];
+        auto votes    = m_rx.votesFixed[slot];
 
-        for (int k = 0; k < totalTxs; ++k) {
-            if (k % protocol.extra == 0) {
-                m_rx.detectedTones.zero(16*nTones);
-            }
+        // slide the voting window by one frame
+        const auto tonesOld = nFrames >= framesPerTx ? m_rx.tonesFixed[row(framesPerTx)].data() : nullptr;
+        const int nDetected = ::voteFixed(m_rx.spectrumFixed.data() + binStart, nTones, nGroups, binDelta, groupDelta, framesPerTx,
+                                          votes.data(), tones.data(), tonesOld, majority.data(), votesMax.data());
 
-            for (int i = 0; i < protocol.framesPerTx; ++i) {
-                int historyId = historyStartId + k*protocol.framesPerTx + i;
-                if (historyId >= (int) m_rx.spectrumHistoryFixed.size()) {
-                    historyId -= m_rx.spectrumHistoryFixed.size();
-                }
+        // detected groups in the windows that end 0, framesPerTx, 2*framesPerTx, ... frames ago
+        int & detectedTotal = m_rx.detectedFixed[row(0)];
+        detectedTotal = nDetected;
 
-                for (int j = 0; j < protocol.bytesPerTx; ++j) {
-                    int f0bin = 0;
-                    auto f0max = m_rx.spectrumHistoryFixed[historyId][binStart + 2*j*binDelta];
+        if (nFrames >= framesPerTx) {
+            detectedTotal += m_rx.detectedFixed[row(framesPerTx)];
+        }
 
-                    for (int b = 1; b < 16; ++b) {
-                        {
-                            const auto & v = m_rx.spectrumHistoryFixed[historyId][binStart + 2*j*binDelta + b];
+        if (nFrames >= framesWindow) {
+            auto majorityOld = m_rx.majorityFixed[row(framesWindow)];
+            for (int g = 0; g < nGroups; ++g) {
+                detectedTotal -= majorityOld[g] < nTones;
+            }
+        }
 
-                            if (f0max <= v) {
-                                f0max = v;
-                                f0bin = b;
-                            }
-                        }
-                    }
+        // the vote counts of all protocols are kept up to date, but only one payload is decoded per frame
+        if (isValid || isSkipped || (isLocked && protocolId != m_rx.lockedProtocolId) || nFrames + 1 < framesWindow) {
+            continue;
+        }
 
-                    int f1bin = 0;
-                    if (protocol.extra == 1) {
-                        auto f1max = m_rx.spectrumHistoryFixed[historyId][binStart + 2*j*binDelta + binOffset];
-                        for (int b = 1; b < 16; ++b) {
-                            const auto & v = m_rx.spectrumHistoryFixed[historyId][binStart + 2*j*binDelta + binOffset + b];
+        // the padding after the last byte does not count towards the detected tones
+        int txDetectedTotal = detectedTotal;
+        {
+            const int nTxBytes = totalTxs/protocol.extra;
+            const auto lo = m_rx.majorityFixed[row((protocol.extra - 1)*framesPerTx)];
+            const auto hi = m_rx.majorityFixed[row(0)];
 
-                            if (f1max <= v) {
-                                f1max = v;
-                                f1bin = b;
-                            }
-                        }
-                    } else {
-                        f1bin = f0bin;
-                    }
+            const int nBits = protocol.nSymbolBits();
+            const int nPadding = totalLength - (nTxBytes - 1)*protocol.bytesPerTx;
 
-                    if ((k + 0)%protocol.extra == 0) m_rx.detectedTones[(2*j + 0)*16 + f0bin]++;
-                    if ((k + 1)%protocol.extra == 0) m_rx.detectedTones[(2*j + 1)*16 + f1bin]++;
+            if (protocol.extra == 1) {
+                // the symbols that carry only padding bits
+                for (int g = (8*nPadding + nBits - 1)/nBits; g < nGroups; ++g) {
+                    txDetectedTotal -= lo[g] < nTones;
+                }
+            } else {
+                for (int j = nPadding; j < protocol.bytesPerTx; ++j) {
+                    txDetectedTotal -= (lo[j] < nTones) + (hi[j] < nTones);
                 }
             }
+        }
 
-            if (protocol.extra > 1 && (k % protocol.extra == 0)) continue;
+        if (txDetectedTotal < 0.75*(8*totalLength)/protocol.nSymbolBits()) {
+            continue;
+        }
 
-            int txNeeded = 0;
-            int txDetected = 0;
-            for (int j = 0; j < protocol.bytesPerTx; ++j) {
-                if ((k/protocol.extra)*protocol.bytesPerTx + j >= totalLength) break;
-                txNeeded += 2;
-                for (int b = 0; b < 16; ++b) {
-                    if (m_rx.detectedTones[(2*j + 0)*16 + b] > protocol.framesPerTx/2) {
-                        m_rx.detectedBins[2*((k/protocol.extra)*protocol.bytesPerTx + j) + 0] = b;
-                        txDetected++;
-                    }
-                    if (m_rx.detectedTones[(2*j + 1)*16 + b] > protocol.framesPerTx/2) {
-                        m_rx.detectedBins[2*((k/protocol.extra)*protocol.bytesPerTx + j) + 1] = b;
-                        txDetected++;
-                    }
+        for (int k = 0; k < totalTxs; k += protocol.extra) {
+            const int rowLo = row((totalTxs - 1 - k)*framesPerTx);
+            const int rowHi = row((totalTxs - k - protocol.extra)*framesPerTx);
+
+            const int i0 = (k/protocol.extra)*protocol.bytesPerTx;
+
+            // the number of votes for the winning tones is the confidence of the byte
+            if (protocol.extra == 1) {
+                for (int g = 0; g < nGroups; ++g) {
+                    const int bin = m_rx.majorityFixed[rowLo][g];
+
+                    ::addSymbol(m_dataEncoded.data() + i0, m_rx.confidence.data() + i0, totalLength - i0,
+                                protocol.nSymbolBits(), g, bin < nTones ? bin : 0, m_rx.votesMaxFixed[rowLo][g]);
                 }
+
+                continue;
             }
 
-            txDetectedTotal += txDetected;
-            txNeededTotal += txNeeded;
-        }
+            for (int j = 0; j < protocol.bytesPerTx; ++j) {
+                const int i = i0 + j;
+                if (i >= totalLength) break;
 
-        if (txDetectedTotal < 0.75*txNeededTotal) {
-            detectedSignal = false;
+                const int binLo = m_rx.majorityFixed[rowLo][j];
+                const int binHi = m_rx.majorityFixed[rowHi][j];
+
+                m_dataEncoded[i]   = ((binHi < nTones ? binHi : 0) << 4) + (binLo < nTones ? binLo : 0);
+                m_rx.confidence[i] = GG_MIN(m_rx.votesMaxFixed[rowLo][j], m_rx.votesMaxFixed[rowHi][j]);
+            }
         }
 
-        if (detectedSignal) {
-            RS::ReedSolomon rsData(m_payloadLength, getECCBytesForLength(m_payloadLength), m_workRSData.data());
+        RS::ReedSolomon rsData(m_payloadLength, getECCBytesForLength(m_payloadLength), m_workRSData.data());
 
-            for (int j = 0; j < totalLength; ++j) {
-                m_dataEncoded[j] = (m_rx.detectedBins[2*j + 1] << 4) + m_rx.detectedBins[2*j + 0];
+        if (::decodeRS(rsData, m_dataEncoded.data(), m_rx.data.data(), m_rx.confidence.data(), m_rx.erasures.data()) == 0) {
+            if (m_isDSSEnabled) {
+                for (int i = 0; i < m_payloadLength; ++i) {
+                    m_rx.data[i] = m_rx.data[i] ^ getDSSMagic(i);
+                }
             }
 
-            if (rsData.Decode(m_dataEncoded.data(), m_rx.data.data()) == 0) {
-                if (m_isDSSEnabled) {
-                    for (int i = 0; i < m_payloadLength; ++i) {
-                        m_rx.data[i] = m_rx.data[i] ^ getDSSMagic(i);
-                    }
-                }
+            isValid = true;
 
+            // while acquiring the lock, this is the same payload decoded from a shifted window
+            if (isAcquiring == false) {
                 ggprintf("Decoded length = %d, protocol = '%s' (%d)\n", m_payloadLength, protocol.name, protocolId);
                 ggprintf("Received sound data successfully: '%s'\n", m_rx.data.data());
 
-                isValid = true;
                 m_rx.hasNewRxData = true;
                 m_rx.dataLength = m_payloadLength;
                 m_rx.protocol = protocol;
                 m_rx.protocolId = RxProtocolId(protocolId);
+
+                // the next payload ends exactly one payload duration later
+                if (m_isRxContinuous) {
+                    m_rx.lockedProtocolId = RxProtocolId(protocolId);
+                    m_rx.lockFrames       = totalTxs*protocol.framesPerTx;
+                    m_rx.framesToBoundary = m_rx.lockFrames;
+                    m_rx.lockRun          = isLocked ? 0 : 1;
+                }
             }
         }
+    }
 
+    if (isAcquiring) {
         if (isValid) {
-            break;
+            ++m_rx.lockRun;
+        }
+
+        // the first payload decodes from a few consecutive windows - lock on the middle one
+        if (isValid == false || m_rx.lockRun >= m_rx.protocols[m_rx.lockedProtocolId].framesPerTx) {
+            const int nSinceFirst = isValid ? m_rx.lockRun - 1 : m_rx.lockRun;
+
+            m_rx.framesToBoundary = m_rx.lockFrames + (m_rx.lockRun - 1)/2 - nSinceFirst;
+            m_rx.lockRun = 0;
         }
+    } else if (isLocked && isSkipped == false && isValid == false) {
+        ggprintf("Lost lock on the continuous transmission\n");
+        m_rx.lockedProtocolId = GGWAVE_PROTOCOL_COUNT;
+        m_rx.framesToBoundary = 0;
     }
 }
 
-int GGWave::maxFramesPerTx(const Protocols & protocols, bool excludeMT) const {
+int GGWave::maxRecordedFrames() const {
+    return m_isLongPayload ? kMaxRecordedFramesLong : kMaxRecordedFrames;
+}
+
+int GGWave::maxFramesPerTx(const Protocols & protocols) const {
     int res = 0;
     for (int i = 0; i < protocols.size(); ++i) {
         const auto & protocol = protocols[i];
         if (protocol.enabled == false) {
             continue;
         }
-        if (excludeMT && protocol.extra > 1) {
-            continue;
-        }
         res = GG_MAX(res, protocol.framesPerTx*protocol.extra);
     }
     return res;
@@ -2095,6 +4765,40 @@ int GGWave::maxTonesPerTx(const Protocols & protocols) const {
     return res;
 }
 
+int GGWave::maxSymbolsPerTx(const Protocols & protocols) const {
+    int res = 1;
+    for (int i = 0; i < protocols.size(); ++i) {
+        const auto & protocol = protocols[i];
+        if (protocol.enabled == false || protocol.ofdm) {
+            continue;
+        }
+        res = GG_MAX(res, protocol.nSymbolsPerTx());
+    }
+    return res;
+}
+
+// the tone tables also hold the marker tones, the OFDM protocols do not use them
+int GGWave::maxDataBins(const Protocols & protocols) const {
+    int res = 2*m_nBitsInMarker;
+    for (int i = 0; i < protocols.size(); ++i) {
+        const auto & protocol = protocols[i];
+        if (protocol.enabled == false || protocol.ofdm) {
+            continue;
+        }
+        res = GG_MAX(res, protocol.nDataBins());
+    }
+    return res;
+}
+
+bool GGWave::anyOFDM(const Protocols & protocols) const {
+    for (int i = 0; i < protocols.size(); ++i) {
+        if (protocols[i].enabled && protocols[i].ofdm) {
+            return true;
+        }
+    }
+    return false;
+}
+
 int GGWave::minFreqStart(const Protocols & protocols) const {
     int res = m_samplesPerFrame;
     for (int i = 0; i < protocols.size(); ++i) {
@@ -12,6 +12,26 @@
 #include <string.h>
 #include <assert.h>
 
+// gg : SIMD kernels for the RS hot loops - define RS_NO_SIMD to force the scalar code
+#if !defined(ARDUINO) && !defined(RS_NO_SIMD)
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define RS_SIMD_AVX2
+#define RS_SIMD_SSSE3
+#define RS_SIMD_SSE2
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#define RS_SIMD_SSSE3
+#define RS_SIMD_SSE2
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define RS_SIMD_SSE2
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define RS_SIMD_NEON
+#endif
+#endif
+
 namespace RS {
 
 namespace gf {
@@ -248,6 +268,157 @@ poly_eval(const Poly *p, uint16_t x) {
     return y;
 }
 
+/* ##################
+ * # VECTOR KERNELS #
+ * ################## */
+
+// gg : multiplication by a constant c with split-nibble tables:
+//      c*x == lo[x & 0xf] ^ hi[x >> 4], where lo[i] = c*i and hi[i] = c*(i << 4)
+//      a 16-entry table lookup is a single byte shuffle (pshufb / tbl)
+#if defined(RS_SIMD_SSSE3) || defined(RS_SIMD_NEON)
+struct NibbleTables {
+    uint8_t data[256][32];
+
+    NibbleTables() {
+        for(int c = 0; c < 256; c++) {
+            for(int i = 0; i < 16; i++) {
+                data[c][i]      = mul(c, i);
+                data[c][16 + i] = mul(c, i << 4);
+            }
+        }
+    }
+};
+
+inline const uint8_t * nibble_tables(uint8_t c) {
+    static const NibbleTables tables;
+    return tables.data[c];
+}
+#endif
+
+/* @brief Multiply-accumulate of a vector by a scalar: dst[i] ^= c * src[i]
+ * @param *dst - destination vector
+ * @param *src - source vector, must not overlap with dst
+ * @param c    - scalar
+ * @param n    - vectors length */
+inline void
+vec_mul_acc(uint8_t *dst, const uint8_t *src, uint8_t c, uint16_t n) {
+    if(c == 0) return;
+
+    uint16_t i = 0;
+
+#if defined(RS_SIMD_AVX2)
+    {
+        const uint8_t *t = nibble_tables(c);
+        const __m256i tlo = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *) (t)));
+        const __m256i thi = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *) (t + 16)));
+        const __m256i m4  = _mm256_set1_epi8(0x0f);
+        for(; i + 32 <= n; i += 32) {
+            const __m256i x = _mm256_loadu_si256((const __m256i *) (src + i));
+            const __m256i p = _mm256_xor_si256(
+                    _mm256_shuffle_epi8(tlo, _mm256_and_si256(x, m4)),
+                    _mm256_shuffle_epi8(thi, _mm256_and_si256(_mm256_srli_epi64(x, 4), m4)));
+            _mm256_storeu_si256((__m256i *) (dst + i), _mm256_xor_si256(_mm256_loadu_si256((const __m256i *) (dst + i)), p));
+        }
+    }
+#endif
+
+#if defined(RS_SIMD_SSSE3)
+    {
+        const uint8_t *t = nibble_tables(c);
+        const __m128i tlo = _mm_loadu_si128((const __m128i *) (t));
+        const __m128i thi = _mm_loadu_si128((const __m128i *) (t + 16));
+        const __m128i m4  = _mm_set1_epi8(0x0f);
+        for(; i + 16 <= n; i += 16) {
+            const __m128i x = _mm_loadu_si128((const __m128i *) (src + i));
+            const __m128i p = _mm_xor_si128(
+                    _mm_shuffle_epi8(tlo, _mm_and_si128(x, m4)),
+                    _mm_shuffle_epi8(thi, _mm_and_si128(_mm_srli_epi64(x, 4), m4)));
+            _mm_storeu_si128((__m128i *) (dst + i), _mm_xor_si128(_mm_loadu_si128((const __m128i *) (dst + i)), p));
+        }
+    }
+#elif defined(RS_SIMD_NEON)
+    {
+        const uint8_t *t = nibble_tables(c);
+        const uint8x16_t tlo = vld1q_u8(t);
+        const uint8x16_t thi = vld1q_u8(t + 16);
+        const uint8x16_t m4  = vdupq_n_u8(0x0f);
+        for(; i + 16 <= n; i += 16) {
+            const uint8x16_t x = vld1q_u8(src + i);
+            const uint8x16_t p = veorq_u8(vqtbl1q_u8(tlo, vandq_u8(x, m4)), vqtbl1q_u8(thi, vshrq_n_u8(x, 4)));
+            vst1q_u8(dst + i, veorq_u8(vld1q_u8(dst + i), p));
+        }
+    }
+#endif
+
+    for(; i < n; i++) {
+        dst[i] ^= mul(src[i], c);
+    }
+}
+
+/* @brief Evaluation of polynomial in the first n powers of 2: dst[j] = p(2^j)
+ * @param *p   - polynomial coefficients, highest degree first
+ * @param len  - polynomial length, at least 1
+ * @param *dst - destination                (n size)
+ * @param n    - number of evaluation points */
+inline void
+vec_eval_pow2(const uint8_t *p, uint16_t len, uint8_t *dst, uint16_t n) {
+    uint16_t j = 0;
+
+    // gg : Horner's rule in all points at once - every lane multiplies by its own constant 2^j,
+    //      so the product is bit-sliced: y*2^j == XOR over the set bits b of y of 2^(j + b)
+#if defined(RS_SIMD_SSE2)
+    for(; j < n; j += 16) {
+        __m128i a[8];
+        for(int b = 0; b < 8; b++) {
+            a[b] = _mm_loadu_si128((const __m128i *) (exp + j + b));
+        }
+
+        __m128i y = _mm_set1_epi8((char) p[0]);
+        for(uint16_t k = 1; k < len; k++) {
+            __m128i r = _mm_set1_epi8((char) p[k]);
+            for(int b = 0; b < 8; b++) {
+                const __m128i bit = _mm_set1_epi8((char) (1 << b));
+                r = _mm_xor_si128(r, _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(y, bit), bit), a[b]));
+            }
+            y = r;
+        }
+
+        uint8_t tmp[16];
+        _mm_storeu_si128((__m128i *) tmp, y);
+        memcpy(dst + j, tmp, n - j < 16 ? n - j : 16);
+    }
+#elif defined(RS_SIMD_NEON)
+    for(; j < n; j += 16) {
+        uint8x16_t a[8];
+        for(int b = 0; b < 8; b++) {
+            a[b] = vld1q_u8(exp + j + b);
+        }
+
+        uint8x16_t y = vdupq_n_u8(p[0]);
+        for(uint16_t k = 1; k < len; k++) {
+            uint8x16_t r = vdupq_n_u8(p[k]);
+            for(int b = 0; b < 8; b++) {
+                r = veorq_u8(r, vandq_u8(vtstq_u8(y, vdupq_n_u8(1 << b)), a[b]));
+            }
+            y = r;
+        }
+
+        uint8_t tmp[16];
+        vst1q_u8(tmp, y);
+        memcpy(dst + j, tmp, n - j < 16 ? n - j : 16);
+    }
+#endif
+
+    for(; j < n; j++) {
+        const uint8_t x = pow(2, j);
+        uint8_t y = p[0];
+        for(uint16_t k = 1; k < len; k++) {
+            y = mul(y, x) ^ p[k];
+        }
+        dst[j] = y;
+    }
+}
+
 } /* end of gf namespace */
 
 }
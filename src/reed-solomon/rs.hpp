@@ -19,6 +19,47 @@ namespace RS {
 #define MSG_CNT 3   // message-length polynomials count
 #define POLY_CNT 14 // (ecc_length*2)-length polynomialc count
 
+// gg : process-wide, read-only cache of the generator polynomials
+//      the generator depends only on ecc_length, so it is built once for all ReedSolomon objects
+//      disabled on Arduino to save RAM - each object builds its own generator there
+#define RS_GENERATOR_CACHE_MAX_ECC 64
+
+#ifndef ARDUINO
+struct GeneratorCache {
+    uint8_t data[(RS_GENERATOR_CACHE_MAX_ECC*(RS_GENERATOR_CACHE_MAX_ECC + 3))/2];
+
+    static int offset(int ecc_length) { return ((ecc_length - 1)*(ecc_length + 2))/2; }
+
+    GeneratorCache() {
+        for(int ecc_length = 1; ecc_length <= RS_GENERATOR_CACHE_MAX_ECC; ecc_length++) {
+            uint8_t *gen = data + offset(ecc_length);
+
+            // same as ReedSolomon::GeneratorPoly() - multiply by (x - 2^i) in place
+            gen[0] = 1;
+            for(int i = 0; i < ecc_length; i++) {
+                const uint8_t a = gf::pow(2, i);
+                gen[i + 1] = gf::mul(gen[i], a);
+                for(int j = i; j > 0; j--) {
+                    gen[j] ^= gf::mul(gen[j - 1], a);
+                }
+            }
+        }
+    }
+};
+#endif
+
+inline const uint8_t * SharedGeneratorPoly(uint8_t ecc_length) {
+#ifndef ARDUINO
+    if(ecc_length > 0 && ecc_length <= RS_GENERATOR_CACHE_MAX_ECC) {
+        static const GeneratorCache cache;
+        return cache.data + GeneratorCache::offset(ecc_length);
+    }
+#else
+    (void) ecc_length;
+#endif
+    return nullptr;
+}
+
 class ReedSolomon {
 public:
     const uint8_t msg_length;
@@ -29,8 +70,11 @@ public:
     bool owns_heap_memory = false;
     bool generator_cached = false;
 
+    // gg : number of errors found outside of the erasures by the last decoding
+    size_t errors_found = 0;
+
     // used to pre-allocate a memory buffer for the Reed-Solomon class in order to avoid memory allocations
-    static size_t getWorkSize_bytes(uint8_t msg_length, uint8_t ecc_length) {
+    static constexpr size_t getWorkSize_bytes(uint8_t msg_length, uint8_t ecc_length) {
         return ecc_length + 1 + MSG_CNT * msg_length + POLY_CNT * ecc_length * 2;
     }
 
@@ -105,8 +149,11 @@ public:
         msg_out->Reset();
 
         // Using cached generator or generating new one
+        const uint8_t *shared = nullptr;
         if(generator_cached) {
             gen->Set(generator_cache, ecc_length + 1);
+        } else if((shared = SharedGeneratorPoly(ecc_length)) != nullptr) {
+            gen->Set(shared, ecc_length + 1);
         } else {
             GeneratorPoly();
             memcpy(generator_cache, gen->ptr(), gen->length);
@@ -122,11 +169,8 @@ public:
         uint8_t coef = 0; // cache
         for(uint8_t i = 0; i < msg_length; i++){
             coef = msg_out->at(i);
-            if(coef != 0){
-                for(uint32_t j = 1; j < gen->length; j++){
-                    msg_out->at(i+j) ^= gf::mul(gen->at(j), coef);
-                }
-            }
+            // gg : vectorized msg_out[i+j] ^= gen[j]*coef
+            gf::vec_mul_acc(msg_out->ptr() + i + 1, gen->ptr() + 1, coef, gen->length - 1);
         }
 
         // Copying ECC to the output buffer
@@ -152,8 +196,9 @@ public:
      * @param *msg_out     - output buffer            (msg_length size at least)
      * @param *erase_pos   - known errors positions
      * @param erase_count  - count of known errors
+     * @param max_errors   - gg : fail, without writing to the output buffer, if more errors are found outside the erasures
      * @return RESULT_SUCCESS if successfull, error code otherwise */
-     int DecodeBlock(const void* src, const void* ecc, void* dst, uint8_t* erase_pos = NULL, size_t erase_count = 0) {
+     int DecodeBlock(const void* src, const void* ecc, void* dst, uint8_t* erase_pos = NULL, size_t erase_count = 0, size_t max_errors = 255) {
         assert(msg_length + ecc_length < 256);
 
         const uint8_t *src_ptr = (const uint8_t*) src;
@@ -165,6 +210,8 @@ public:
 
         bool ok;
 
+        errors_found = 0;
+
         ///* Allocation memory on stack  */
         //uint8_t stack_memory[MSG_CNT * msg_length + POLY_CNT * ecc_length * 2];
         //this->memory = stack_memory;
@@ -230,10 +277,18 @@ public:
         if(!ok) return 1;
 
         // Error happened while finding errors (so helpfull :D)
-        if(err->length == 0) return 1;
+        // gg : with erasures, all errors can be at the erased positions
+        if(err->length == 0 && epos->length == 0) return 1;
+
+        errors_found = err->length;
+        if(errors_found > max_errors) return 1;
 
         /* Adding found errors with known */
         for(uint8_t i = 0; i < err->length; i++) {
+            // gg : an error at an erased position means that the decoding failed
+            for(uint8_t j = 0; j < epos->length; j++) {
+                if(epos->at(j) == err->at(i)) return 1;
+            }
             epos->Append(err->at(i));
         }
 
@@ -247,17 +302,81 @@ public:
         return 0;
     }
 
+    /* @brief Fast check of an encoded message, without correcting it
+     * gg : computes only the syndromes and the error locator (Berlekamp-Massey), skipping the
+     *      Chien search and the Forney algorithm. Used to reject wrong candidates cheaply
+     *      With locate, the Chien search finds the positions of the errors_found errors as
+     *      well - see error_position()
+     * @param *src         - encoded message buffer   (msg_length + ecc_length size)
+     * @param locate       - gg : find the error positions
+     * @return 0 if there are no errors, 1 if the errors may be correctable, -1 if they are not */
+     int Check(const void* src, bool locate = false) {
+        assert(msg_length + ecc_length < 256);
+
+        errors_found = 0;
+
+        this->memory = heap_memory + ecc_length + 1;
+
+        const uint8_t src_len = msg_length + ecc_length;
+
+        Poly *msg_in = &polynoms[ID_MSG_IN];
+        Poly *epos   = &polynoms[ID_ERASURES];
+        Poly *synd   = &polynoms[ID_SYNDROMES];
+        Poly *forney = &polynoms[ID_FORNEY];
+
+        msg_in->Set((const uint8_t*) src, src_len);
+        epos->length = 0;
+
+        CalcSyndromes(msg_in);
+
+        bool has_errors = false;
+        for(uint8_t i = 0; i < synd->length; i++) {
+            if(synd->at(i) != 0) {
+                has_errors = true;
+                break;
+            }
+        }
+
+        if(!has_errors) return 0;
+
+        CalcForneySyndromes(synd, epos, src_len);
+        if(!FindErrorLocator(forney, NULL, 0)) return -1;
+
+        if(locate) {
+            Poly *eloc  = &polynoms[ID_ERRORS_LOC];
+            Poly *reloc = &polynoms[ID_TPOLY1];
+
+            reloc->length = eloc->length;
+            for(int8_t i = eloc->length-1, j = 0; i >= 0; i--, j++){
+                reloc->at(j) = eloc->at(i);
+            }
+
+            if(!FindErrors(reloc, src_len)) return -1;
+
+            errors_found = polynoms[ID_ERRORS].length;
+        }
+
+        return 1;
+     }
+
+    /* gg : position of error i < errors_found, counted from the start of the message, found by the
+     *      last Check() with locate */
+    uint8_t error_position(size_t i) const {
+        return polynoms[ID_ERRORS].at(i);
+    }
+
     /* @brief Message block decoding
      * @param *src         - encoded message buffer   (msg_length + ecc_length size)
      * @param *msg_out     - output buffer            (msg_length size at least)
      * @param *erase_pos   - known errors positions
      * @param erase_count  - count of known errors
+     * @param max_errors   - gg : see DecodeBlock()
      * @return RESULT_SUCCESS if successfull, error code otherwise */
-     int Decode(const void* src, void* dst, uint8_t* erase_pos = NULL, size_t erase_count = 0) {
+     int Decode(const void* src, void* dst, uint8_t* erase_pos = NULL, size_t erase_count = 0, size_t max_errors = 255) {
          const uint8_t *src_ptr = (const uint8_t*) src;
          const uint8_t *ecc_ptr = src_ptr + msg_length;
 
-         return DecodeBlock(src, ecc_ptr, dst, erase_pos, erase_count);
+         return DecodeBlock(src, ecc_ptr, dst, erase_pos, erase_count, max_errors);
      }
 
 #ifndef DEBUG
@@ -316,9 +435,8 @@ private:
         Poly *synd = &polynoms[ID_SYNDROMES];
         synd->length = ecc_length+1;
         synd->at(0) = 0;
-        for(uint8_t i = 1; i < ecc_length+1; i++){
-            synd->at(i) = gf::poly_eval(msg, gf::pow(2, i-1));
-        }
+        // gg : all syndromes are evaluated in a single pass over the message
+        gf::vec_eval_pow2(msg->ptr(), msg->length, synd->ptr() + 1, ecc_length);
     }
 
     void FindErrataLocator(const Poly *epos) {
@@ -71,6 +71,39 @@ int main() {
     decoded[ret] = 0; // null-terminate the received data
     CHECK(strcmp(decoded, payload) == 0);
 
+    // long payloads are not written by the unsafe method
+    {
+        ggwave_Parameters parametersLong = parameters;
+        parametersLong.operatingMode |= GGWAVE_OPERATING_MODE_LONG_PAYLOAD;
+
+        ggwave_Instance instanceLong = ggwave_init(parametersLong);
+
+        char payloadLong[300];
+        char decodedLong[512];
+        for (int i = 0; i < (int) sizeof(payloadLong); ++i) {
+            payloadLong[i] = 'a' + i%26;
+        }
+
+        int nl = ggwave_encode(instanceLong, payloadLong, sizeof(payloadLong), GGWAVE_PROTOCOL_AUDIBLE_FASTEST, 50, NULL, 1);
+        char *waveformLong = malloc(nl);
+        CHECK(waveformLong != NULL);
+
+        nl = ggwave_encode(instanceLong, payloadLong, sizeof(payloadLong), GGWAVE_PROTOCOL_AUDIBLE_FASTEST, 50, waveformLong, 0);
+        CHECK(nl > 0);
+
+        memset(decodedLong, 0, sizeof(decodedLong));
+        ret = ggwave_decode(instanceLong, waveformLong, nl, decodedLong);
+        CHECK(ret == -2); // longer than GGWave::kMaxDataSize
+        CHECK(decodedLong[0] == 0);
+
+        ret = ggwave_ndecode(instanceLong, waveformLong, nl, decodedLong, sizeof(decodedLong));
+        CHECK(ret == (int) sizeof(payloadLong));
+        CHECK(memcmp(decodedLong, payloadLong, sizeof(payloadLong)) == 0);
+
+        ggwave_free(instanceLong);
+        free(waveformLong);
+    }
+
     ggwave_free(instance);
     free(waveform);
 
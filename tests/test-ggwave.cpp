@@ -1,5 +1,6 @@
 #include "ggwave/ggwave.h"
 
+#include <cmath>
 #include <cstring>
 #include <limits>
 #include <string>
@@ -177,6 +178,31 @@ int main(int argc, char ** argv) {
         };
     };
 
+    // encode the payload passed to init(), after startSamples samples and followed by padFrames frames of silence,
+    // add noise and decode it back. The instance must use F32 samples. Returns true if the payload is received
+    auto roundTrip = [&](GGWave & instance, const std::string & payload, int startSamples, int padFrames, float noise) {
+        const int n = instance.encode()/sizeof(float);
+        if (n <= 0) {
+            return false;
+        }
+
+        std::vector<float> waveform(startSamples, 0.0f);
+        waveform.insert(waveform.end(), (const float *) instance.txWaveform(), (const float *) instance.txWaveform() + n);
+        waveform.insert(waveform.end(), padFrames*instance.samplesPerFrame(), 0.0f);
+
+        if (noise > 0.0f) {
+            for (auto & s : waveform) {
+                s += noise*(frand() - 0.5f);
+            }
+        }
+
+        instance.decode(waveform.data(), waveform.size()*sizeof(float));
+
+        GGWave::TxRxData result;
+        return instance.rxTakeData(result) == (int) payload.size() &&
+            std::string((const char *) result.data(), payload.size()) == payload;
+    };
+
     {
         GGWave instance(GGWave::getDefaultParameters());
 
@@ -200,6 +226,1118 @@ int main(int argc, char ** argv) {
         CHECK_F(instance.init(payload.size(), payload.c_str(), GGWAVE_PROTOCOL_AUDIBLE_FAST, 101));
     }
 
+    // compile-time specialized instances with static memory
+    {
+        const std::string payload = "hello123";
+
+        {
+            static GGWaveStatic<256, 8, GGWAVE_OPERATING_MODE_RX_AND_TX, GGWAVE_SAMPLE_FORMAT_I16, GGWAVE_SAMPLE_FORMAT_I16,
+                GGWAVE_PROTOCOL_DT_NORMAL, GGWAVE_PROTOCOL_DT_FASTEST, GGWAVE_PROTOCOL_MT_FASTEST> instance(6000.0f);
+            CHECK(instance.isPrepared());
+            CHECK(instance.heapSize() == instance.kHeapSize);
+
+            for (auto protocolId : { GGWAVE_PROTOCOL_DT_FASTEST, GGWAVE_PROTOCOL_MT_FASTEST }) {
+                CHECK(instance.init(payload.size(), payload.data(), protocolId, 25));
+                const auto nBytes = instance.encode();
+                CHECK(nBytes > 0);
+                instance.decode(instance.txWaveform(), nBytes);
+
+                GGWave::TxRxData result;
+                CHECK(instance.rxTakeData(result) == (int) payload.size());
+                for (int i = 0; i < (int) payload.size(); ++i) {
+                    CHECK(payload[i] == result[i]);
+                }
+            }
+        }
+
+        {
+            static GGWaveStatic<256, -1, GGWAVE_OPERATING_MODE_RX_AND_TX, GGWAVE_SAMPLE_FORMAT_F32, GGWAVE_SAMPLE_FORMAT_F32,
+                GGWAVE_PROTOCOL_DT_FAST> instance(6000.0f);
+            CHECK(instance.isPrepared());
+            CHECK(instance.heapSize() == instance.kHeapSize);
+
+            CHECK(instance.init(payload.c_str(), GGWAVE_PROTOCOL_DT_FAST, 25));
+            CHECK(roundTrip(instance, payload, 0, 0, 0.0f));
+        }
+
+        {
+            static GGWaveStatic<128, 4, GGWAVE_OPERATING_MODE_TX | GGWAVE_OPERATING_MODE_TX_ONLY_TONES, GGWAVE_SAMPLE_FORMAT_U8, GGWAVE_SAMPLE_FORMAT_U8,
+                GGWAVE_PROTOCOL_MT_NORMAL> instance(6000.0f);
+            CHECK(instance.isPrepared());
+            CHECK(instance.heapSize() == instance.kHeapSize);
+            CHECK(instance.init(4, payload.data(), GGWAVE_PROTOCOL_MT_NORMAL, 25));
+            CHECK(instance.encode() > 0);
+        }
+
+        // variable payload length, protocols in two frequency bands
+        {
+            static GGWaveStatic<256, -1, GGWAVE_OPERATING_MODE_RX_AND_TX | GGWAVE_OPERATING_MODE_TX_NCO, GGWAVE_SAMPLE_FORMAT_F32, GGWAVE_SAMPLE_FORMAT_I16,
+                GGWAVE_PROTOCOL_AUDIBLE_FASTEST, GGWAVE_PROTOCOL_DT_FAST, GGWAVE_PROTOCOL_MT_FAST> instance(6000.0f);
+            CHECK(instance.isPrepared());
+            CHECK(instance.heapSize() == instance.kHeapSize);
+        }
+
+        // the sample rate is checked when the instance is prepared
+        {
+            static GGWaveStatic<128, 4, GGWAVE_OPERATING_MODE_TX | GGWAVE_OPERATING_MODE_TX_ONLY_TONES, GGWAVE_SAMPLE_FORMAT_U8, GGWAVE_SAMPLE_FORMAT_U8,
+                GGWAVE_PROTOCOL_MT_NORMAL> instance(100.0f);
+            CHECK_F(instance.isPrepared());
+        }
+    }
+
+    // simultaneous transmissions in different frequency bands
+    {
+        const std::string payload0 = "audible";
+        const std::string payload1 = "ultrasound";
+
+        auto parameters = GGWave::getDefaultParameters();
+        parameters.sampleFormatInp = GGWAVE_SAMPLE_FORMAT_F32;
+        parameters.sampleFormatOut = GGWAVE_SAMPLE_FORMAT_F32;
+
+        std::vector<float> waveform;
+        for (int k = 0; k < 2; ++k) {
+            GGWave instance(parameters);
+            if (k == 0) {
+                instance.init(payload0.c_str(), GGWAVE_PROTOCOL_AUDIBLE_FAST, 25);
+            } else {
+                instance.init(payload1.c_str(), GGWAVE_PROTOCOL_ULTRASOUND_FASTEST, 25);
+            }
+
+            const int n = instance.encode()/sizeof(float);
+            const int offset = k*7*parameters.samplesPerFrame; // partially overlapping
+            waveform.resize(std::max((int) waveform.size(), offset + n));
+
+            const auto p = (const float *) instance.txWaveform();
+            for (int i = 0; i < n; ++i) {
+                waveform[offset + i] += p[i];
+            }
+        }
+
+        parameters.operatingMode = GGWAVE_OPERATING_MODE_RX | GGWAVE_OPERATING_MODE_RX_MULTI_STREAM;
+        GGWave instance(parameters);
+        instance.rxProtocols().only(GGWAVE_PROTOCOL_AUDIBLE_FAST);
+        instance.rxProtocols().toggle(GGWAVE_PROTOCOL_ULTRASOUND_FASTEST, true);
+
+        instance.decode(waveform.data(), waveform.size()*sizeof(float));
+
+        std::set<std::string> received;
+
+        GGWave::TxRxData result;
+        int n = 0;
+        while ((n = instance.rxTakeData(result)) != 0) {
+            CHECK(n > 0);
+            received.insert(std::string((const char *) result.data(), n));
+        }
+
+        CHECK(received.size() == 2);
+        CHECK(received.count(payload0) == 1);
+        CHECK(received.count(payload1) == 1);
+
+        // multi-stream Rx is not supported with fixed payload length
+        parameters.payloadLength = 4;
+        CHECK_F(instance.prepare(parameters));
+    }
+
+    // several payloads in different frequency bands encoded into a single waveform
+    {
+        const char * payloads[] = { "first", "second payload" };
+        const int sizes[] = { 5, 14 };
+
+        auto parameters = GGWave::getDefaultParameters();
+        parameters.sampleFormatInp = GGWAVE_SAMPLE_FORMAT_F32;
+        parameters.sampleFormatOut = GGWAVE_SAMPLE_FORMAT_F32;
+        parameters.operatingMode = GGWAVE_OPERATING_MODE_RX | GGWAVE_OPERATING_MODE_TX | GGWAVE_OPERATING_MODE_TX_MULTI_STREAM;
+
+        {
+            GGWave instance(parameters);
+
+            const GGWave::TxProtocolId overlapping[] = { GGWAVE_PROTOCOL_AUDIBLE_FAST, GGWAVE_PROTOCOL_DT_FAST };
+            CHECK_F(instance.init(2, sizes, payloads, overlapping, 25));
+        }
+
+        {
+            parameters.operatingMode |= GGWAVE_OPERATING_MODE_RX_MULTI_STREAM;
+            GGWave instance(parameters);
+            instance.rxProtocols().only(GGWAVE_PROTOCOL_AUDIBLE_FASTEST);
+            instance.rxProtocols().toggle(GGWAVE_PROTOCOL_ULTRASOUND_FAST, true);
+
+            const GGWave::TxProtocolId protocolIds[] = { GGWAVE_PROTOCOL_AUDIBLE_FASTEST, GGWAVE_PROTOCOL_ULTRASOUND_FAST };
+            CHECK(instance.init(2, sizes, payloads, protocolIds, 50));
+
+            const int expectedSize = instance.encodeSize_bytes();
+            const int nBytes = instance.encode();
+            CHECK(nBytes == expectedSize);
+
+            const auto waveform = (const float *) instance.txWaveform();
+            for (int i = 0; i < nBytes/(int) sizeof(float); ++i) {
+                CHECK(std::fabs(waveform[i]) <= 0.5f);
+            }
+
+            std::vector<float> buffer(waveform, waveform + nBytes/sizeof(float));
+            instance.decode(buffer.data(), nBytes);
+
+            std::set<std::string> received;
+
+            GGWave::TxRxData result;
+            int n = 0;
+            while ((n = instance.rxTakeData(result)) != 0) {
+                CHECK(n > 0);
+                received.insert(std::string((const char *) result.data(), n));
+            }
+
+            CHECK(received.size() == 2);
+            CHECK(received.count(payloads[0]) == 1);
+            CHECK(received.count(payloads[1]) == 1);
+        }
+
+        {
+            parameters.operatingMode = GGWAVE_OPERATING_MODE_TX;
+            GGWave instance(parameters);
+
+            const GGWave::TxProtocolId protocolIds[] = { GGWAVE_PROTOCOL_AUDIBLE_FASTEST, GGWAVE_PROTOCOL_ULTRASOUND_FAST };
+            CHECK_F(instance.init(2, sizes, payloads, protocolIds, 50));
+            CHECK_T(instance.init(1, sizes, payloads, protocolIds, 50));
+        }
+    }
+
+    // capture fed in chunks that are not aligned to the frame size, without resampling
+    {
+        const std::string payload = "chunked";
+
+        auto parameters = GGWave::getDefaultParameters();
+        parameters.sampleFormatInp = GGWAVE_SAMPLE_FORMAT_I16;
+        parameters.sampleFormatOut = GGWAVE_SAMPLE_FORMAT_I16;
+
+        for (int k = 0; k < 2; ++k) {
+            parameters.payloadLength = k == 0 ? -1 : (int) payload.size();
+
+            GGWave instance(parameters);
+            CHECK(instance.init(payload.c_str(), k == 0 ? GGWAVE_PROTOCOL_AUDIBLE_FAST : GGWAVE_PROTOCOL_DT_FAST, 25));
+
+            const int n = instance.encode()/sizeof(int16_t);
+            const auto p = (const int16_t *) instance.txWaveform();
+
+            std::vector<int16_t> waveform(p, p + n);
+            waveform.insert(waveform.end(), 16*parameters.samplesPerFrame, 0);
+
+            for (int nChunk : { 1, 333, parameters.samplesPerFrame - 1, parameters.samplesPerFrame + 1, 3*parameters.samplesPerFrame/2 }) {
+                for (int i = 0; i < (int) waveform.size(); i += nChunk) {
+                    const int nCur = std::min(nChunk, (int) waveform.size() - i);
+                    CHECK(instance.decode(waveform.data() + i, nCur*sizeof(int16_t)));
+                }
+
+                GGWave::TxRxData result;
+                const int nRx = instance.rxTakeData(result);
+                CHECK(nRx == (int) payload.size());
+                CHECK(std::string((const char *) result.data(), nRx) == payload);
+            }
+        }
+    }
+
+    // shared front-end with several decoder back-ends
+    {
+        const std::string payloadVariable = "variable";
+        const std::string payloadFixed    = "fixed";
+
+        auto parameters = GGWave::getDefaultParameters();
+        parameters.sampleFormatInp = GGWAVE_SAMPLE_FORMAT_I16;
+        parameters.sampleFormatOut = GGWAVE_SAMPLE_FORMAT_I16;
+
+        auto parametersFixed = parameters;
+        parametersFixed.payloadLength = (int) payloadFixed.size();
+
+        std::vector<int16_t> waveform;
+        for (int k = 0; k < 2; ++k) {
+            GGWave instance(k == 0 ? parameters : parametersFixed);
+            if (k == 0) {
+                instance.init(payloadVariable.c_str(), GGWAVE_PROTOCOL_AUDIBLE_FAST, 25);
+            } else {
+                instance.init(payloadFixed.c_str(), GGWAVE_PROTOCOL_DT_FAST, 25);
+            }
+
+            const int n = instance.encode()/sizeof(int16_t);
+            const auto p = (const int16_t *) instance.txWaveform();
+            waveform.insert(waveform.end(), p, p + n);
+            waveform.insert(waveform.end(), 16*parameters.samplesPerFrame, 0);
+        }
+
+        parameters.operatingMode = GGWAVE_OPERATING_MODE_RX;
+        parametersFixed.operatingMode = GGWAVE_OPERATING_MODE_RX;
+
+        // the back-ends ignore their input sample format
+        parametersFixed.sampleFormatInp = GGWAVE_SAMPLE_FORMAT_F32;
+
+        GGWave frontEnd(parameters);
+        GGWave backendVariable(parameters);
+        GGWave backendFixed(parametersFixed);
+
+        backendVariable.rxProtocols().only(GGWAVE_PROTOCOL_AUDIBLE_FAST);
+        backendFixed.rxProtocols().only(GGWAVE_PROTOCOL_DT_FAST);
+
+        GGWave * backends[] = { &backendVariable, &backendFixed };
+
+        // feed the capture in chunks that are not aligned to the frame size
+        const int nChunk = 1000;
+        for (int i = 0; i < (int) waveform.size(); i += nChunk) {
+            const int n = std::min(nChunk, (int) waveform.size() - i);
+            CHECK(frontEnd.decode(waveform.data() + i, n*sizeof(int16_t), backends, 2));
+        }
+
+        GGWave::TxRxData result;
+        int n = backendVariable.rxTakeData(result);
+        CHECK(n == (int) payloadVariable.size());
+        CHECK(std::string((const char *) result.data(), n) == payloadVariable);
+
+        n = backendFixed.rxTakeData(result);
+        CHECK(n == (int) payloadFixed.size());
+        CHECK(std::string((const char *) result.data(), n) == payloadFixed);
+
+        // the back-ends must match the frame size of the front-end
+        parameters.samplesPerFrame /= 2;
+        GGWave backendMismatch(parameters);
+        GGWave * mismatch[] = { &backendMismatch };
+        CHECK_F(frontEnd.decode(waveform.data(), nChunk*sizeof(int16_t), mismatch, 1));
+
+        GGWave * self[] = { &frontEnd };
+        CHECK_F(frontEnd.decode(waveform.data(), nChunk*sizeof(int16_t), self, 1));
+    }
+
+    // multi-channel capture
+    {
+        const std::string payload0 = "channel";
+        const std::string payload1 = "other channel";
+
+        auto parameters = GGWave::getDefaultParameters();
+        parameters.sampleFormatInp = GGWAVE_SAMPLE_FORMAT_F32;
+        parameters.sampleFormatOut = GGWAVE_SAMPLE_FORMAT_F32;
+
+        std::vector<float> waveform[2];
+        for (int k = 0; k < 2; ++k) {
+            GGWave instance(parameters);
+            instance.init(k == 0 ? payload0.c_str() : payload1.c_str(), GGWAVE_PROTOCOL_AUDIBLE_FAST, 25);
+
+            const int n = instance.encode()/sizeof(float);
+            const auto p = (const float *) instance.txWaveform();
+            waveform[k].assign(p, p + n);
+        }
+
+        const int nChannels = 4;
+        const int nSamples = std::max(waveform[0].size(), waveform[1].size());
+
+        // interleave the channels: signal in channel "id", loud noise in the rest
+        auto interleave = [&](int id, int id1) {
+            std::vector<int16_t> result(nSamples*nChannels);
+            for (int i = 0; i < nSamples; ++i) {
+                for (int c = 0; c < nChannels; ++c) {
+                    float x = 0.0f;
+                    if (c == id) {
+                        x = i < (int) waveform[0].size() ? waveform[0][i] : 0.0f;
+                    } else if (c == id1) {
+                        x = i < (int) waveform[1].size() ? waveform[1][i] : 0.0f;
+                    } else {
+                        x = 0.8f*(frand() - 0.5f);
+                    }
+                    result[i*nChannels + c] = std::max(-32768.0f, std::min(32767.0f, 32767.0f*x));
+                }
+            }
+            return result;
+        };
+
+        parameters.sampleFormatInp = GGWAVE_SAMPLE_FORMAT_I16;
+        parameters.operatingMode   = GGWAVE_OPERATING_MODE_RX;
+        parameters.channelsInp     = nChannels;
+
+        // select the channel with the best SNR
+        {
+            const auto capture = interleave(2, -1);
+
+            parameters.channelMode = GGWAVE_CHANNEL_MODE_MAX_SNR;
+            GGWave instance(parameters);
+            CHECK(instance.channelsInp() == nChannels);
+            CHECK(instance.decode(capture.data(), capture.size()*sizeof(int16_t)));
+
+            GGWave::TxRxData result;
+            const int n = instance.rxTakeData(result);
+            CHECK(n == (int) payload0.size());
+            CHECK(std::string((const char *) result.data(), n) == payload0);
+        }
+
+        // while idle, the channel is re-selected only once per spectrum averaging window
+        {
+            auto parametersIdle = parameters;
+            parametersIdle.sampleFormatInp = GGWAVE_SAMPLE_FORMAT_F32;
+            parametersIdle.channelsInp     = 2;
+            parametersIdle.channelMode     = GGWAVE_CHANNEL_MODE_MAX_SNR;
+
+            GGWave instance(parametersIdle);
+
+            const int n = parametersIdle.samplesPerFrame;
+            const float omega = 2.0f*M_PI*50.0f/n;
+
+            // a tone in a different channel on each frame and at the start of each window
+            std::vector<float> frame(2*n);
+            int nSwitches = 0;
+            for (int f = 0; f < 8*GGWave::kMaxSpectrumHistory; ++f) {
+                const int c = (f + f/GGWave::kMaxSpectrumHistory) % 2;
+                for (int i = 0; i < n; ++i) {
+                    frame[2*i + 0] = c == 0 ? 0.5f*sin(omega*i) : 0.01f*(frand() - 0.5f);
+                    frame[2*i + 1] = c == 1 ? 0.5f*sin(omega*i) : 0.01f*(frand() - 0.5f);
+                }
+
+                const int channel = instance.rxChannel();
+                CHECK(instance.decode(frame.data(), frame.size()*sizeof(float)));
+
+                if (instance.rxChannel() != channel) {
+                    CHECK(f % GGWave::kMaxSpectrumHistory == 0);
+                    ++nSwitches;
+                }
+            }
+
+            CHECK(nSwitches > 0);
+        }
+
+        // decode each channel separately
+        {
+            const auto capture = interleave(1, 3);
+
+            parameters.channelMode = GGWAVE_CHANNEL_MODE_PER_CHANNEL;
+            GGWave frontEnd(parameters);
+
+            auto parametersBackend = parameters;
+            parametersBackend.channelsInp = 1;
+            parametersBackend.channelMode = GGWAVE_CHANNEL_MODE_DOWNMIX;
+
+            GGWave backend0(parametersBackend);
+            GGWave backend1(parametersBackend);
+            GGWave backend2(parametersBackend);
+            GGWave backend3(parametersBackend);
+
+            GGWave * backends[] = { &backend0, &backend1, &backend2, &backend3 };
+
+            CHECK_F(frontEnd.decode(capture.data(), capture.size()*sizeof(int16_t)));
+            CHECK_F(frontEnd.decode(capture.data(), capture.size()*sizeof(int16_t), backends, 2));
+            CHECK(frontEnd.decode(capture.data(), capture.size()*sizeof(int16_t), backends, nChannels));
+
+            GGWave::TxRxData result;
+            CHECK(backend0.rxTakeData(result) == 0);
+            CHECK(backend2.rxTakeData(result) == 0);
+
+            int n = backend1.rxTakeData(result);
+            CHECK(n == (int) payload0.size());
+            CHECK(std::string((const char *) result.data(), n) == payload0);
+
+            n = backend3.rxTakeData(result);
+            CHECK(n == (int) payload1.size());
+            CHECK(std::string((const char *) result.data(), n) == payload1);
+        }
+
+        // sum the spectra of all channels with fixed payload length
+        {
+            auto parametersFixed = GGWave::getDefaultParameters();
+            parametersFixed.payloadLength   = (int) payload0.size();
+            parametersFixed.sampleFormatOut = GGWAVE_SAMPLE_FORMAT_F32;
+
+            GGWave instanceTx(parametersFixed);
+            instanceTx.init(payload0.c_str(), GGWAVE_PROTOCOL_DT_FAST, 10);
+
+            const int n = instanceTx.encode()/sizeof(float);
+            const auto p = (const float *) instanceTx.txWaveform();
+
+            std::vector<int16_t> capture(n*nChannels);
+            for (int i = 0; i < n; ++i) {
+                for (int c = 0; c < nChannels; ++c) {
+                    capture[i*nChannels + c] = 32767.0f*(p[i] + 0.2f*(frand() - 0.5f));
+                }
+            }
+
+            parametersFixed.sampleFormatInp = GGWAVE_SAMPLE_FORMAT_I16;
+            parametersFixed.operatingMode   = GGWAVE_OPERATING_MODE_RX;
+            parametersFixed.channelsInp     = nChannels;
+            parametersFixed.channelMode     = GGWAVE_CHANNEL_MODE_SUM_SPECTRA;
+
+            GGWave instance(parametersFixed);
+            instance.rxProtocols().only(GGWAVE_PROTOCOL_DT_FAST);
+            CHECK(instance.decode(capture.data(), capture.size()*sizeof(int16_t)));
+
+            GGWave::TxRxData result;
+            CHECK(instance.rxTakeData(result) == (int) payload0.size());
+            CHECK(std::string((const char *) result.data(), payload0.size()) == payload0);
+        }
+
+        // only the downmix is supported together with resampling
+        {
+            GGWave instance(parameters);
+
+            parameters.sampleRateInp = 44100;
+            parameters.channelMode = GGWAVE_CHANNEL_MODE_SUM_SPECTRA;
+            CHECK_F(instance.prepare(parameters));
+
+            parameters.channelMode = GGWAVE_CHANNEL_MODE_DOWNMIX;
+            CHECK(instance.prepare(parameters));
+
+            parameters.channelsInp = GGWave::kMaxChannelsInp + 1;
+            CHECK_F(instance.prepare(parameters));
+        }
+    }
+
+    // unreliable bytes are corrected as Reed-Solomon erasures
+    {
+        // 40 bytes payload -> 16 ECC bytes, so hard decisions can correct up to 7 bytes and keep 2 for detection
+        std::string payload0;
+        std::string payload1;
+        for (int i = 0; i < 40; ++i) {
+            payload0 += 'a' + i%26;
+            payload1 += char(payload0[i] ^ 0x11);
+        }
+
+        auto parameters = GGWave::getDefaultParameters();
+        parameters.sampleFormatInp = GGWAVE_SAMPLE_FORMAT_F32;
+        parameters.sampleFormatOut = GGWAVE_SAMPLE_FORMAT_F32;
+
+        const auto & protocol = GGWave::Protocols::kDefault()[GGWAVE_PROTOCOL_AUDIBLE_FASTEST];
+
+        std::vector<float> waveform[2];
+        for (int k = 0; k < 2; ++k) {
+            GGWave instance(parameters);
+            instance.init(k == 0 ? payload0.c_str() : payload1.c_str(), GGWAVE_PROTOCOL_AUDIBLE_FASTEST, k == 0 ? 25 : 30);
+
+            const int n = instance.encode()/sizeof(float);
+            const auto p = (const float *) instance.txWaveform();
+            waveform[k].assign(p, p + n);
+        }
+
+        CHECK(waveform[0].size() == waveform[1].size());
+
+        // overlay 3 Tx chunks with slightly stronger wrong tones -> 9 wrong data bytes with low confidence
+        const int nFramesTx = protocol.framesPerTx*parameters.samplesPerFrame;
+        for (int itx = 4; itx < 7; ++itx) {
+            const int offset = (GGWave::kDefaultMarkerFrames + itx*protocol.framesPerTx)*parameters.samplesPerFrame;
+            for (int i = 0; i < nFramesTx; ++i) {
+                waveform[0][offset + i] += waveform[1][offset + i];
+            }
+        }
+
+        GGWave instance(parameters);
+        instance.rxProtocols().only(GGWAVE_PROTOCOL_AUDIBLE_FASTEST);
+        instance.decode(waveform[0].data(), waveform[0].size()*sizeof(float));
+
+        GGWave::TxRxData result;
+        const int n = instance.rxTakeData(result);
+        CHECK(n == (int) payload0.size());
+        CHECK(std::string((const char *) result.data(), n) == payload0);
+    }
+
+    // a rejected erasure decoding does not overwrite the payload that is waiting to be taken
+    {
+        auto parameters = GGWave::getDefaultParameters();
+        parameters.payloadLength   = 8;
+        parameters.sampleFormatInp = GGWAVE_SAMPLE_FORMAT_I16;
+        parameters.sampleFormatOut = GGWAVE_SAMPLE_FORMAT_I16;
+
+        GGWave instanceTx(parameters);
+        GGWave instanceRx(parameters);
+        instanceRx.rxProtocols().only(GGWAVE_PROTOCOL_AUDIBLE_FAST);
+
+        for (int k = 0; k < 20; ++k) {
+            std::string payload;
+            for (int i = 0; i < 8; ++i) {
+                payload += 'a' + rand()%26;
+            }
+
+            CHECK(instanceTx.init(payload.c_str(), GGWAVE_PROTOCOL_AUDIBLE_FAST, 10));
+
+            const int n = instanceTx.encode()/sizeof(int16_t);
+            const auto p = (const int16_t *) instanceTx.txWaveform();
+
+            // the windows after the payload are still decoded before the result is taken
+            std::vector<int16_t> waveform(p, p + n);
+            waveform.insert(waveform.end(), 64*parameters.samplesPerFrame, 0);
+            instanceRx.decode(waveform.data(), waveform.size()*sizeof(int16_t));
+
+            GGWave::TxRxData result;
+            CHECK(instanceRx.rxTakeData(result) == (int) payload.size());
+            CHECK(std::string((const char *) result.data(), payload.size()) == payload);
+        }
+    }
+
+    // long payloads split into blocks within a single transmission
+    {
+        std::string payload;
+        for (int i = 0; i < 1000; ++i) {
+            payload += char(7*i + i/256);
+        }
+
+        auto parameters = GGWave::getDefaultParameters();
+        parameters.sampleFormatInp = GGWAVE_SAMPLE_FORMAT_F32;
+        parameters.sampleFormatOut = GGWAVE_SAMPLE_FORMAT_F32;
+        parameters.operatingMode  |= GGWAVE_OPERATING_MODE_LONG_PAYLOAD | GGWAVE_OPERATING_MODE_USE_DSS;
+
+        GGWave instance(parameters);
+
+        // too long for the slower protocols
+        CHECK_F(instance.init(GGWave::kMaxLengthLong, std::string(GGWave::kMaxLengthLong, 'x').c_str(), GGWAVE_PROTOCOL_AUDIBLE_NORMAL));
+
+        for (const auto & data : { payload, payload.substr(0, 2*GGWave::kLongBlockLength + 1), std::string("short payload") }) {
+            CHECK(instance.init(data.size(), data.c_str(), GGWAVE_PROTOCOL_AUDIBLE_FASTEST));
+            CHECK(roundTrip(instance, data, 0, 0, 0.0f));
+        }
+
+        // variable payload length only
+        parameters.payloadLength = 16;
+        CHECK_F(instance.prepare(parameters));
+    }
+
+    // continuous stream of back-to-back fixed-length transmissions
+    {
+        auto parameters = GGWave::getDefaultParameters();
+        parameters.payloadLength   = 8;
+        parameters.sampleFormatInp = GGWAVE_SAMPLE_FORMAT_F32;
+        parameters.sampleFormatOut = GGWAVE_SAMPLE_FORMAT_F32;
+        parameters.operatingMode  |= GGWAVE_OPERATING_MODE_RX_CONTINUOUS;
+
+        GGWave instance(parameters);
+        instance.rxProtocols().only(GGWAVE_PROTOCOL_AUDIBLE_FAST);
+
+        const char * payloads[] = { "frame #0", "frame #1", "frame #2", "frame #3", };
+
+        std::vector<float> waveform(1500, 0.0f);
+        for (const auto & payload : payloads) {
+            CHECK(instance.init(payload, GGWAVE_PROTOCOL_AUDIBLE_FAST, 25));
+
+            const int n = instance.encode()/sizeof(float);
+            const auto p = (const float *) instance.txWaveform();
+            waveform.insert(waveform.end(), p, p + n);
+        }
+        waveform.resize(waveform.size() + 4*parameters.samplesPerFrame, 0.0f);
+
+        // each payload is received exactly once
+        int nReceived = 0;
+        for (int i = 0; i + parameters.samplesPerFrame <= (int) waveform.size(); i += parameters.samplesPerFrame) {
+            instance.decode(waveform.data() + i, parameters.samplesPerFrame*sizeof(float));
+
+            GGWave::TxRxData result;
+            const int n = instance.rxTakeData(result);
+            if (n > 0) {
+                CHECK(nReceived < 4);
+                CHECK(std::string((const char *) result.data(), n) == payloads[nReceived]);
+                CHECK(instance.rxLocked());
+                ++nReceived;
+            }
+        }
+
+        CHECK(nReceived == 4);
+
+        // fixed payload length only
+        parameters.payloadLength = -1;
+        CHECK_F(instance.prepare(parameters));
+    }
+
+    // energy-gated reception
+    for (int payloadLength : { -1, 8, }) {
+        auto parameters = GGWave::getDefaultParameters();
+        parameters.payloadLength   = payloadLength;
+        parameters.sampleFormatInp = GGWAVE_SAMPLE_FORMAT_F32;
+        parameters.sampleFormatOut = GGWAVE_SAMPLE_FORMAT_F32;
+        parameters.operatingMode  |= GGWAVE_OPERATING_MODE_RX_ENERGY_GATE;
+
+        GGWave instance(parameters);
+
+        const std::string payload = "gated!!!";
+        CHECK(instance.init(payload.c_str(), GGWAVE_PROTOCOL_AUDIBLE_FAST, 25));
+
+        std::vector<float> waveform(2*parameters.sampleRate, 0.0f);
+        const int nIdle = waveform.size()/parameters.samplesPerFrame;
+        {
+            const int n = instance.encode()/sizeof(float);
+            const auto p = (const float *) instance.txWaveform();
+            waveform.insert(waveform.end(), p, p + n);
+        }
+        // in fixed-length mode the gate stays open for the duration of the longest payload
+        waveform.resize(waveform.size() + 6*parameters.sampleRate, 0.0f);
+
+        for (auto & x : waveform) {
+            x += 0.02f*(frand() - 0.5f);
+        }
+
+        // the decoding is skipped before the transmission and the payload is still received
+        int nReceived = 0;
+        int nSkipped  = 0;
+        for (int i = 0; i + parameters.samplesPerFrame <= (int) waveform.size(); i += parameters.samplesPerFrame) {
+            instance.decode(waveform.data() + i, parameters.samplesPerFrame*sizeof(float));
+
+            if (i/parameters.samplesPerFrame < nIdle) {
+                nSkipped += instance.rxIdle();
+            }
+
+            GGWave::TxRxData result;
+            const int n = instance.rxTakeData(result);
+            if (n > 0) {
+                CHECK(std::string((const char *) result.data(), n) == payload);
+                ++nReceived;
+            }
+        }
+
+        CHECK(nSkipped > nIdle/2);
+        CHECK(nReceived > 0);
+        CHECK(instance.rxIdle());
+    }
+
+    // IFFT synthesis produces the same waveform as the sine tables
+    for (int payloadLength : { -1, 8, }) {
+        const std::string payload = "ifft1234";
+
+        auto parameters = GGWave::getDefaultParameters();
+        parameters.payloadLength   = payloadLength;
+        parameters.sampleFormatOut = GGWAVE_SAMPLE_FORMAT_F32;
+        parameters.operatingMode   = GGWAVE_OPERATING_MODE_TX;
+
+        GGWave instanceRef(parameters);
+
+        parameters.operatingMode |= GGWAVE_OPERATING_MODE_TX_IFFT;
+        GGWave instance(parameters);
+        CHECK(instance.heapSize() < instanceRef.heapSize());
+
+        for (auto protocolId : { GGWAVE_PROTOCOL_AUDIBLE_NORMAL, GGWAVE_PROTOCOL_ULTRASOUND_FASTEST, GGWAVE_PROTOCOL_DT_FAST, GGWAVE_PROTOCOL_MT_FASTEST }) {
+            if (payloadLength < 0 && protocolId == GGWAVE_PROTOCOL_MT_FASTEST) {
+                continue;
+            }
+
+            CHECK(instanceRef.init(payload.c_str(), protocolId, 25));
+            CHECK(instance.init(payload.c_str(), protocolId, 25));
+
+            const int nRef = instanceRef.encode();
+            CHECK((int) instance.encode() == nRef);
+
+            const auto pRef = (const float *) instanceRef.txWaveform();
+            const auto p    = (const float *) instance.txWaveform();
+
+            float maxDiff = 0.0f;
+            for (int i = 0; i < nRef/(int) sizeof(float); ++i) {
+                maxDiff = std::max(maxDiff, std::fabs(p[i] - pRef[i]));
+            }
+#ifdef GGWAVE_CONFIG_FIXED_POINT
+            // the sine tables are interpolated from a Q15 table
+            CHECK(maxDiff < 1e-5f);
+#else
+            CHECK(maxDiff < 1e-6f);
+#endif
+        }
+
+        {
+            static GGWaveStatic<256, 8, GGWAVE_OPERATING_MODE_TX | GGWAVE_OPERATING_MODE_TX_IFFT, GGWAVE_SAMPLE_FORMAT_F32, GGWAVE_SAMPLE_FORMAT_F32,
+                GGWAVE_PROTOCOL_DT_FAST> instanceStatic(6000.0f);
+            CHECK(instanceStatic.heapSize() == instanceStatic.kHeapSize);
+            CHECK(instanceStatic.init(payload.c_str(), GGWAVE_PROTOCOL_DT_FAST, 25));
+            CHECK(instanceStatic.encode() > 0);
+        }
+    }
+
+    // NCO synthesis produces the same waveform as the sine tables, also for frame sizes that are not a power of 2
+    for (int samplesPerFrame : { 1024, 1000, }) {
+        const std::string payload = "nco12345";
+
+        auto parameters = GGWave::getDefaultParameters();
+        parameters.samplesPerFrame = samplesPerFrame;
+        parameters.sampleFormatOut = GGWAVE_SAMPLE_FORMAT_F32;
+        parameters.operatingMode   = GGWAVE_OPERATING_MODE_TX;
+
+        GGWave instanceRef(parameters);
+
+        parameters.operatingMode |= GGWAVE_OPERATING_MODE_TX_NCO;
+        GGWave instance(parameters);
+        CHECK(instance.heapSize() < instanceRef.heapSize());
+
+        for (auto protocolId : { GGWAVE_PROTOCOL_AUDIBLE_FASTEST, GGWAVE_PROTOCOL_ULTRASOUND_NORMAL, GGWAVE_PROTOCOL_DT_FASTEST }) {
+            CHECK(instanceRef.init(payload.c_str(), protocolId, 25));
+            CHECK(instance.init(payload.c_str(), protocolId, 25));
+
+            const int nRef = instanceRef.encode();
+            CHECK((int) instance.encode() == nRef);
+
+            const auto pRef = (const float *) instanceRef.txWaveform();
+            const auto p    = (const float *) instance.txWaveform();
+
+            float maxDiff = 0.0f;
+            for (int i = 0; i < nRef/(int) sizeof(float); ++i) {
+                maxDiff = std::max(maxDiff, std::fabs(p[i] - pRef[i]));
+            }
+            CHECK(maxDiff < 1e-4f);
+        }
+
+        // the NCO and IFFT synthesis cannot be combined
+        parameters.operatingMode |= GGWAVE_OPERATING_MODE_TX_IFFT;
+        CHECK_F(instance.prepare(parameters));
+    }
+
+    {
+        static GGWaveStatic<256, 8, GGWAVE_OPERATING_MODE_TX | GGWAVE_OPERATING_MODE_TX_NCO, GGWAVE_SAMPLE_FORMAT_I16, GGWAVE_SAMPLE_FORMAT_I16,
+            GGWAVE_PROTOCOL_DT_FAST, GGWAVE_PROTOCOL_MT_FASTEST> instance(6000.0f);
+        CHECK(instance.heapSize() == instance.kHeapSize);
+        CHECK(instance.init("nco12345", GGWAVE_PROTOCOL_MT_FASTEST, 25));
+        CHECK(instance.encode() > 0);
+    }
+
+    // low-crest synthesis - lower PAPR and louder tones at the same peak level
+    for (int payloadLength : { -1, 8, }) {
+        const std::string payload = "crest123";
+
+        auto parameters = GGWave::getDefaultParameters();
+        parameters.payloadLength   = payloadLength;
+        parameters.sampleFormatInp = GGWAVE_SAMPLE_FORMAT_F32;
+        parameters.sampleFormatOut = GGWAVE_SAMPLE_FORMAT_F32;
+
+        GGWave instanceRef(parameters);
+
+        parameters.operatingMode |= GGWAVE_OPERATING_MODE_TX_LOW_CREST;
+        GGWave instance(parameters);
+
+        const auto stats = [](const GGWave & g, int nBytes, float & peak, float & rms) {
+            const auto p = (const float *) g.txWaveform();
+            const int n = nBytes/sizeof(float);
+
+            double sum = 0.0;
+            peak = 0.0f;
+            for (int i = 0; i < n; ++i) {
+                peak = std::max(peak, std::fabs(p[i]));
+                sum += p[i]*p[i];
+            }
+            rms = std::sqrt(sum/n);
+        };
+
+        float peakRef, rmsRef;
+        CHECK(instanceRef.init(payload.c_str(), GGWAVE_PROTOCOL_AUDIBLE_FAST, 25));
+        stats(instanceRef, instanceRef.encode(), peakRef, rmsRef);
+
+        float peak, rms;
+        CHECK(instance.init(payload.c_str(), GGWAVE_PROTOCOL_AUDIBLE_FAST, 25));
+        const int nBytes = instance.encode();
+        stats(instance, nBytes, peak, rms);
+
+        CHECK(peak <= 0.25f + 1e-4f);
+        CHECK(rms > rmsRef);
+        CHECK(instance.txPAPR() < instanceRef.txPAPR());
+        CHECK(std::fabs(instance.txPAPR() - 20.0f*std::log10(peak/rms)) < 0.01f);
+
+        CHECK(instance.init(payload.c_str(), GGWAVE_PROTOCOL_AUDIBLE_FAST, 25));
+        CHECK(roundTrip(instance, payload, 0, 0, 0.02f));
+    }
+
+    // fixed-length decoding - bit errors with the spectrum of the decoder vs the floating-point spectrum of a
+    // front-end, i.e. the Q15 spectrum vs the float spectrum when built with GGWAVE_CONFIG_FIXED_POINT
+    {
+        const int payloadLength = 8;
+
+        auto parameters = GGWave::getDefaultParameters();
+        parameters.payloadLength   = payloadLength;
+        parameters.sampleFormatInp = GGWAVE_SAMPLE_FORMAT_I16;
+        parameters.sampleFormatOut = GGWAVE_SAMPLE_FORMAT_I16;
+        parameters.operatingMode   = GGWAVE_OPERATING_MODE_TX;
+
+        GGWave instanceTx(parameters);
+
+        parameters.operatingMode = GGWAVE_OPERATING_MODE_RX;
+
+        GGWave instanceRx(parameters);
+        GGWave frontEnd(parameters);
+
+        // the back-ends ignore their input sample format
+        parameters.sampleFormatInp = GGWAVE_SAMPLE_FORMAT_F32;
+        GGWave backend(parameters);
+
+        instanceRx.rxProtocols().only(GGWAVE_PROTOCOL_DT_FAST);
+        backend.rxProtocols().only(GGWAVE_PROTOCOL_DT_FAST);
+
+        GGWave * backends[] = { &backend };
+
+        const auto countErrors = [&](GGWave & instance, const std::string & payload) {
+            GGWave::TxRxData result;
+            if (instance.rxTakeData(result) != payloadLength) {
+                return 8*payloadLength;
+            }
+
+            int nErrors = 0;
+            for (int i = 0; i < payloadLength; ++i) {
+                for (int b = 0; b < 8; ++b) {
+                    nErrors += ((result[i] ^ payload[i]) >> b) & 1;
+                }
+            }
+            return nErrors;
+        };
+
+        for (float level : { 0.0f, 0.8f, 1.0f, 1.2f }) {
+            int nBits       = 0;
+            int nErrors     = 0;
+            int nErrorsRef  = 0;
+
+            for (int k = 0; k < 10; ++k) {
+                std::string payload;
+                for (int i = 0; i < payloadLength; ++i) {
+                    payload += 'a' + rand()%26;
+                }
+
+                CHECK(instanceTx.init(payload.c_str(), GGWAVE_PROTOCOL_DT_FAST, 10));
+
+                const int n = instanceTx.encode()/sizeof(int16_t);
+                const auto p = (const int16_t *) instanceTx.txWaveform();
+
+                std::vector<int16_t> waveform(p, p + n);
+                waveform.insert(waveform.end(), 64*parameters.samplesPerFrame, 0);
+                for (auto & x : waveform) {
+                    x = std::max(-32768.0f, std::min(32767.0f, x + 32768.0f*level*(frand() - 0.5f)));
+                }
+
+                CHECK(instanceRx.decode(waveform.data(), waveform.size()*sizeof(int16_t)));
+                CHECK(frontEnd.decode(waveform.data(), waveform.size()*sizeof(int16_t), backends, 1));
+
+                nBits      += 8*payloadLength;
+                nErrors    += countErrors(instanceRx, payload);
+                nErrorsRef += countErrors(backend, payload);
+            }
+
+            printf("Fixed-length bit errors at noise level %.1f: %d / %d, floating-point spectrum: %d / %d\n", level, nErrors, nBits, nErrorsRef, nBits);
+
+            CHECK(level > 0.0f || nErrors == 0);
+            CHECK(nErrors <= nErrorsRef + nBits/10);
+        }
+    }
+
+    // custom protocols with 2, 4 and 6 bits per symbol and wider bin spacing
+    for (int payloadLength : { -1, 8, }) {
+        const auto rxProtocols = GGWave::Protocols::rx();
+        const auto txProtocols = GGWave::Protocols::tx();
+
+        const GGWave::Protocol shapes[] = {
+            { "2-bit",           40, 6, 3, 1, true, 2, 1, false, },
+            { "6-bit",           40, 6, 3, 1, true, 6, 1, false, },
+            { "4-bit, 2 bins",   40, 6, 3, 1, true, 4, 2, false, },
+        };
+
+        for (const auto & protocol : shapes) {
+            GGWave::Protocols::rx().only(GGWAVE_PROTOCOL_CUSTOM_0);
+            GGWave::Protocols::tx().only(GGWAVE_PROTOCOL_CUSTOM_0);
+            GGWave::Protocols::rx()[GGWAVE_PROTOCOL_CUSTOM_0] = protocol;
+            GGWave::Protocols::tx()[GGWAVE_PROTOCOL_CUSTOM_0] = protocol;
+
+            auto parameters = GGWave::getDefaultParameters();
+            parameters.payloadLength   = payloadLength;
+            parameters.sampleFormatInp = GGWAVE_SAMPLE_FORMAT_F32;
+            parameters.sampleFormatOut = GGWAVE_SAMPLE_FORMAT_F32;
+
+            GGWave instance(parameters);
+
+            const std::string payload = "symbols!";
+            CHECK(instance.init(payload.c_str(), GGWAVE_PROTOCOL_CUSTOM_0, 25));
+            CHECK(roundTrip(instance, payload, 0, 64, 0.0f));
+
+            // each Tx has one tone per symbol, on the bins of its symbol
+            if (payloadLength > 0) {
+                parameters.operatingMode = GGWAVE_OPERATING_MODE_TX | GGWAVE_OPERATING_MODE_TX_ONLY_TONES;
+                GGWave instanceTones(parameters);
+                CHECK(instanceTones.init(payload.c_str(), GGWAVE_PROTOCOL_CUSTOM_0, 25));
+                instanceTones.encode();
+
+                // the 64 tones of the 6-bit symbols do not fit in GGWave::Tone
+                const auto tones8    = instanceTones.txTones();
+                const auto tonesWide = instanceTones.txTonesWide();
+
+                const bool isWide = protocol.nDataBins() > 128;
+                CHECK((isWide ? tones8.size() : tonesWide.size()) == 0);
+
+                const std::vector<int> tones = isWide ?
+                    std::vector<int>(tonesWide.begin(), tonesWide.end()) :
+                    std::vector<int>(tones8.begin(), tones8.end());
+                CHECK(tones.size() > 0);
+
+                const int span = protocol.nBinSpacing()*protocol.nSymbolTones();
+
+                int nInTx = 0;
+                for (int i = 0; i < (int) tones.size(); ++i) {
+                    if (tones[i] < 0) {
+                        CHECK(nInTx == protocol.nTones());
+                        nInTx = 0;
+                        continue;
+                    }
+
+                    CHECK(tones[i]/span == nInTx);
+                    CHECK(tones[i] % protocol.nBinSpacing() == 0);
+                    ++nInTx;
+                }
+            }
+        }
+
+        // the bytes of a Tx must split into whole symbols
+        GGWave::Protocols::tx()[GGWAVE_PROTOCOL_CUSTOM_0].symbolBits = 5;
+        {
+            auto parameters = GGWave::getDefaultParameters();
+            parameters.payloadLength = payloadLength;
+
+            GGWave instance;
+            CHECK_F(instance.prepare(parameters));
+        }
+
+        GGWave::Protocols::rx() = rxProtocols;
+        GGWave::Protocols::tx() = txProtocols;
+    }
+
+    // OFDM protocols with long payloads, starting at an arbitrary sample
+    {
+        const auto rxProtocols = GGWave::Protocols::rx();
+        const auto txProtocols = GGWave::Protocols::tx();
+
+        // the OFDM protocols are opt-in
+        {
+            auto protocols = GGWave::Protocols::kDefault();
+            protocols.enableAll();
+
+            CHECK(protocols[GGWAVE_PROTOCOL_AUDIBLE_NORMAL].enabled);
+            CHECK_F(protocols[GGWAVE_PROTOCOL_OFDM_NORMAL].enabled);
+            CHECK_F(protocols[GGWAVE_PROTOCOL_OFDM_FASTEST].enabled);
+            CHECK(GGWAVE_PROTOCOL_OFDM_NORMAL > GGWAVE_PROTOCOL_CUSTOM_9);
+        }
+
+        GGWave::Protocols::rx().toggle(GGWAVE_PROTOCOL_OFDM_NORMAL,  true);
+        GGWave::Protocols::rx().toggle(GGWAVE_PROTOCOL_OFDM_FAST,    true);
+        GGWave::Protocols::rx().toggle(GGWAVE_PROTOCOL_OFDM_FASTEST, true);
+        GGWave::Protocols::tx().toggle(GGWAVE_PROTOCOL_OFDM_NORMAL,  true);
+        GGWave::Protocols::tx().toggle(GGWAVE_PROTOCOL_OFDM_FAST,    true);
+        GGWave::Protocols::tx().toggle(GGWAVE_PROTOCOL_OFDM_FASTEST, true);
+
+        auto parameters = GGWave::getDefaultParameters();
+        parameters.sampleFormatInp = GGWAVE_SAMPLE_FORMAT_F32;
+        parameters.sampleFormatOut = GGWAVE_SAMPLE_FORMAT_F32;
+
+        GGWave instance(parameters);
+
+        std::string payload;
+        for (int i = 0; i < 120; ++i) {
+            payload += 'A' + rand() % 26;
+        }
+
+        CHECK(instance.init(payload.c_str(), GGWAVE_PROTOCOL_AUDIBLE_FASTEST, 25));
+        const int nFastest = instance.encode()/sizeof(float);
+
+        for (auto protocolId : { GGWAVE_PROTOCOL_OFDM_NORMAL, GGWAVE_PROTOCOL_OFDM_FAST, GGWAVE_PROTOCOL_OFDM_FASTEST, }) {
+            printf("Testing: protocol = %s\n", GGWave::Protocols::tx()[protocolId].name);
+
+            CHECK(instance.init(payload.c_str(), protocolId, 25));
+            CHECK(2*(int) instance.encodeSize_samples() < nFastest);
+
+            CHECK(roundTrip(instance, payload, 137, 64, 0.01f));
+        }
+
+        // OFDM needs variable payload length
+        {
+            parameters.payloadLength = 16;
+
+            GGWave instanceFixed(parameters);
+            CHECK_F(instanceFixed.init("hello", GGWAVE_PROTOCOL_OFDM_NORMAL, 25));
+        }
+
+        GGWave::Protocols::rx() = rxProtocols;
+        GGWave::Protocols::tx() = txProtocols;
+    }
+
+    // short preamble, starting at an arbitrary sample
+    {
+        auto parameters = GGWave::getDefaultParameters();
+        parameters.sampleFormatInp = GGWAVE_SAMPLE_FORMAT_F32;
+        parameters.sampleFormatOut = GGWAVE_SAMPLE_FORMAT_F32;
+
+        GGWave instanceMarkers(parameters);
+
+        parameters.operatingMode |= GGWAVE_OPERATING_MODE_SHORT_PREAMBLE;
+
+        GGWave instance(parameters);
+
+        const std::string payload = "short";
+
+        for (auto protocolId : { GGWAVE_PROTOCOL_AUDIBLE_NORMAL, GGWAVE_PROTOCOL_AUDIBLE_FASTEST, GGWAVE_PROTOCOL_ULTRASOUND_FAST, GGWAVE_PROTOCOL_DT_FASTEST, }) {
+            printf("Testing: short preamble, protocol = %s\n", GGWave::Protocols::tx()[protocolId].name);
+
+            CHECK(instanceMarkers.init(payload.c_str(), protocolId, 25));
+            const int nMarkers = instanceMarkers.encode()/sizeof(float);
+
+            CHECK(instance.init(payload.c_str(), protocolId, 25));
+            CHECK(5*(int) instance.encodeSize_samples() < 3*nMarkers);
+
+            for (int offset : { 0, 211, 1023, }) {
+                CHECK(instance.init(payload.c_str(), protocolId, 25));
+                CHECK(roundTrip(instance, payload, offset, 64, 0.05f));
+            }
+        }
+
+        // the data is up to 2 steps (1/8 frame) away from the lag of the matched filter
+        {
+            CHECK(instance.init(payload.c_str(), GGWAVE_PROTOCOL_AUDIBLE_FAST, 25));
+
+            const int n = instance.encode()/sizeof(float);
+            const auto p = (const float *) instance.txWaveform();
+            const int nPreamble = 2*parameters.samplesPerFrame;
+
+            for (int delta : { -parameters.samplesPerFrame/8, parameters.samplesPerFrame/8, }) {
+                printf("Testing: short preamble, data offset error = %d\n", delta);
+
+                std::vector<float> waveform(p, p + nPreamble);
+                if (delta > 0) {
+                    waveform.insert(waveform.end(), delta, 0.0f);
+                }
+                waveform.insert(waveform.end(), p + nPreamble - (delta < 0 ? -delta : 0), p + n);
+                waveform.insert(waveform.end(), 64*parameters.samplesPerFrame, 0.0f);
+
+                for (auto & s : waveform) {
+                    s += 0.05f*(frand() - 0.5f);
+                }
+
+                instance.decode(waveform.data(), waveform.size()*sizeof(float));
+
+                GGWave::TxRxData result;
+                CHECK(instance.rxTakeData(result) == (int) payload.size());
+                CHECK(std::string((const char *) result.data(), payload.size()) == payload);
+            }
+        }
+
+        // the end of the transmission is known only from the length of a variable-length payload
+        {
+            parameters.payloadLength = 16;
+
+            GGWave instanceFixed;
+            CHECK_F(instanceFixed.prepare(parameters));
+        }
+    }
+
+    // large frames, played back and captured at twice the operating sample rate
+    {
+        auto parameters = GGWave::getDefaultParameters();
+        parameters.sampleRateInp   = 2*GGWave::kDefaultSampleRate;
+        parameters.sampleRateOut   = 2*GGWave::kDefaultSampleRate;
+        parameters.sampleFormatInp = GGWAVE_SAMPLE_FORMAT_F32;
+        parameters.sampleFormatOut = GGWAVE_SAMPLE_FORMAT_F32;
+        parameters.samplesPerFrame = GGWave::kMaxSamplesPerFrame;
+
+        const std::string payload = "large";
+
+        for (int payloadLength : { -1, (int) payload.size(), }) {
+            parameters.payloadLength = payloadLength;
+
+            GGWave instance(parameters);
+
+            for (auto protocolId : { GGWAVE_PROTOCOL_AUDIBLE_FASTEST, GGWAVE_PROTOCOL_DT_FASTEST, }) {
+                printf("Testing: samples per frame = %d, payload length = %d, protocol = %s\n",
+                       parameters.samplesPerFrame, payloadLength, GGWave::Protocols::tx()[protocolId].name);
+
+                CHECK(instance.init(payload.c_str(), protocolId, 25));
+                CHECK(roundTrip(instance, payload, 0, 16, 0.05f));
+            }
+        }
+
+        {
+            parameters.samplesPerFrame = 2*GGWave::kMaxSamplesPerFrame;
+
+            GGWave instanceTooLarge;
+            CHECK_F(instanceTooLarge.prepare(parameters));
+        }
+    }
+
     // playback / capture at different sample rates
     for (int srInp = GGWave::kDefaultSampleRate/6; srInp <= 2*GGWave::kDefaultSampleRate; srInp += 1371) {
         printf("Testing: sample rate = %d\n", srInp);
@@ -255,11 +1393,6 @@ int main(int argc, char ** argv) {
                 printf("Testing: protocol = %s, in = %d, out = %d\n", protocol.name, formatInp, formatOut);
 
                 for (int length = 1; length <= (int) payload.size(); ++length) {
-                    // mono-tone protocols with variable length are not supported
-                    if (protocol.extra == 2) {
-                        break;
-                    }
-
                     // variable payload length
                     {
                         auto parameters = GGWave::getDefaultParameters();